@@ -0,0 +1,692 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../template.h"
+#include "../matching.h"
+#include "../gallery.h"
+#include "../thread_pool.h"
+#include "../platform.h"
+#include "../cpu_features.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Per-stage microbenchmarks for the preprocessing, inference and matching hot paths.
+// Every benchmark first doubles its inner repetition count until one sample takes at least
+// min_sample_ns (which also warms caches, page tables and the branch predictors), then
+// discards `warmup` more samples and records `samples` timed ones. Per-call latency is
+// (sample - timer overhead) / inner; p50/p99 are nearest-rank over those samples.
+// Inputs are synthetic and seeded, so two runs on one host measure the same work.
+// Results go to stdout (or --out) as JSON, with a one-line summary per benchmark on stderr.
+
+#define BENCH_MAX_RESULTS 64
+#define BENCH_MAX_INNER (1 << 24)
+#define BENCH_DEFAULT_SEED 0x5eed5eedu
+#define BENCH_TOPK 10
+
+typedef void (*bench_fn)(void* arg);
+
+typedef struct BenchOptions {
+    int warmup;
+    int samples;
+    uint64_t min_sample_ns;
+    uint64_t max_bench_ns;     // Fewer samples (at least 5) for benchmarks slower than this in total
+    const char* filter;        // Substring of the benchmark names to run; NULL runs all
+    const char* image_path;    // NULL: synthesize an image
+    const char* model_path;    // NULL: skip run_model
+    const char* out_path;      // NULL: stdout
+    int image_width;
+    int image_height;
+    int gallery_max;
+    int threads;               // ORT intra-op threads and gallery pool size; 0 keeps the defaults
+    int pin;
+    double ghz;                // Cycle rate for bytes/cycle; 0 measures the TSC where there is one
+    uint32_t seed;
+} BenchOptions;
+
+typedef struct BenchResult {
+    char name[48];
+    char params[160];          // JSON members describing the input
+    int samples;
+    int inner;
+    double p50_ns;
+    double p99_ns;
+    double mean_ns;
+    double min_ns;
+    double items_per_call;     // Images, templates or gallery rows processed per call
+    double bytes_per_call;     // Bytes read and written per call
+} BenchResult;
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static int num_results = 0;
+static double timer_overhead_ns = 0.0;
+static volatile float bench_sink;
+
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float rng_uniform(void) {
+    return (float)(rng_next() >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)ceil(p * count);
+    if (rank < 1) rank = 1;
+    return sorted[rank - 1];
+}
+
+static uint64_t time_calls(bench_fn fn, void* arg, int inner) {
+    uint64_t start = monotonic_ns();
+    for (int i = 0; i < inner; i++) {
+        fn(arg);
+    }
+    return monotonic_ns() - start;
+}
+
+static double measure_timer_overhead(void) {
+    double deltas[1001];
+    for (int i = 0; i < 1001; i++) {
+        uint64_t start = monotonic_ns();
+        deltas[i] = (double)(monotonic_ns() - start);
+    }
+    qsort(deltas, 1001, sizeof(double), compare_double);
+    return deltas[500];
+}
+
+// Reference cycles per nanosecond from the TSC (constant rate on current x86; not the core clock under turbo)
+static double measure_tsc_ghz(void) {
+#if defined(CPU_X86)
+    uint64_t start_ns = monotonic_ns();
+    uint64_t start_tsc = __rdtsc();
+    while (monotonic_ns() - start_ns < 100000000ull) {
+    }
+    uint64_t end_tsc = __rdtsc();
+    uint64_t end_ns = monotonic_ns();
+    return (double)(end_tsc - start_tsc) / (double)(end_ns - start_ns);
+#else
+    return 0.0;
+#endif
+}
+
+static void run_bench(const BenchOptions* options, const char* name, const char* params,
+    bench_fn fn, void* arg, double items_per_call, double bytes_per_call) {
+
+    if (options->filter != NULL && strstr(name, options->filter) == NULL) return;
+    if (num_results == BENCH_MAX_RESULTS) {
+        fprintf(stderr, "Too many benchmarks, skipping %s\n", name);
+        return;
+    }
+
+    int inner = 1;
+    uint64_t sample_ns = time_calls(fn, arg, inner);
+    while (sample_ns < options->min_sample_ns && inner < BENCH_MAX_INNER) {
+        inner *= 2;
+        sample_ns = time_calls(fn, arg, inner);
+    }
+    for (int i = 0; i < options->warmup; i++) {
+        sample_ns = time_calls(fn, arg, inner);
+    }
+
+    int samples = options->samples;
+    if (sample_ns > 0 && (uint64_t)samples * sample_ns > options->max_bench_ns) {
+        samples = (int)(options->max_bench_ns / sample_ns);
+        if (samples < 5) samples = 5;
+        if (samples > options->samples) samples = options->samples;
+    }
+
+    double* per_call = (double*)malloc(samples * sizeof(double));
+    if (per_call == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    double total = 0.0;
+    for (int i = 0; i < samples; i++) {
+        double elapsed = (double)time_calls(fn, arg, inner) - timer_overhead_ns;
+        per_call[i] = elapsed > 0.0 ? elapsed / inner : 0.0;
+        total += per_call[i];
+    }
+    qsort(per_call, samples, sizeof(double), compare_double);
+
+    BenchResult* result = &results[num_results++];
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    snprintf(result->params, sizeof(result->params), "%s", params);
+    result->samples = samples;
+    result->inner = inner;
+    result->p50_ns = percentile(per_call, samples, 0.50);
+    result->p99_ns = percentile(per_call, samples, 0.99);
+    result->mean_ns = total / samples;
+    result->min_ns = per_call[0];
+    result->items_per_call = items_per_call;
+    result->bytes_per_call = bytes_per_call;
+    free(per_call);
+
+    fprintf(stderr, "%-36s %-44s p50 %12.1f ns  p99 %12.1f ns  %10.3f GB/s\n", name, params,
+        result->p50_ns, result->p99_ns, result->p50_ns > 0.0 ? bytes_per_call / result->p50_ns : 0.0);
+}
+
+// Image stages
+
+typedef struct ImageBench {
+    const char* path;
+    int width;
+    int height;
+    unsigned char* rgb;         // width x height x 3, as read_bmp_image returns it
+    unsigned char* gray;        // width x height
+    unsigned char* filtered;    // width x height x 3
+    unsigned char* resized;     // INPUT_WIDTH x INPUT_HEIGHT x 3
+    float* normalized;          // HWC
+    float* chw;                 // INPUT_TENSOR_SIZE
+} ImageBench;
+
+static void put_u32(uint8_t* dst, uint32_t value) {
+    dst[0] = (uint8_t)value;
+    dst[1] = (uint8_t)(value >> 8);
+    dst[2] = (uint8_t)(value >> 16);
+    dst[3] = (uint8_t)(value >> 24);
+}
+
+// Synthetic 8-bit gray BMP (bottom-up, like most capture SDKs write): concentric ridges
+// around an off-centre core plus seeded noise, so filters and resize see fingerprint-like texture
+static int write_synthetic_bmp(const char* path, int width, int height) {
+    int row_size = (width + 3) & ~3;
+    uint32_t pixel_offset = 14 + 40 + 256 * 4;
+    uint32_t file_size = pixel_offset + (uint32_t)row_size * height;
+
+    uint8_t header[54] = { 'B', 'M' };
+    put_u32(header + 2, file_size);
+    put_u32(header + 10, pixel_offset);
+    put_u32(header + 14, 40);                  // BITMAPINFOHEADER
+    put_u32(header + 18, (uint32_t)width);
+    put_u32(header + 22, (uint32_t)height);    // positive: bottom-up
+    header[26] = 1;                            // planes
+    header[28] = 8;                            // bits per pixel
+    put_u32(header + 34, (uint32_t)row_size * height);
+    put_u32(header + 46, 256);                 // palette entries
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening %s for writing\n", path);
+        return -1;
+    }
+    fwrite(header, 1, sizeof(header), file);
+    for (int i = 0; i < 256; i++) {
+        uint8_t entry[4] = { (uint8_t)i, (uint8_t)i, (uint8_t)i, 0 };
+        fwrite(entry, 1, 4, file);
+    }
+
+    unsigned char* row = (unsigned char*)calloc(row_size, 1);
+    if (row == NULL) {
+        fclose(file);
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    float cx = width * 0.45f;
+    float cy = height * 0.55f;
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) {
+            float r = sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy));
+            float value = 128.0f + 90.0f * sinf(0.6f * r + 0.002f * x * y / (1.0f + r)) + 20.0f * rng_uniform();
+            row[x] = (unsigned char)(value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value));
+        }
+        fwrite(row, 1, row_size, file);
+    }
+    free(row);
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+static void bench_read_bmp_image(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    unsigned char* img = NULL;
+    int width, height;
+    if (read_bmp_image(bench->path, &img, &width, &height) == 0) {
+        free(img);
+    }
+}
+
+static void bench_apply_box_filter(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    apply_box_filter(bench->rgb, bench->filtered, bench->width, bench->height, 3);
+}
+
+static void bench_gaussian_blur(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    gaussian_blur(bench->rgb, bench->filtered, bench->width, bench->height, 5);
+}
+
+static void bench_resize_image(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    resize_image(bench->rgb, bench->resized, bench->width, bench->height, INPUT_WIDTH, INPUT_HEIGHT);
+}
+
+static void bench_normalize_image(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    normalize_image(bench->resized, bench->normalized, INPUT_WIDTH, INPUT_HEIGHT);
+}
+
+static void bench_reshape_image(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    reshape_image(bench->normalized, bench->chw, INPUT_WIDTH, INPUT_HEIGHT, INPUT_CHANNELS);
+}
+
+static void bench_preprocess_image_fused(void* arg) {
+    ImageBench* bench = (ImageBench*)arg;
+    preprocess_image_fused(bench->gray, bench->width, bench->height, bench->width, 1,
+        bench->chw, INPUT_CHANNELS, INPUT_WIDTH, INPUT_HEIGHT);
+}
+
+static int run_image_benches(const BenchOptions* options, ImageBench* bench) {
+    if (read_bmp_image(bench->path, &bench->rgb, &bench->width, &bench->height) != 0) return -1;
+
+    size_t pixels = (size_t)bench->width * bench->height;
+    size_t model_pixels = (size_t)INPUT_WIDTH * INPUT_HEIGHT;
+    bench->gray = (unsigned char*)malloc(pixels);
+    bench->filtered = (unsigned char*)malloc(pixels * 3);
+    bench->resized = (unsigned char*)malloc(model_pixels * 3);
+    bench->normalized = (float*)malloc(model_pixels * 3 * sizeof(float));
+    bench->chw = (float*)malloc(INPUT_TENSOR_SIZE * sizeof(float));
+    if (bench->gray == NULL || bench->filtered == NULL || bench->resized == NULL ||
+        bench->normalized == NULL || bench->chw == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < pixels; i++) {
+        bench->gray[i] = bench->rgb[i * 3];
+    }
+    // Valid contents for the stages that consume an earlier stage's output
+    resize_image(bench->rgb, bench->resized, bench->width, bench->height, INPUT_WIDTH, INPUT_HEIGHT);
+    normalize_image(bench->resized, bench->normalized, INPUT_WIDTH, INPUT_HEIGHT);
+
+    char params[160];
+    snprintf(params, sizeof(params), "\"width\": %d, \"height\": %d", bench->width, bench->height);
+    double file_bytes = 14.0 + 40.0 + 1024.0 + (double)((bench->width + 3) & ~3) * bench->height;
+    double rgb_bytes = (double)pixels * 3;
+    double model_bytes = (double)model_pixels * 3;
+
+    run_bench(options, "read_bmp_image", params, bench_read_bmp_image, bench, 1, file_bytes + rgb_bytes);
+    snprintf(params, sizeof(params), "\"width\": %d, \"height\": %d, \"box_size\": 3", bench->width, bench->height);
+    run_bench(options, "apply_box_filter", params, bench_apply_box_filter, bench, 1, 2 * rgb_bytes);
+    snprintf(params, sizeof(params), "\"width\": %d, \"height\": %d, \"kernel_size\": 5", bench->width, bench->height);
+    run_bench(options, "gaussian_blur", params, bench_gaussian_blur, bench, 1, 2 * rgb_bytes);
+    snprintf(params, sizeof(params), "\"width\": %d, \"height\": %d, \"output\": %d", bench->width, bench->height, INPUT_WIDTH);
+    run_bench(options, "resize_image", params, bench_resize_image, bench, 1, rgb_bytes + model_bytes);
+    snprintf(params, sizeof(params), "\"width\": %d, \"height\": %d", INPUT_WIDTH, INPUT_HEIGHT);
+    run_bench(options, "normalize_image", params, bench_normalize_image, bench, 1, model_bytes * (1 + sizeof(float)));
+    run_bench(options, "reshape_image", params, bench_reshape_image, bench, 1, model_bytes * 2 * sizeof(float));
+    snprintf(params, sizeof(params), "\"width\": %d, \"height\": %d, \"output\": %d", bench->width, bench->height, INPUT_WIDTH);
+    run_bench(options, "preprocess_image_fused", params, bench_preprocess_image_fused, bench, 1,
+        (double)pixels + (double)INPUT_TENSOR_SIZE * sizeof(float));
+    return 0;
+}
+
+// Inference
+
+typedef struct ModelBench {
+    const OrtApi* g_ort;
+    OrtSession* session;
+    int single_tower;
+    size_t input_size;
+    float* input1;
+    float* input2;
+    float output1[TEMPLATE_SIZE];
+    float output2[TEMPLATE_SIZE];
+} ModelBench;
+
+static void bench_run_model(void* arg) {
+    ModelBench* bench = (ModelBench*)arg;
+    if (bench->single_tower) {
+        run_model_single(bench->g_ort, bench->session, bench->input1, bench->input_size, bench->output1, TEMPLATE_SIZE);
+    }
+    else {
+        run_model(bench->g_ort, bench->session, bench->input1, bench->input_size, bench->input2, bench->input_size,
+            bench->output1, TEMPLATE_SIZE, bench->output2, TEMPLATE_SIZE);
+    }
+}
+
+static int run_model_benches(const BenchOptions* options, const ImageBench* image) {
+    if (options->filter != NULL && strstr("run_model", options->filter) == NULL) return 0;
+
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Failed to initialize ONNX Runtime API.\n");
+        return -1;
+    }
+
+#ifdef _WIN32
+    int length = MultiByteToWideChar(CP_UTF8, 0, options->model_path, -1, NULL, 0);
+    wchar_t* model_path = (wchar_t*)malloc(length * sizeof(wchar_t));
+    if (model_path == NULL) return -1;
+    MultiByteToWideChar(CP_UTF8, 0, options->model_path, -1, model_path, length);
+#else
+    const char* model_path = options->model_path;
+#endif
+
+    ModelOptions model_options = { 0 };
+    model_options.intra_op_threads = options->threads;
+    OrtEnv* env = NULL;
+    OrtSession* session = NULL;
+    int status = load_model_with_options(g_ort, model_path, &model_options, &env, &session);
+#ifdef _WIN32
+    free(model_path);
+#endif
+    if (status != 0) return -1;
+
+    ModelBench bench;
+    bench.g_ort = g_ort;
+    bench.session = session;
+    bench.single_tower = is_single_tower_model(g_ort, session);
+    bench.input_size = (size_t)model_input_channels(g_ort, session) * INPUT_WIDTH * INPUT_HEIGHT;
+    bench.input1 = (float*)malloc(bench.input_size * sizeof(float));
+    bench.input2 = (float*)malloc(bench.input_size * sizeof(float));
+    if (bench.input1 == NULL || bench.input2 == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(bench.input1);
+        free(bench.input2);
+        clean_model(g_ort, env, session);
+        return -1;
+    }
+    int channels = (int)(bench.input_size / ((size_t)INPUT_WIDTH * INPUT_HEIGHT));
+    preprocess_image_fused(image->gray, image->width, image->height, image->width, 1,
+        bench.input1, channels, INPUT_WIDTH, INPUT_HEIGHT);
+    memcpy(bench.input2, bench.input1, bench.input_size * sizeof(float));
+
+    int towers = bench.single_tower ? 1 : 2;
+    char params[160];
+    snprintf(params, sizeof(params), "\"towers\": %d, \"channels\": %d, \"intra_op_threads\": %d",
+        towers, channels, options->threads);
+    run_bench(options, "run_model", params, bench_run_model, &bench, towers,
+        towers * ((double)bench.input_size * sizeof(float) + TEMPLATE_SIZE * sizeof(float)));
+
+    free(bench.input1);
+    free(bench.input2);
+    clean_model(g_ort, env, session);
+    return 0;
+}
+
+// Matching
+
+typedef struct MatchBench {
+    float query[TEMPLATE_SIZE];
+    float other[TEMPLATE_SIZE];
+    float** template_db;
+    Gallery* gallery;
+    int db_size;
+    float* score;
+    int64_t topk_ids[BENCH_TOPK];
+    float topk_scores[BENCH_TOPK];
+} MatchBench;
+
+static void bench_cosine_similarity(void* arg) {
+    MatchBench* bench = (MatchBench*)arg;
+    bench_sink = cosine_similarity(bench->query, bench->other, TEMPLATE_SIZE);
+}
+
+static void bench_fingerprint_identification(void* arg) {
+    MatchBench* bench = (MatchBench*)arg;
+    fingerprint_identification(bench->query, bench->template_db, bench->db_size, bench->score);
+}
+
+static void bench_identification_gallery(void* arg) {
+    MatchBench* bench = (MatchBench*)arg;
+    fingerprint_identification_gallery(bench->query, bench->gallery, bench->score);
+}
+
+static void bench_identify_topk(void* arg) {
+    MatchBench* bench = (MatchBench*)arg;
+    // Threshold 2 (the largest cosine distance) keeps every row in contention
+    fingerprint_identify_topk(bench->query, bench->gallery, BENCH_TOPK, 2.0f, bench->topk_ids, bench->topk_scores);
+}
+
+static int run_matching_benches(const BenchOptions* options) {
+    MatchBench bench;
+    memset(&bench, 0, sizeof(bench));
+    for (int k = 0; k < TEMPLATE_SIZE; k++) {
+        bench.query[k] = rng_uniform();
+        bench.other[k] = rng_uniform();
+    }
+    run_bench(options, "cosine_similarity", "\"length\": 64", bench_cosine_similarity, &bench,
+        1, 2.0 * TEMPLATE_SIZE * sizeof(float));
+
+    ThreadPool* pool = NULL;
+    if (options->threads > 1 && create_thread_pool(options->threads, options->pin, &pool) != 0) return -1;
+
+    int status = 0;
+    float row[TEMPLATE_SIZE];
+    for (long long size = 1000; size <= options->gallery_max && status == 0; size *= 10) {
+        int db_size = (int)size;
+        if (create_gallery(db_size, &bench.gallery) != 0) {
+            status = -1;
+            break;
+        }
+        bench.template_db = (float**)malloc((size_t)db_size * sizeof(float*));
+        bench.score = (float*)malloc((size_t)db_size * sizeof(float));
+        if (bench.template_db == NULL || bench.score == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            status = -1;
+        }
+        for (int i = 0; i < db_size && status == 0; i++) {
+            for (int k = 0; k < TEMPLATE_SIZE; k++) {
+                row[k] = rng_uniform();
+            }
+            status = add_to_gallery(bench.gallery, row, i);
+        }
+        if (status == 0) {
+            // The legacy float** API reads the same normalized rows in place
+            for (int i = 0; i < db_size; i++) {
+                bench.template_db[i] = bench.gallery->templates + (size_t)i * TEMPLATE_SIZE;
+            }
+            if (pool != NULL) gallery_set_thread_pool(bench.gallery, pool);
+            bench.db_size = db_size;
+
+            char params[160];
+            snprintf(params, sizeof(params), "\"gallery_size\": %d, \"threads\": %d", db_size, pool != NULL ? options->threads : 1);
+            double row_bytes = TEMPLATE_SIZE * sizeof(float);
+            run_bench(options, "fingerprint_identification", params, bench_fingerprint_identification, &bench,
+                db_size, db_size * (row_bytes + sizeof(float*) + sizeof(float)));
+            run_bench(options, "fingerprint_identification_gallery", params, bench_identification_gallery, &bench,
+                db_size, db_size * (row_bytes + sizeof(float)));
+            snprintf(params, sizeof(params), "\"gallery_size\": %d, \"threads\": %d, \"k\": %d",
+                db_size, pool != NULL ? options->threads : 1, BENCH_TOPK);
+            run_bench(options, "fingerprint_identify_topk", params, bench_identify_topk, &bench,
+                db_size, db_size * row_bytes);
+        }
+        free(bench.template_db);
+        free(bench.score);
+        clean_gallery(bench.gallery);
+        bench.template_db = NULL;
+        bench.score = NULL;
+        bench.gallery = NULL;
+    }
+
+    if (pool != NULL) clean_thread_pool(pool);
+    return status;
+}
+
+// Output
+
+static void write_json_string(FILE* out, const char* value) {
+    fputc('"', out);
+    for (const char* c = value; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        if ((unsigned char)*c >= 0x20) fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void write_json(FILE* out, const BenchOptions* options, double ghz, const char* cycle_source, const char* image_path) {
+    fprintf(out, "{\n");
+    fprintf(out, "  \"schema\": 1,\n");
+    fprintf(out, "  \"host\": { \"cpu_count\": %d, \"cpu_features\": %d, \"cycle_source\": \"%s\", \"ghz\": %.4f, \"timer_overhead_ns\": %.1f },\n",
+        cpu_count(), cpu_features(), cycle_source, ghz, timer_overhead_ns);
+    fprintf(out, "  \"config\": { \"warmup\": %d, \"samples\": %d, \"min_sample_ns\": %llu, \"max_bench_ns\": %llu, "
+        "\"seed\": %u, \"gallery_max\": %d, \"threads\": %d, \"pin\": %d, \"image\": ",
+        options->warmup, options->samples, (unsigned long long)options->min_sample_ns,
+        (unsigned long long)options->max_bench_ns, options->seed, options->gallery_max, options->threads, options->pin);
+    write_json_string(out, image_path);
+    fprintf(out, ", \"model\": ");
+    if (options->model_path != NULL) write_json_string(out, options->model_path);
+    else fprintf(out, "null");
+    fprintf(out, " },\n");
+
+    fprintf(out, "  \"results\": [\n");
+    for (int i = 0; i < num_results; i++) {
+        const BenchResult* result = &results[i];
+        double seconds = result->p50_ns * 1e-9;
+        fprintf(out, "    { \"name\": \"%s\", \"params\": { %s }, \"samples\": %d, \"inner_iterations\": %d, "
+            "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"mean_ns\": %.1f, \"min_ns\": %.1f, "
+            "\"items_per_call\": %.0f, \"items_per_s\": %.1f, \"bytes_per_call\": %.0f, \"bytes_per_s\": %.1f, \"bytes_per_cycle\": ",
+            result->name, result->params, result->samples, result->inner,
+            result->p50_ns, result->p99_ns, result->mean_ns, result->min_ns,
+            result->items_per_call, seconds > 0.0 ? result->items_per_call / seconds : 0.0,
+            result->bytes_per_call, seconds > 0.0 ? result->bytes_per_call / seconds : 0.0);
+        if (ghz > 0.0 && result->p50_ns > 0.0) fprintf(out, "%.4f }", result->bytes_per_call / (result->p50_ns * ghz));
+        else fprintf(out, "null }");
+        fprintf(out, "%s\n", i + 1 < num_results ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void print_usage(void) {
+    fprintf(stderr,
+        "Usage: fingerprint_bench [options]\n"
+        "  --model PATH         ONNX model for run_model (default models/optimized_deit_tiny_siamese.onnx)\n"
+        "  --no-model           skip run_model\n"
+        "  --image PATH         8-bit gray BMP for the image stages (default: synthetic, see --width/--height)\n"
+        "  --width N --height N synthetic image size (default 300 x 400)\n"
+        "  --gallery-max N      largest synthetic gallery; sizes run 1e3, 1e4, ... up to N (default 1000000,\n"
+        "                       10000000 needs about 3 GB)\n"
+        "  --threads N          ORT intra-op threads and gallery search pool (default: ORT default, 1 for search)\n"
+        "  --pin                pin the benchmark thread (and pool workers) to processors\n"
+        "  --warmup N           warm-up samples after calibration (default 3)\n"
+        "  --samples N          timed samples per benchmark (default 100)\n"
+        "  --min-sample-us N    minimum duration of one sample (default 200)\n"
+        "  --max-seconds N      time budget per benchmark before samples are reduced (default 5)\n"
+        "  --ghz X              cycle rate for bytes/cycle (default: measured TSC on x86)\n"
+        "  --seed N             seed for the synthetic data\n"
+        "  --filter TEXT        only benchmarks whose name contains TEXT\n"
+        "  --out PATH           write JSON here instead of stdout\n");
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    memset(&options, 0, sizeof(options));
+    options.warmup = 3;
+    options.samples = 100;
+    options.min_sample_ns = 200000;
+    options.max_bench_ns = 5000000000ull;
+    options.model_path = "models/optimized_deit_tiny_siamese.onnx";
+    options.image_width = 300;
+    options.image_height = 400;
+    options.gallery_max = 1000000;
+    options.seed = BENCH_DEFAULT_SEED;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int takes_value = 1;
+        if (strcmp(arg, "--no-model") == 0) { options.model_path = NULL; takes_value = 0; }
+        else if (strcmp(arg, "--pin") == 0) { options.pin = 1; takes_value = 0; }
+        else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) { print_usage(); return 0; }
+        else if (value == NULL) { print_usage(); return 1; }
+        else if (strcmp(arg, "--model") == 0) options.model_path = value;
+        else if (strcmp(arg, "--image") == 0) options.image_path = value;
+        else if (strcmp(arg, "--width") == 0) options.image_width = atoi(value);
+        else if (strcmp(arg, "--height") == 0) options.image_height = atoi(value);
+        else if (strcmp(arg, "--gallery-max") == 0) options.gallery_max = (int)atof(value);
+        else if (strcmp(arg, "--threads") == 0) options.threads = atoi(value);
+        else if (strcmp(arg, "--warmup") == 0) options.warmup = atoi(value);
+        else if (strcmp(arg, "--samples") == 0) options.samples = atoi(value);
+        else if (strcmp(arg, "--min-sample-us") == 0) options.min_sample_ns = (uint64_t)(atof(value) * 1000.0);
+        else if (strcmp(arg, "--max-seconds") == 0) options.max_bench_ns = (uint64_t)(atof(value) * 1e9);
+        else if (strcmp(arg, "--ghz") == 0) options.ghz = atof(value);
+        else if (strcmp(arg, "--seed") == 0) options.seed = (uint32_t)strtoul(value, NULL, 0);
+        else if (strcmp(arg, "--filter") == 0) options.filter = value;
+        else if (strcmp(arg, "--out") == 0) options.out_path = value;
+        else { print_usage(); return 1; }
+        if (takes_value) i++;
+    }
+    if (options.samples < 1 || options.warmup < 0 || options.image_width < 1 || options.image_height < 1 ||
+        options.image_width > PREPROCESS_MAX_WIDTH) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return 1;
+    }
+    rng_state = options.seed != 0 ? options.seed : BENCH_DEFAULT_SEED;
+
+    if (options.pin && pin_current_thread(0) != 0) {
+        fprintf(stderr, "Warning: could not pin the benchmark thread\n");
+    }
+    timer_overhead_ns = measure_timer_overhead();
+    double ghz = options.ghz;
+    const char* cycle_source = "user";
+    if (ghz <= 0.0) {
+        ghz = measure_tsc_ghz();
+        cycle_source = ghz > 0.0 ? "tsc" : "none";
+    }
+
+    const char* synthetic_path = "fingerprint_bench_image.bmp";
+    ImageBench image;
+    memset(&image, 0, sizeof(image));
+    image.path = options.image_path;
+    if (image.path == NULL) {
+        if (write_synthetic_bmp(synthetic_path, options.image_width, options.image_height) != 0) return 1;
+        image.path = synthetic_path;
+    }
+
+    int status = run_image_benches(&options, &image);
+    if (status == 0 && options.model_path != NULL) {
+        FILE* model_file = fopen(options.model_path, "rb");
+        if (model_file == NULL) {
+            fprintf(stderr, "Model %s not found, skipping run_model\n", options.model_path);
+        }
+        else {
+            fclose(model_file);
+            status = run_model_benches(&options, &image);
+        }
+    }
+    if (status == 0) status = run_matching_benches(&options);
+
+    if (options.image_path == NULL) remove(synthetic_path);
+    free(image.rgb);
+    free(image.gray);
+    free(image.filtered);
+    free(image.resized);
+    free(image.normalized);
+    free(image.chw);
+    if (status != 0) {
+        fprintf(stderr, "Benchmark failed\n");
+        return 1;
+    }
+
+    FILE* out = stdout;
+    if (options.out_path != NULL) {
+        out = fopen(options.out_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Error opening %s for writing\n", options.out_path);
+            return 1;
+        }
+    }
+    write_json(out, &options, ghz, cycle_source, options.image_path != NULL ? options.image_path : "synthetic");
+    if (out != stdout) fclose(out);
+    return 0;
+}
@@ -1,11 +1,37 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-#ifdef NDEBUG 
+// Exported API. Windows: dllexport when building the DLL (CMake shared target, or the Release
+// configuration of fingerprint.vcxproj), nothing for the static library and Debug test build.
+// GCC/Clang: the library is compiled with -fvisibility=hidden and only DllAPI symbols are exported
+#if defined(_WIN32)
+#if defined(FINGERPRINT_BUILD_DLL) || (defined(NDEBUG) && !defined(FINGERPRINT_STATIC))
 #define DllAPI __declspec(dllexport)
 #else
 #define DllAPI
 #endif
+#elif defined(__GNUC__) || defined(__clang__)
+#define DllAPI __attribute__((visibility("default")))
+#else
+#define DllAPI
+#endif
+
+// Model input and embedding dimensions
+#define INPUT_WIDTH 224
+#define INPUT_HEIGHT 224
+#define INPUT_CHANNELS 3
+#define INPUT_TENSOR_SIZE (INPUT_CHANNELS * INPUT_HEIGHT * INPUT_WIDTH)
+#define TEMPLATE_SIZE 64
+
+// Maximum number of images stacked into one ORT Run by generate_templates_batch
+#ifndef MAX_BATCH_SIZE
+#define MAX_BATCH_SIZE 32
+#endif
+
+// Idle single-image contexts kept per session for generate_template* (each holds a ~600 KB input tensor)
+#ifndef MAX_IDLE_CONTEXTS
+#define MAX_IDLE_CONTEXTS 8
+#endif
 
 #define ORT_ABORT_ON_ERROR(expr, g_ort)                      \
   do {                                                       \
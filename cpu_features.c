@@ -0,0 +1,89 @@
+#include "cpu_features.h"
+
+#if defined(CPU_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(CPU_ARM64)
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#if defined(CPU_X86)
+static void cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0: which register states the OS saves on context switch
+static unsigned long long xgetbv0(void) {
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static int detect_features(void) {
+    unsigned int regs[4];
+    int features = 0;
+
+    cpuid(0, 0, regs);
+    unsigned int max_leaf = regs[0];
+
+    cpuid(1, 0, regs);
+    if (regs[3] & (1u << 26)) features |= CPU_FEATURE_SSE2;
+
+    // AVX state must be enabled by the OS (OSXSAVE + XMM/YMM in XCR0)
+    int osxsave = (regs[2] & (1u << 27)) != 0;
+    unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+    int ymm_enabled = (xcr0 & 0x6) == 0x6;
+    int zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+    if (ymm_enabled && (regs[2] & (1u << 29))) features |= CPU_FEATURE_F16C;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, regs);
+        if (ymm_enabled && (regs[1] & (1u << 5))) features |= CPU_FEATURE_AVX2;
+        // AVX-512 kernels also use BW (EBX bit 30)
+        if (zmm_enabled && (regs[1] & (1u << 16)) && (regs[1] & (1u << 30))) {
+            features |= CPU_FEATURE_AVX512F;
+            if (regs[2] & (1u << 11)) features |= CPU_FEATURE_AVX512_VNNI;
+        }
+    }
+    return features;
+}
+#elif defined(CPU_ARM64)
+static int detect_features(void) {
+    int features = CPU_FEATURE_NEON;  // Baseline on AArch64
+#if defined(_WIN32)
+    if (IsProcessorFeaturePresent(PF_ARM_V82_DP_INSTRUCTIONS_AVAILABLE)) features |= CPU_FEATURE_NEON_DOTPROD;
+#elif defined(__linux__) && defined(HWCAP_ASIMDDP)
+    if (getauxval(AT_HWCAP) & HWCAP_ASIMDDP) features |= CPU_FEATURE_NEON_DOTPROD;
+#endif
+    return features;
+}
+#else
+static int detect_features(void) {
+    return 0;
+}
+#endif
+
+int cpu_features(void) {
+    // Detection is idempotent, so a racing first call just stores the same value twice
+    static volatile int features = -1;
+    if (features < 0) {
+        features = detect_features();
+    }
+    return features;
+}
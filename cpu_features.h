@@ -0,0 +1,37 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// Instruction set extensions usable by the SIMD kernels, detected once at runtime
+#define CPU_FEATURE_SSE2         0x01
+#define CPU_FEATURE_AVX2         0x02
+#define CPU_FEATURE_AVX512F      0x04
+#define CPU_FEATURE_AVX512_VNNI  0x08
+#define CPU_FEATURE_NEON         0x10
+#define CPU_FEATURE_NEON_DOTPROD 0x20
+#define CPU_FEATURE_F16C         0x40
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#endif
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define CPU_ARM64 1
+#endif
+
+// Per-function target attributes so kernels build without global -mavx2 flags (MSVC needs none)
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX2_F16C __attribute__((target("avx2,fma,f16c")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#define TARGET_AVX512_VNNI __attribute__((target("avx512f,avx512bw,avx512vnni")))
+#define TARGET_NEON_DOTPROD __attribute__((target("arch=armv8.2-a+dotprod")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX2_F16C
+#define TARGET_AVX512
+#define TARGET_AVX512_VNNI
+#define TARGET_NEON_DOTPROD
+#endif
+
+int cpu_features(void);
+
+#endif // CPU_FEATURES_H
@@ -0,0 +1,436 @@
+#include "enroll_pipeline.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Bounded blocking FIFO of pointers between two stages
+typedef struct BoundedQueue {
+    void** items;
+    int capacity;
+    int head;
+    int count;
+    int closed;
+    platform_mutex mutex;
+    platform_cond not_empty;
+    platform_cond not_full;
+} BoundedQueue;
+
+static int queue_init(BoundedQueue* queue, int capacity) {
+    queue->items = (void**)malloc((size_t)capacity * sizeof(void*));
+    if (queue->items == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    mutex_init(&queue->mutex);
+    cond_init(&queue->not_empty);
+    cond_init(&queue->not_full);
+    return 0;
+}
+
+static void queue_destroy(BoundedQueue* queue) {
+    if (queue->items == NULL) return;
+    free(queue->items);
+    queue->items = NULL;
+    mutex_destroy(&queue->mutex);
+    cond_destroy(&queue->not_empty);
+    cond_destroy(&queue->not_full);
+}
+
+// Blocks while the queue is full (back-pressure on the producing stage)
+static void queue_push(BoundedQueue* queue, void* item) {
+    mutex_lock(&queue->mutex);
+    while (queue->count == queue->capacity) {
+        cond_wait(&queue->not_full, &queue->mutex);
+    }
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+    cond_signal(&queue->not_empty);
+    mutex_unlock(&queue->mutex);
+}
+
+// Blocks for the first item, then takes whatever else is already queued up to max_items.
+// Returns 0 once the queue is closed and drained
+static int queue_pop_many(BoundedQueue* queue, void** items, int max_items) {
+    mutex_lock(&queue->mutex);
+    while (queue->count == 0 && !queue->closed) {
+        cond_wait(&queue->not_empty, &queue->mutex);
+    }
+    int n = queue->count < max_items ? queue->count : max_items;
+    for (int i = 0; i < n; i++) {
+        items[i] = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+    }
+    queue->count -= n;
+    if (n > 0) {
+        cond_broadcast(&queue->not_full);
+    }
+    mutex_unlock(&queue->mutex);
+    return n;
+}
+
+static void* queue_pop(BoundedQueue* queue) {
+    void* item = NULL;
+    return queue_pop_many(queue, &item, 1) == 1 ? item : NULL;
+}
+
+// Consumers drain what is left, then see an empty pop
+static void queue_close(BoundedQueue* queue) {
+    mutex_lock(&queue->mutex);
+    queue->closed = 1;
+    cond_broadcast(&queue->not_empty);
+    mutex_unlock(&queue->mutex);
+}
+
+typedef struct EnrollItem {
+    int64_t id;
+    char* filename;        // Owned copy for file requests, NULL for buffer requests
+    const uint8_t* data;
+    size_t size;
+    MappedFile file;       // Mapped by decode, released once preprocessed
+    BmpView view;
+    float* input;          // Pooled CHW tensor, held from preprocess until it is copied into a batch
+    float template_data[TEMPLATE_SIZE];
+    int status;
+} EnrollItem;
+
+typedef struct InferWorker {
+    EnrollPipeline* pipeline;
+    FingerprintContext* ctx;
+    float* output;         // max_batch templates
+} InferWorker;
+
+struct EnrollPipeline {
+    LiveGallery* store;
+    enroll_callback callback;
+    void* user_data;
+    int input_channels;
+    int max_batch;
+
+    // Stage queues in pipeline order, plus the pool of preprocessed input tensors
+    BoundedQueue requests;
+    BoundedQueue decoded;
+    BoundedQueue ready;
+    BoundedQueue done;
+    BoundedQueue free_inputs;
+    float* input_storage;
+
+    // Threads per stage, joined stage by stage on shutdown
+    platform_thread* decode_threads;
+    platform_thread* preprocess_threads;
+    platform_thread* infer_threads;
+    platform_thread store_thread;
+    int num_decode;
+    int num_preprocess;
+    int num_infer;
+    int store_started;
+    InferWorker* infer_workers;
+    int num_infer_workers;
+
+    // Submitted but not yet completed requests, for enroll_wait
+    platform_mutex pending_mutex;
+    platform_cond drained;
+    int64_t pending;
+};
+
+static void free_item(EnrollItem* item) {
+    unmap_file(&item->file);
+    free(item->filename);
+    free(item);
+}
+
+static void decode_main(void* arg) {
+    EnrollPipeline* pipeline = (EnrollPipeline*)arg;
+    EnrollItem* item;
+    while ((item = (EnrollItem*)queue_pop(&pipeline->requests)) != NULL) {
+        if (item->filename != NULL) {
+            if (map_file(item->filename, &item->file) != 0) {
+                fprintf(stderr, "Failed to read image: %s\n", item->filename);
+                item->status = -1;
+                queue_push(&pipeline->done, item);
+                continue;
+            }
+            item->data = (const uint8_t*)item->file.data;
+            item->size = item->file.size;
+        }
+
+        item->status = decode_bmp(item->data, item->size, &item->view);
+        queue_push(item->status == 0 ? &pipeline->decoded : &pipeline->done, item);
+    }
+}
+
+static void preprocess_main(void* arg) {
+    EnrollPipeline* pipeline = (EnrollPipeline*)arg;
+    EnrollItem* item;
+    while ((item = (EnrollItem*)queue_pop(&pipeline->decoded)) != NULL) {
+        // Waiting for a free tensor here is what bounds the preprocessed backlog
+        item->input = (float*)queue_pop(&pipeline->free_inputs);
+        item->status = preprocess_image_fused(item->view.pixels, item->view.width, item->view.height, item->view.stride, 1,
+            item->input, pipeline->input_channels, INPUT_WIDTH, INPUT_HEIGHT);
+
+        // The pixels have been consumed; drop the mapping before the item waits for inference
+        unmap_file(&item->file);
+
+        if (item->status != 0) {
+            queue_push(&pipeline->free_inputs, item->input);
+            item->input = NULL;
+            queue_push(&pipeline->done, item);
+            continue;
+        }
+        queue_push(&pipeline->ready, item);
+    }
+}
+
+static void infer_main(void* arg) {
+    InferWorker* worker = (InferWorker*)arg;
+    EnrollPipeline* pipeline = worker->pipeline;
+    size_t image_size = (size_t)pipeline->input_channels * INPUT_HEIGHT * INPUT_WIDTH;
+    EnrollItem* batch[MAX_BATCH_SIZE];
+    int batch_size;
+
+    // Run whatever is ready instead of waiting for a full batch: ORT stays busy and latency stays low
+    while ((batch_size = queue_pop_many(&pipeline->ready, (void**)batch, pipeline->max_batch)) > 0) {
+        for (int b = 0; b < batch_size; b++) {
+            memcpy(context_input(worker->ctx, b), batch[b]->input, image_size * sizeof(float));
+            queue_push(&pipeline->free_inputs, batch[b]->input);
+            batch[b]->input = NULL;
+        }
+
+        int status = context_run(worker->ctx, batch_size, worker->output);
+        for (int b = 0; b < batch_size; b++) {
+            batch[b]->status = status;
+            if (status == 0) {
+                memcpy(batch[b]->template_data, worker->output + (size_t)b * TEMPLATE_SIZE, TEMPLATE_SIZE * sizeof(float));
+            }
+            queue_push(&pipeline->done, batch[b]);
+        }
+    }
+}
+
+static void store_main(void* arg) {
+    EnrollPipeline* pipeline = (EnrollPipeline*)arg;
+    EnrollItem* item;
+    while ((item = (EnrollItem*)queue_pop(&pipeline->done)) != NULL) {
+        if (item->status == 0 && pipeline->store != NULL) {
+            item->status = live_gallery_append(pipeline->store, item->template_data, item->id);
+        }
+        if (pipeline->callback != NULL) {
+            pipeline->callback(pipeline->user_data, item->id, item->status, item->template_data);
+        }
+        free_item(item);
+
+        mutex_lock(&pipeline->pending_mutex);
+        if (--pipeline->pending == 0) {
+            cond_broadcast(&pipeline->drained);
+        }
+        mutex_unlock(&pipeline->pending_mutex);
+    }
+}
+
+static int start_stage(platform_thread** threads, int* started, int count, platform_thread_fn fn, void* arg, size_t arg_stride) {
+    *threads = (platform_thread*)malloc((size_t)count * sizeof(platform_thread));
+    if (*threads == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        if (thread_create(&(*threads)[i], fn, (char*)arg + i * arg_stride) != 0) {
+            fprintf(stderr, "Error: Failed to start enrollment thread\n");
+            return -1;
+        }
+        (*started)++;
+    }
+    return 0;
+}
+
+int create_enroll_pipeline(const OrtApi* g_ort, OrtSession* session, const EnrollConfig* config,
+    LiveGallery* store, enroll_callback callback, void* user_data, EnrollPipeline** out_pipeline) {
+    if (g_ort == NULL || session == NULL || out_pipeline == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    EnrollConfig settings = { 0 };
+    if (config != NULL) settings = *config;
+    if (settings.decode_threads <= 0) settings.decode_threads = 1;
+    if (settings.preprocess_threads <= 0) settings.preprocess_threads = cpu_count() / 4 > 1 ? cpu_count() / 4 : 1;
+    if (settings.infer_threads <= 0) settings.infer_threads = 1;
+    if (settings.max_batch <= 0 || settings.max_batch > MAX_BATCH_SIZE) settings.max_batch = MAX_BATCH_SIZE;
+    if (settings.queue_depth <= 0) settings.queue_depth = 2 * settings.max_batch;
+
+    int input_channels = model_input_channels(g_ort, session);
+    if (input_channels <= 0) return -1;
+
+    EnrollPipeline* pipeline = (EnrollPipeline*)calloc(1, sizeof(EnrollPipeline));
+    if (pipeline == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    pipeline->store = store;
+    pipeline->callback = callback;
+    pipeline->user_data = user_data;
+    pipeline->input_channels = input_channels;
+    mutex_init(&pipeline->pending_mutex);
+    cond_init(&pipeline->drained);
+
+    // One context per inference thread; the session itself is shared
+    pipeline->infer_workers = (InferWorker*)calloc(settings.infer_threads, sizeof(InferWorker));
+    if (pipeline->infer_workers == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        clean_enroll_pipeline(pipeline);
+        return -1;
+    }
+    pipeline->num_infer_workers = settings.infer_threads;
+    pipeline->max_batch = settings.max_batch;
+    for (int i = 0; i < settings.infer_threads; i++) {
+        InferWorker* worker = &pipeline->infer_workers[i];
+        worker->pipeline = pipeline;
+        if (create_context(g_ort, session, settings.max_batch, &worker->ctx) != 0) {
+            clean_enroll_pipeline(pipeline);
+            return -1;
+        }
+        // The model may cap the batch below the requested size
+        if (context_max_batch(worker->ctx) < pipeline->max_batch) {
+            pipeline->max_batch = context_max_batch(worker->ctx);
+        }
+        worker->output = (float*)malloc((size_t)settings.max_batch * TEMPLATE_SIZE * sizeof(float));
+        if (worker->output == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            clean_enroll_pipeline(pipeline);
+            return -1;
+        }
+    }
+
+    // Enough preprocessed tensors to fill a batch while the previous one is being copied out
+    int depth = settings.queue_depth < pipeline->max_batch ? pipeline->max_batch : settings.queue_depth;
+    size_t image_size = (size_t)input_channels * INPUT_HEIGHT * INPUT_WIDTH;
+    pipeline->input_storage = (float*)aligned_malloc((size_t)depth * image_size * sizeof(float), MEMORY_ALIGNMENT);
+    if (pipeline->input_storage == NULL || queue_init(&pipeline->requests, depth) != 0 ||
+        queue_init(&pipeline->decoded, depth) != 0 || queue_init(&pipeline->ready, depth) != 0 ||
+        queue_init(&pipeline->done, depth) != 0 || queue_init(&pipeline->free_inputs, depth) != 0) {
+        if (pipeline->input_storage == NULL) fprintf(stderr, "Error: Memory allocation failed\n");
+        clean_enroll_pipeline(pipeline);
+        return -1;
+    }
+    for (int i = 0; i < depth; i++) {
+        queue_push(&pipeline->free_inputs, pipeline->input_storage + (size_t)i * image_size);
+    }
+
+    // Start consumers before producers so nothing is queued into a stage with no threads
+    if (thread_create(&pipeline->store_thread, store_main, pipeline) != 0) {
+        fprintf(stderr, "Error: Failed to start enrollment thread\n");
+        clean_enroll_pipeline(pipeline);
+        return -1;
+    }
+    pipeline->store_started = 1;
+    if (start_stage(&pipeline->infer_threads, &pipeline->num_infer, settings.infer_threads, infer_main,
+            pipeline->infer_workers, sizeof(InferWorker)) != 0 ||
+        start_stage(&pipeline->preprocess_threads, &pipeline->num_preprocess, settings.preprocess_threads, preprocess_main, pipeline, 0) != 0 ||
+        start_stage(&pipeline->decode_threads, &pipeline->num_decode, settings.decode_threads, decode_main, pipeline, 0) != 0) {
+        clean_enroll_pipeline(pipeline);
+        return -1;
+    }
+
+    *out_pipeline = pipeline;
+    return 0;
+}
+
+static int submit_item(EnrollPipeline* pipeline, EnrollItem* item) {
+    mutex_lock(&pipeline->pending_mutex);
+    pipeline->pending++;
+    mutex_unlock(&pipeline->pending_mutex);
+
+    queue_push(&pipeline->requests, item);
+    return 0;
+}
+
+int enroll_submit(EnrollPipeline* pipeline, const char* image_filename, int64_t id) {
+    if (pipeline == NULL || image_filename == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    EnrollItem* item = (EnrollItem*)calloc(1, sizeof(EnrollItem));
+    size_t length = strlen(image_filename) + 1;
+    char* filename = (char*)malloc(length);
+    if (item == NULL || filename == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(item);
+        free(filename);
+        return -1;
+    }
+    memcpy(filename, image_filename, length);
+    item->id = id;
+    item->filename = filename;
+    return submit_item(pipeline, item);
+}
+
+int enroll_submit_buffer(EnrollPipeline* pipeline, const uint8_t* data, size_t size, int64_t id) {
+    if (pipeline == NULL || data == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    EnrollItem* item = (EnrollItem*)calloc(1, sizeof(EnrollItem));
+    if (item == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    item->id = id;
+    item->data = data;
+    item->size = size;
+    return submit_item(pipeline, item);
+}
+
+void enroll_wait(EnrollPipeline* pipeline) {
+    if (pipeline == NULL) return;
+
+    mutex_lock(&pipeline->pending_mutex);
+    while (pipeline->pending > 0) {
+        cond_wait(&pipeline->drained, &pipeline->pending_mutex);
+    }
+    mutex_unlock(&pipeline->pending_mutex);
+}
+
+// Closing a queue only after every thread feeding it has exited lets each stage drain completely
+static void stop_stage(BoundedQueue* input, platform_thread* threads, int count) {
+    if (input->items != NULL) queue_close(input);
+    for (int i = 0; i < count; i++) {
+        thread_join(threads[i]);
+    }
+}
+
+void clean_enroll_pipeline(EnrollPipeline* pipeline) {
+    if (pipeline == NULL) return;
+
+    stop_stage(&pipeline->requests, pipeline->decode_threads, pipeline->num_decode);
+    stop_stage(&pipeline->decoded, pipeline->preprocess_threads, pipeline->num_preprocess);
+    stop_stage(&pipeline->ready, pipeline->infer_threads, pipeline->num_infer);
+    stop_stage(&pipeline->done, &pipeline->store_thread, pipeline->store_started);
+
+    queue_destroy(&pipeline->requests);
+    queue_destroy(&pipeline->decoded);
+    queue_destroy(&pipeline->ready);
+    queue_destroy(&pipeline->done);
+    queue_destroy(&pipeline->free_inputs);
+    aligned_free(pipeline->input_storage);
+
+    if (pipeline->infer_workers != NULL) {
+        for (int i = 0; i < pipeline->num_infer_workers; i++) {
+            clean_context(pipeline->infer_workers[i].ctx);
+            free(pipeline->infer_workers[i].output);
+        }
+    }
+    free(pipeline->infer_workers);
+    free(pipeline->decode_threads);
+    free(pipeline->preprocess_threads);
+    free(pipeline->infer_threads);
+
+    mutex_destroy(&pipeline->pending_mutex);
+    cond_destroy(&pipeline->drained);
+    free(pipeline);
+}
@@ -0,0 +1,42 @@
+#ifndef ENROLL_PIPELINE_H
+#define ENROLL_PIPELINE_H
+
+#include "config.h"
+#include "template.h"
+#include "live_gallery.h"
+
+// Bulk enrollment as four overlapping stages connected by bounded queues:
+// decode (map + validate the BMP) -> preprocess (fused resize/normalize into a pooled
+// input tensor) -> infer (batches of up to max_batch per ORT run) -> store (optional
+// append to a live gallery, then the completion callback). While one batch runs in ORT
+// the next one is being decoded and preprocessed. Full queues block the stage feeding
+// them, so a fast producer waits in enroll_submit instead of growing memory.
+typedef struct EnrollPipeline EnrollPipeline;
+
+// Runs on the store thread once per request. status is 0 on success, -1 if the image
+// could not be read or inferred; template_data is only valid during the call
+typedef void (*enroll_callback)(void* user_data, int64_t id, int status, const float* template_data);
+
+// Zero (or negative) fields select the defaults
+typedef struct EnrollConfig {
+    int decode_threads;      // default 1
+    int preprocess_threads;  // default: a quarter of the logical processors, at least 1
+    int infer_threads;       // concurrent ORT runs, each with its own context; default 1
+    int max_batch;           // images per ORT run; default MAX_BATCH_SIZE
+    int queue_depth;         // capacity of each queue between stages; default 2 * max_batch
+} EnrollConfig;
+
+// API function
+// store may be NULL; callback may be NULL when only the gallery append is wanted
+DllAPI int create_enroll_pipeline(const OrtApi* g_ort, OrtSession* session, const EnrollConfig* config,
+    LiveGallery* store, enroll_callback callback, void* user_data, EnrollPipeline** out_pipeline);
+// Queue one BMP file; blocks while the pipeline is full
+DllAPI int enroll_submit(EnrollPipeline* pipeline, const char* image_filename, int64_t id);
+// Queue one BMP held in memory; the buffer must stay valid until its callback has run
+DllAPI int enroll_submit_buffer(EnrollPipeline* pipeline, const uint8_t* data, size_t size, int64_t id);
+// Blocks until every request submitted so far has completed
+DllAPI void enroll_wait(EnrollPipeline* pipeline);
+// Finishes all submitted requests, then stops the stage threads
+DllAPI void clean_enroll_pipeline(EnrollPipeline* pipeline);
+
+#endif // ENROLL_PIPELINE_H
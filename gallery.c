@@ -0,0 +1,340 @@
+#include "gallery.h"
+#include "platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Same magnitude as cosine_similarity, which adds eps per element before the sqrt; returns it
+float normalize_template(const float* template_data, float* normalized_template) {
+	float eps = 1e-8;
+	float magnitude = 0.0;
+
+	for (int i = 0; i < TEMPLATE_SIZE; ++i) {
+		magnitude += template_data[i] * template_data[i] + eps;
+	}
+	magnitude = sqrtf(magnitude);
+
+	for (int i = 0; i < TEMPLATE_SIZE; ++i) {
+		normalized_template[i] = magnitude == 0 ? 0.0f : template_data[i] / magnitude;
+	}
+	return magnitude;
+}
+
+typedef struct ShardCopy {
+	float* dst;
+	const float* src;
+	int size;
+} ShardCopy;
+
+// Runs on the worker that will score the shard, so its pages are first touched there
+static void copy_shard(void* arg, int shard, int thread_index) {
+	ShardCopy* copy = (ShardCopy*)arg;
+	(void)thread_index;
+
+	size_t begin = (size_t)shard * GALLERY_SHARD_SIZE;
+	size_t count = copy->size - begin < GALLERY_SHARD_SIZE ? copy->size - begin : GALLERY_SHARD_SIZE;
+	memcpy(copy->dst + begin * TEMPLATE_SIZE, copy->src + begin * TEMPLATE_SIZE, count * TEMPLATE_SIZE * sizeof(float));
+}
+
+static void copy_templates(const Gallery* gallery, float* dst) {
+	if (gallery->size == 0) return;
+
+	if (gallery->pool != NULL) {
+		ShardCopy copy = { dst, gallery->templates, gallery->size };
+		thread_pool_run(gallery->pool, copy_shard, &copy, (gallery->size + GALLERY_SHARD_SIZE - 1) / GALLERY_SHARD_SIZE);
+	}
+	else {
+		memcpy(dst, gallery->templates, (size_t)gallery->size * TEMPLATE_SIZE * sizeof(float));
+	}
+}
+
+static int reserve_gallery(Gallery* gallery, int capacity) {
+	if (capacity <= gallery->capacity) return 0;
+
+	float* templates = (float*)aligned_malloc((size_t)capacity * TEMPLATE_SIZE * sizeof(float), MEMORY_ALIGNMENT);
+	float* norms = (float*)malloc((size_t)capacity * sizeof(float));
+	int64_t* ids = (int64_t*)malloc((size_t)capacity * sizeof(int64_t));
+	if (templates == NULL || norms == NULL || ids == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		aligned_free(templates);
+		free(norms);
+		free(ids);
+		return -1;
+	}
+
+	if (gallery->size > 0) {
+		copy_templates(gallery, templates);
+		memcpy(norms, gallery->norms, (size_t)gallery->size * sizeof(float));
+		memcpy(ids, gallery->ids, (size_t)gallery->size * sizeof(int64_t));
+	}
+	aligned_free(gallery->templates);
+	free(gallery->norms);
+	free(gallery->ids);
+
+	gallery->templates = templates;
+	gallery->norms = norms;
+	gallery->ids = ids;
+	gallery->capacity = capacity;
+	return 0;
+}
+
+// API function
+int create_gallery(int capacity, Gallery** out_gallery) {
+	if (capacity < 0 || out_gallery == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	Gallery* gallery = (Gallery*)calloc(1, sizeof(Gallery));
+	if (gallery == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+	if (reserve_gallery(gallery, capacity > 0 ? capacity : 1) != 0) {
+		free(gallery);
+		return -1;
+	}
+
+	*out_gallery = gallery;
+	return 0;
+}
+
+// Builds a gallery from the legacy float** database; ids are the db indices
+int gallery_from_templates(float** template_db, int db_size, Gallery** out_gallery) {
+	if (template_db == NULL || db_size < 0 || out_gallery == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	Gallery* gallery = NULL;
+	if (create_gallery(db_size, &gallery) != 0) return -1;
+
+	// A skipped template would shift every later row off its db index
+	for (int i = 0; i < db_size; i++) {
+		if (add_to_gallery(gallery, template_db[i], i) != 0) {
+			clean_gallery(gallery);
+			return -1;
+		}
+	}
+
+	*out_gallery = gallery;
+	return 0;
+}
+
+int add_to_gallery(Gallery* gallery, const float* template_data, int64_t id) {
+	if (gallery == NULL || template_data == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	if (gallery->read_only) {
+		fprintf(stderr, "Error: Gallery is read-only\n");
+		return -1;
+	}
+	if (gallery->size == gallery->capacity && reserve_gallery(gallery, gallery->capacity * 2) != 0) {
+		return -1;
+	}
+
+	gallery->norms[gallery->size] = normalize_template(template_data, gallery->templates + (size_t)gallery->size * TEMPLATE_SIZE);
+	gallery->ids[gallery->size] = id;
+	gallery->size++;
+	return 0;
+}
+
+void gallery_swap_remove(Gallery* gallery, int row) {
+	int last = gallery->size - 1;
+	if (row != last) {
+		memcpy(gallery->templates + (size_t)row * TEMPLATE_SIZE, gallery->templates + (size_t)last * TEMPLATE_SIZE,
+			TEMPLATE_SIZE * sizeof(float));
+		gallery->norms[row] = gallery->norms[last];
+		gallery->ids[row] = gallery->ids[last];
+	}
+	gallery->size--;
+}
+
+int gallery_set_thread_pool(Gallery* gallery, ThreadPool* pool) {
+	if (gallery == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	gallery->pool = pool;
+	// Mapped rows stay where the page cache put them
+	if (pool == NULL || gallery->size == 0 || gallery->read_only) return 0;
+
+	// Fresh block whose pages are first touched by the owning workers
+	float* templates = (float*)aligned_malloc((size_t)gallery->capacity * TEMPLATE_SIZE * sizeof(float), MEMORY_ALIGNMENT);
+	if (templates == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+	copy_templates(gallery, templates);
+	aligned_free(gallery->templates);
+	gallery->templates = templates;
+	return 0;
+}
+
+void clean_gallery(Gallery* gallery) {
+	if (gallery == NULL) return;
+
+	// Read-only galleries are views into a mapping owned elsewhere (or by this gallery)
+	if (!gallery->read_only) {
+		aligned_free(gallery->templates);
+		free(gallery->norms);
+		free(gallery->ids);
+	}
+	if (gallery->mapping != NULL) {
+		unmap_file(gallery->mapping);
+		free(gallery->mapping);
+	}
+	free(gallery);
+}
+
+// Round-to-nearest-even float -> IEEE half, saturating to infinity
+uint16_t float_to_half(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t exponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff) return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	int half_exponent = (int)exponent - 127 + 15;
+	if (half_exponent >= 31) return (uint16_t)(sign | 0x7c00);
+	if (half_exponent <= 0) {
+		// Subnormal half: shift in the implicit bit, round to nearest even
+		if (half_exponent < -10) return (uint16_t)sign;
+		mantissa |= 0x800000;
+		int shift = 14 - half_exponent;
+		uint32_t half_mantissa = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half_mantissa & 1))) half_mantissa++;
+		return (uint16_t)(sign | half_mantissa);
+	}
+
+	uint32_t half = sign | ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+	// A mantissa carry correctly rolls over into the exponent
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+	return (uint16_t)half;
+}
+
+float half_to_float(uint16_t value) {
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+	uint32_t bits;
+
+	if (exponent == 0) {
+		if (mantissa == 0) {
+			bits = sign;
+		}
+		else {
+			// Normalize the subnormal
+			exponent = 127 - 15 + 1;
+			while ((mantissa & 0x400) == 0) {
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+	}
+	else if (exponent == 0x1f) {
+		bits = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else {
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+float quantize_int8(const float* values, size_t count, float max_abs, int8_t* codes) {
+	if (max_abs <= 0.0f) {
+		memset(codes, 0, count);
+		return 0.0f;
+	}
+	float inverse = 127.0f / max_abs;
+	for (size_t i = 0; i < count; i++) {
+		float code = roundf(values[i] * inverse);
+		codes[i] = (int8_t)(code > 127.0f ? 127.0f : code < -127.0f ? -127.0f : code);
+	}
+	return max_abs / 127.0f;
+}
+
+static float max_abs_value(const float* values, size_t count) {
+	float max_abs = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		float value = fabsf(values[i]);
+		if (value > max_abs) max_abs = value;
+	}
+	return max_abs;
+}
+
+int quantize_gallery(const Gallery* gallery, int encoding, QuantizedGallery** out_quantized) {
+	if (gallery == NULL || out_quantized == NULL ||
+		(encoding != GALLERY_ENCODING_INT8 && encoding != GALLERY_ENCODING_INT8_GLOBAL && encoding != GALLERY_ENCODING_FP16)) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	size_t values = (size_t)gallery->size * TEMPLATE_SIZE;
+	size_t code_size = encoding == GALLERY_ENCODING_FP16 ? sizeof(uint16_t) : sizeof(int8_t);
+	QuantizedGallery* quantized = (QuantizedGallery*)calloc(1, sizeof(QuantizedGallery));
+	if (quantized == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+	quantized->encoding = encoding;
+
+	// An empty gallery has no rows to encode; searches over it return no matches
+	if (gallery->size == 0) {
+		*out_quantized = quantized;
+		return 0;
+	}
+
+	quantized->codes = aligned_malloc(values * code_size, MEMORY_ALIGNMENT);
+	quantized->ids = (int64_t*)malloc((size_t)gallery->size * sizeof(int64_t));
+	if (encoding == GALLERY_ENCODING_INT8) {
+		quantized->scales = (float*)malloc((size_t)gallery->size * sizeof(float));
+	}
+	if (quantized->codes == NULL || quantized->ids == NULL ||
+		(encoding == GALLERY_ENCODING_INT8 && quantized->scales == NULL)) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		clean_quantized_gallery(quantized);
+		return -1;
+	}
+	quantized->size = gallery->size;
+	memcpy(quantized->ids, gallery->ids, (size_t)gallery->size * sizeof(int64_t));
+
+	if (encoding == GALLERY_ENCODING_FP16) {
+		uint16_t* codes = (uint16_t*)quantized->codes;
+		for (size_t i = 0; i < values; i++) {
+			codes[i] = float_to_half(gallery->templates[i]);
+		}
+	}
+	else if (encoding == GALLERY_ENCODING_INT8) {
+		for (int r = 0; r < gallery->size; r++) {
+			const float* row = gallery->templates + (size_t)r * TEMPLATE_SIZE;
+			quantized->scales[r] = quantize_int8(row, TEMPLATE_SIZE, max_abs_value(row, TEMPLATE_SIZE),
+				(int8_t*)quantized->codes + (size_t)r * TEMPLATE_SIZE);
+		}
+	}
+	else {
+		float max_abs = max_abs_value(gallery->templates, values);
+		quantized->scale = quantize_int8(gallery->templates, values, max_abs, (int8_t*)quantized->codes);
+	}
+
+	*out_quantized = quantized;
+	return 0;
+}
+
+void clean_quantized_gallery(QuantizedGallery* quantized) {
+	if (quantized == NULL) return;
+
+	aligned_free(quantized->codes);
+	free(quantized->scales);
+	free(quantized->ids);
+	free(quantized);
+}
@@ -0,0 +1,60 @@
+#ifndef GALLERY_H
+#define GALLERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "thread_pool.h"
+
+// Rows per parallel work unit: 1 MB of templates, roughly one core's L2
+#define GALLERY_SHARD_SIZE 4096
+
+// Contiguous 1:N template store. Templates are L2-normalized on insert, so a cosine
+// distance against a normalized query is 1 - dot product.
+typedef struct Gallery {
+	float* templates;   // size x TEMPLATE_SIZE, row-major, MEMORY_ALIGNMENT-aligned
+	float* norms;       // Magnitude of each template before normalization
+	int64_t* ids;       // Caller-supplied id per row
+	int size;
+	int capacity;
+	ThreadPool* pool;   // Optional; shard s is placed on and scored by worker s % threads
+	int read_only;      // Rows live in a file mapping and cannot be added or moved
+	const volatile uint8_t* tombstones;  // Optional; non-zero rows are skipped by top-K searches
+	struct MappedFile* mapping;  // Owned mapping to release in clean_gallery, if any
+} Gallery;
+
+// Compact encodings of a gallery's normalized rows
+#define GALLERY_ENCODING_INT8        1   // int8 codes with one scale per row (68 B/row)
+#define GALLERY_ENCODING_INT8_GLOBAL 2   // int8 codes with one scale for the whole gallery (64 B/row)
+#define GALLERY_ENCODING_FP16        3   // IEEE half precision (128 B/row)
+
+// Read-only quantized copy of a Gallery. Row r matches row r of the source gallery,
+// so the source (or a mapped copy of it) can rerank candidates in fp32.
+typedef struct QuantizedGallery {
+	int encoding;
+	void* codes;        // size x TEMPLATE_SIZE int8_t or uint16_t, MEMORY_ALIGNMENT-aligned
+	float* scales;      // Per-row dequantization scale (GALLERY_ENCODING_INT8 only)
+	float scale;        // Global dequantization scale (GALLERY_ENCODING_INT8_GLOBAL only)
+	int64_t* ids;
+	int size;
+} QuantizedGallery;
+
+float normalize_template(const float* template_data, float* normalized_template);
+uint16_t float_to_half(float value);
+float half_to_float(uint16_t value);
+// Removes a row by moving the last row into its place
+void gallery_swap_remove(Gallery* gallery, int row);
+// Symmetric int8 codes in [-127, 127]; returns the dequantization scale
+float quantize_int8(const float* values, size_t count, float max_abs, int8_t* codes);
+
+// API function
+DllAPI int create_gallery(int capacity, Gallery** out_gallery);
+DllAPI int gallery_from_templates(float** template_db, int db_size, Gallery** out_gallery);
+DllAPI int add_to_gallery(Gallery* gallery, const float* template_data, int64_t id);
+// Attaches a pool (not owned) for searches and re-places shards in the workers' local memory
+DllAPI int gallery_set_thread_pool(Gallery* gallery, ThreadPool* pool);
+DllAPI void clean_gallery(Gallery* gallery);
+DllAPI int quantize_gallery(const Gallery* gallery, int encoding, QuantizedGallery** out_quantized);
+DllAPI void clean_quantized_gallery(QuantizedGallery* quantized);
+
+#endif // GALLERY_H
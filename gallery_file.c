@@ -0,0 +1,176 @@
+#include "gallery_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t align_offset(uint64_t offset) {
+	return (offset + GALLERY_FILE_ALIGNMENT - 1) & ~(uint64_t)(GALLERY_FILE_ALIGNMENT - 1);
+}
+
+// Zero-fills up to the next section boundary
+static int pad_to(FILE* file, uint64_t* position, uint64_t offset) {
+	static const char zeros[256] = { 0 };
+	while (*position < offset) {
+		size_t chunk = offset - *position < sizeof(zeros) ? (size_t)(offset - *position) : sizeof(zeros);
+		if (fwrite(zeros, 1, chunk, file) != chunk) return -1;
+		*position += chunk;
+	}
+	return 0;
+}
+
+int write_gallery_file(const char* filename, const GallerySegment* segments, int num_segments,
+	uint32_t index_kind, const void* index_data, size_t index_size) {
+	uint64_t count = 0;
+	for (int s = 0; s < num_segments; s++) {
+		count += (uint64_t)segments[s].count;
+	}
+
+	GalleryFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, GALLERY_FILE_MAGIC, sizeof(header.magic));
+	header.version = GALLERY_FILE_VERSION;
+	header.template_size = TEMPLATE_SIZE;
+	header.count = count;
+	header.templates_offset = align_offset(sizeof(header));
+	header.norms_offset = align_offset(header.templates_offset + count * TEMPLATE_SIZE * sizeof(float));
+	header.ids_offset = align_offset(header.norms_offset + count * sizeof(float));
+	header.file_size = header.ids_offset + count * sizeof(int64_t);
+	if (index_kind != GALLERY_INDEX_NONE) {
+		header.index_kind = index_kind;
+		header.index_offset = align_offset(header.file_size);
+		header.index_size = index_size;
+		header.file_size = header.index_offset + index_size;
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Error: Could not open file %s\n", filename);
+		return -1;
+	}
+
+	uint64_t position = 0;
+	int status = fwrite(&header, sizeof(header), 1, file) == 1 ? 0 : -1;
+	position += sizeof(header);
+
+	status = status == 0 ? pad_to(file, &position, header.templates_offset) : -1;
+	for (int s = 0; s < num_segments && status == 0; s++) {
+		size_t values = (size_t)segments[s].count * TEMPLATE_SIZE;
+		if (fwrite(segments[s].templates, sizeof(float), values, file) != values) status = -1;
+		position += values * sizeof(float);
+	}
+	status = status == 0 ? pad_to(file, &position, header.norms_offset) : -1;
+	for (int s = 0; s < num_segments && status == 0; s++) {
+		if (fwrite(segments[s].norms, sizeof(float), segments[s].count, file) != (size_t)segments[s].count) status = -1;
+		position += (uint64_t)segments[s].count * sizeof(float);
+	}
+	status = status == 0 ? pad_to(file, &position, header.ids_offset) : -1;
+	for (int s = 0; s < num_segments && status == 0; s++) {
+		if (fwrite(segments[s].ids, sizeof(int64_t), segments[s].count, file) != (size_t)segments[s].count) status = -1;
+		position += (uint64_t)segments[s].count * sizeof(int64_t);
+	}
+	if (status == 0 && index_kind != GALLERY_INDEX_NONE) {
+		status = pad_to(file, &position, header.index_offset);
+		if (status == 0 && fwrite(index_data, 1, index_size, file) != index_size) status = -1;
+	}
+
+	if (fclose(file) != 0) status = -1;
+	if (status != 0) {
+		fprintf(stderr, "Error: Failed to write gallery file %s\n", filename);
+	}
+	return status;
+}
+
+static int section_fits(uint64_t offset, uint64_t size, uint64_t file_size) {
+	return offset % GALLERY_FILE_ALIGNMENT == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+int open_gallery_file(const char* filename, MappedFile* file, const GalleryFileHeader** out_header) {
+	if (map_file(filename, file) != 0) {
+		fprintf(stderr, "Error: Could not map file %s\n", filename);
+		return -1;
+	}
+
+	const GalleryFileHeader* header = (const GalleryFileHeader*)file->data;
+	const char* error = NULL;
+	if (file->size < sizeof(GalleryFileHeader) || memcmp(header->magic, GALLERY_FILE_MAGIC, sizeof(header->magic)) != 0) {
+		error = "not a gallery file";
+	}
+	else if (header->version != GALLERY_FILE_VERSION) {
+		error = "unsupported version";
+	}
+	else if (header->template_size != TEMPLATE_SIZE) {
+		error = "template size mismatch";
+	}
+	else if (header->file_size != file->size || header->count > INT32_MAX ||
+		!section_fits(header->templates_offset, header->count * TEMPLATE_SIZE * sizeof(float), file->size) ||
+		!section_fits(header->norms_offset, header->count * sizeof(float), file->size) ||
+		!section_fits(header->ids_offset, header->count * sizeof(int64_t), file->size) ||
+		(header->index_kind != GALLERY_INDEX_NONE && !section_fits(header->index_offset, header->index_size, file->size))) {
+		error = "truncated or corrupt";
+	}
+
+	if (error != NULL) {
+		fprintf(stderr, "Error: Gallery file %s is %s\n", filename, error);
+		unmap_file(file);
+		return -1;
+	}
+	*out_header = header;
+	return 0;
+}
+
+int gallery_view(const MappedFile* file, const GalleryFileHeader* header, int begin, int count, Gallery** out_gallery) {
+	Gallery* gallery = (Gallery*)calloc(1, sizeof(Gallery));
+	if (gallery == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+
+	// The mapping is never written: read_only keeps every mutating path away from it
+	const char* base = (const char*)file->data;
+	gallery->templates = (float*)(base + header->templates_offset) + (size_t)begin * TEMPLATE_SIZE;
+	gallery->norms = (float*)(base + header->norms_offset) + begin;
+	gallery->ids = (int64_t*)(base + header->ids_offset) + begin;
+	gallery->size = count;
+	gallery->capacity = count;
+	gallery->read_only = 1;
+
+	*out_gallery = gallery;
+	return 0;
+}
+
+// API function
+int save_gallery(const char* filename, const Gallery* gallery) {
+	if (filename == NULL || gallery == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	GallerySegment segment = { gallery->templates, gallery->norms, gallery->ids, gallery->size };
+	return write_gallery_file(filename, &segment, 1, GALLERY_INDEX_NONE, NULL, 0);
+}
+
+int map_gallery(const char* filename, Gallery** out_gallery) {
+	if (filename == NULL || out_gallery == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	MappedFile* file = (MappedFile*)malloc(sizeof(MappedFile));
+	const GalleryFileHeader* header = NULL;
+	if (file == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+	if (open_gallery_file(filename, file, &header) != 0) {
+		free(file);
+		return -1;
+	}
+	if (gallery_view(file, header, 0, (int)header->count, out_gallery) != 0) {
+		unmap_file(file);
+		free(file);
+		return -1;
+	}
+
+	(*out_gallery)->mapping = file;
+	return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef GALLERY_FILE_H
+#define GALLERY_FILE_H
+
+#include <stdint.h>
+#include "config.h"
+#include "gallery.h"
+#include "platform.h"
+
+// On-disk gallery, little-endian, designed to be mapped and used in place:
+//   header | templates (count x TEMPLATE_SIZE fp32) | norms (count fp32) | ids (count int64) | [index]
+// Every section starts on a GALLERY_FILE_ALIGNMENT boundary so mapped rows keep the
+// alignment the SIMD kernels expect.
+#define GALLERY_FILE_MAGIC "FPGALLRY"
+#define GALLERY_FILE_VERSION 1
+#define GALLERY_FILE_ALIGNMENT 4096
+
+// Index section kinds
+#define GALLERY_INDEX_NONE 0
+#define GALLERY_INDEX_IVF_FLAT 1
+
+typedef struct GalleryFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t template_size;
+	uint64_t count;
+	uint64_t templates_offset;
+	uint64_t norms_offset;
+	uint64_t ids_offset;
+	uint32_t index_kind;
+	uint32_t reserved;
+	uint64_t index_offset;
+	uint64_t index_size;
+	uint64_t file_size;
+} GalleryFileHeader;
+
+// Consecutive rows written to the template block; several segments are concatenated
+typedef struct GallerySegment {
+	const float* templates;
+	const float* norms;
+	const int64_t* ids;
+	int count;
+} GallerySegment;
+
+int write_gallery_file(const char* filename, const GallerySegment* segments, int num_segments,
+	uint32_t index_kind, const void* index_data, size_t index_size);
+// Maps and validates a gallery file; the header points into the mapping
+int open_gallery_file(const char* filename, MappedFile* file, const GalleryFileHeader** out_header);
+// Read-only Gallery over rows [begin, begin + count) of a mapped file
+int gallery_view(const MappedFile* file, const GalleryFileHeader* header, int begin, int count, Gallery** out_gallery);
+
+// API function
+DllAPI int save_gallery(const char* filename, const Gallery* gallery);
+// Maps a saved gallery; the result is read-only and shares the page cache with other processes
+DllAPI int map_gallery(const char* filename, Gallery** out_gallery);
+
+#endif // GALLERY_FILE_H
@@ -0,0 +1,110 @@
+#include "id_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// splitmix64 finalizer: sequential ids spread evenly over the table
+static size_t hash_id(int64_t key, size_t capacity) {
+	uint64_t x = (uint64_t)key;
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return (size_t)x & (capacity - 1);
+}
+
+static int allocate_table(IdMap* map, size_t capacity) {
+	map->keys = (int64_t*)malloc(capacity * sizeof(int64_t));
+	map->values = (int64_t*)malloc(capacity * sizeof(int64_t));
+	map->used = (uint8_t*)calloc(capacity, sizeof(uint8_t));
+	if (map->keys == NULL || map->values == NULL || map->used == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		id_map_free(map);
+		return -1;
+	}
+	map->capacity = capacity;
+	map->size = 0;
+	return 0;
+}
+
+int id_map_init(IdMap* map, size_t expected_size) {
+	size_t capacity = 16;
+	while (capacity * 7 / 10 < expected_size) capacity *= 2;
+	return allocate_table(map, capacity);
+}
+
+void id_map_free(IdMap* map) {
+	free(map->keys);
+	free(map->values);
+	free(map->used);
+	map->keys = NULL;
+	map->values = NULL;
+	map->used = NULL;
+	map->capacity = 0;
+	map->size = 0;
+}
+
+static int grow(IdMap* map) {
+	IdMap old = *map;
+	if (allocate_table(map, old.capacity * 2) != 0) {
+		*map = old;
+		return -1;
+	}
+	for (size_t i = 0; i < old.capacity; i++) {
+		if (old.used[i]) id_map_put(map, old.keys[i], old.values[i]);
+	}
+	id_map_free(&old);
+	return 0;
+}
+
+int id_map_put(IdMap* map, int64_t key, int64_t value) {
+	if ((map->size + 1) * 10 > map->capacity * 7 && grow(map) != 0) return -1;
+
+	size_t slot = hash_id(key, map->capacity);
+	while (map->used[slot] && map->keys[slot] != key) {
+		slot = (slot + 1) & (map->capacity - 1);
+	}
+	if (!map->used[slot]) {
+		map->used[slot] = 1;
+		map->keys[slot] = key;
+		map->size++;
+	}
+	map->values[slot] = value;
+	return 0;
+}
+
+int64_t* id_map_get(const IdMap* map, int64_t key) {
+	if (map->capacity == 0) return NULL;
+
+	size_t slot = hash_id(key, map->capacity);
+	while (map->used[slot]) {
+		if (map->keys[slot] == key) return &map->values[slot];
+		slot = (slot + 1) & (map->capacity - 1);
+	}
+	return NULL;
+}
+
+int id_map_remove(IdMap* map, int64_t key) {
+	int64_t* value = id_map_get(map, key);
+	if (value == NULL) return -1;
+
+	size_t mask = map->capacity - 1;
+	size_t hole = (size_t)(value - map->values);
+	map->used[hole] = 0;
+	map->size--;
+
+	// Shift later entries of the probe run back so lookups never stop at the hole early
+	size_t slot = (hole + 1) & mask;
+	while (map->used[slot]) {
+		size_t home = hash_id(map->keys[slot], map->capacity);
+		if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+			map->keys[hole] = map->keys[slot];
+			map->values[hole] = map->values[slot];
+			map->used[hole] = 1;
+			map->used[slot] = 0;
+			hole = slot;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return 0;
+}
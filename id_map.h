@@ -0,0 +1,23 @@
+#ifndef ID_MAP_H
+#define ID_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Open-addressing int64 -> int64 hash map (linear probing, backward-shift deletion)
+typedef struct IdMap {
+	int64_t* keys;
+	int64_t* values;
+	uint8_t* used;
+	size_t capacity;    // Power of two
+	size_t size;
+} IdMap;
+
+int id_map_init(IdMap* map, size_t expected_size);
+void id_map_free(IdMap* map);
+int id_map_put(IdMap* map, int64_t key, int64_t value);
+// Pointer to the stored value, or NULL if the key is absent
+int64_t* id_map_get(const IdMap* map, int64_t key);
+int id_map_remove(IdMap* map, int64_t key);
+
+#endif // ID_MAP_H
@@ -0,0 +1,672 @@
+#include "image_filter.h"
+#include "cpu_features.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#elif defined(CPU_ARM64)
+#include <arm_neon.h>
+#endif
+
+// Fixed-point precision of the Gaussian weights (they sum to 1 << GAUSSIAN_WEIGHT_BITS). Horizontally
+// filtered rows keep GAUSSIAN_ROW_BITS fractional bits in 16 bits, so the result stays within one gray level
+#define GAUSSIAN_WEIGHT_BITS 15
+#define GAUSSIAN_ROW_BITS 8
+#define GAUSSIAN_ROW_SHIFT (GAUSSIAN_WEIGHT_BITS - GAUSSIAN_ROW_BITS)
+#define GAUSSIAN_COLUMN_SHIFT (GAUSSIAN_WEIGHT_BITS + GAUSSIAN_ROW_BITS)
+
+typedef struct {
+    // dst[i] = (sum_t weights[t] * src[i + t * step]) >> GAUSSIAN_ROW_SHIFT, rounded
+    void (*gaussian_row)(const unsigned char* src, uint16_t* dst, int count, int step, const uint16_t* weights, int taps);
+    // dst[i] = (sum_t weights[t] * rows[t][i]) >> GAUSSIAN_COLUMN_SHIFT
+    void (*gaussian_column)(const uint16_t* const* rows, unsigned char* dst, int count, const uint16_t* weights, int taps);
+    // column_sum[i] += row[i] / column_sum[i] -= row[i]
+    void (*box_column_add)(uint16_t* column_sum, const unsigned char* row, int count);
+    void (*box_column_sub)(uint16_t* column_sum, const unsigned char* row, int count);
+    // dst[i] = sum_t column_sum[i + t * step]
+    void (*box_row)(const uint16_t* column_sum, uint32_t* dst, int count, int step, int taps);
+    // dst[i] = (sum[i] * multiplier) >> shift
+    void (*box_divide)(const uint32_t* sum, unsigned char* dst, int count, uint32_t multiplier, int shift);
+} FilterKernels;
+
+// Scalar kernels, also used for the tails of the SIMD loops
+static void gaussian_row_scalar(const unsigned char* src, uint16_t* dst, int count, int step, const uint16_t* weights, int taps) {
+    for (int i = 0; i < count; i++) {
+        uint32_t sum = 1u << (GAUSSIAN_ROW_SHIFT - 1);
+        for (int t = 0; t < taps; t++) {
+            sum += (uint32_t)weights[t] * src[i + t * step];
+        }
+        dst[i] = (uint16_t)(sum >> GAUSSIAN_ROW_SHIFT);
+    }
+}
+
+static void gaussian_column_scalar(const uint16_t* const* rows, unsigned char* dst, int count, const uint16_t* weights, int taps) {
+    for (int i = 0; i < count; i++) {
+        uint32_t sum = 0;
+        for (int t = 0; t < taps; t++) {
+            sum += (uint32_t)weights[t] * rows[t][i];
+        }
+        dst[i] = (unsigned char)(sum >> GAUSSIAN_COLUMN_SHIFT);
+    }
+}
+
+static void box_column_add_scalar(uint16_t* column_sum, const unsigned char* row, int count) {
+    for (int i = 0; i < count; i++) {
+        column_sum[i] += row[i];
+    }
+}
+
+static void box_column_sub_scalar(uint16_t* column_sum, const unsigned char* row, int count) {
+    for (int i = 0; i < count; i++) {
+        column_sum[i] -= row[i];
+    }
+}
+
+static void box_row_scalar(const uint16_t* column_sum, uint32_t* dst, int count, int step, int taps) {
+    for (int i = 0; i < count; i++) {
+        uint32_t sum = 0;
+        for (int t = 0; t < taps; t++) {
+            sum += column_sum[i + t * step];
+        }
+        dst[i] = sum;
+    }
+}
+
+static void box_divide_scalar(const uint32_t* sum, unsigned char* dst, int count, uint32_t multiplier, int shift) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = (unsigned char)(((uint64_t)sum[i] * multiplier) >> shift);
+    }
+}
+
+#if defined(CPU_X86)
+static void gaussian_row_sse2(const unsigned char* src, uint16_t* dst, int count, int step, const uint16_t* weights, int taps) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(1 << (GAUSSIAN_ROW_SHIFT - 1));
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i sum_lo = round;
+        __m128i sum_hi = round;
+        for (int t = 0; t < taps; t++) {
+            // Full 16x16 -> 32-bit unsigned products, as in the column pass
+            __m128i w = _mm_set1_epi16((short)weights[t]);
+            __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + i + t * step)), zero);
+            __m128i prod_lo = _mm_mullo_epi16(px, w);
+            __m128i prod_hi = _mm_mulhi_epu16(px, w);
+            sum_lo = _mm_add_epi32(sum_lo, _mm_unpacklo_epi16(prod_lo, prod_hi));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_unpackhi_epi16(prod_lo, prod_hi));
+        }
+        // SSE2 only packs signed 32-bit lanes: bias into the int16 range and flip the sign bit back
+        sum_lo = _mm_sub_epi32(_mm_srli_epi32(sum_lo, GAUSSIAN_ROW_SHIFT), bias);
+        sum_hi = _mm_sub_epi32(_mm_srli_epi32(sum_hi, GAUSSIAN_ROW_SHIFT), bias);
+        __m128i packed = _mm_xor_si128(_mm_packs_epi32(sum_lo, sum_hi), _mm_set1_epi16((short)0x8000));
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+    gaussian_row_scalar(src + i, dst + i, count - i, step, weights, taps);
+}
+
+static void gaussian_column_sse2(const uint16_t* const* rows, unsigned char* dst, int count, const uint16_t* weights, int taps) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i sum_lo = _mm_setzero_si128();
+        __m128i sum_hi = _mm_setzero_si128();
+        for (int t = 0; t < taps; t++) {
+            // Full 16x16 -> 32-bit unsigned products from the low and high halves
+            __m128i w = _mm_set1_epi16((short)weights[t]);
+            __m128i h = _mm_loadu_si128((const __m128i*)(rows[t] + i));
+            __m128i prod_lo = _mm_mullo_epi16(h, w);
+            __m128i prod_hi = _mm_mulhi_epu16(h, w);
+            sum_lo = _mm_add_epi32(sum_lo, _mm_unpacklo_epi16(prod_lo, prod_hi));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_unpackhi_epi16(prod_lo, prod_hi));
+        }
+        sum_lo = _mm_srli_epi32(sum_lo, GAUSSIAN_COLUMN_SHIFT);
+        sum_hi = _mm_srli_epi32(sum_hi, GAUSSIAN_COLUMN_SHIFT);
+        __m128i packed = _mm_packs_epi32(sum_lo, sum_hi);
+        _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(packed, packed));
+    }
+    if (i < count) {
+        const uint16_t* tail_rows[64];
+        for (int t = 0; t < taps; t++) tail_rows[t] = rows[t] + i;
+        gaussian_column_scalar(tail_rows, dst + i, count - i, weights, taps);
+    }
+}
+
+static void box_column_add_sse2(uint16_t* column_sum, const unsigned char* row, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i lo = _mm_loadu_si128((const __m128i*)(column_sum + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(column_sum + i + 8));
+        _mm_storeu_si128((__m128i*)(column_sum + i), _mm_add_epi16(lo, _mm_unpacklo_epi8(px, zero)));
+        _mm_storeu_si128((__m128i*)(column_sum + i + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(px, zero)));
+    }
+    box_column_add_scalar(column_sum + i, row + i, count - i);
+}
+
+static void box_column_sub_sse2(uint16_t* column_sum, const unsigned char* row, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i lo = _mm_loadu_si128((const __m128i*)(column_sum + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(column_sum + i + 8));
+        _mm_storeu_si128((__m128i*)(column_sum + i), _mm_sub_epi16(lo, _mm_unpacklo_epi8(px, zero)));
+        _mm_storeu_si128((__m128i*)(column_sum + i + 8), _mm_sub_epi16(hi, _mm_unpackhi_epi8(px, zero)));
+    }
+    box_column_sub_scalar(column_sum + i, row + i, count - i);
+}
+
+static void box_row_sse2(const uint16_t* column_sum, uint32_t* dst, int count, int step, int taps) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i sum_lo = _mm_setzero_si128();
+        __m128i sum_hi = _mm_setzero_si128();
+        for (int t = 0; t < taps; t++) {
+            __m128i h = _mm_loadu_si128((const __m128i*)(column_sum + i + t * step));
+            sum_lo = _mm_add_epi32(sum_lo, _mm_unpacklo_epi16(h, zero));
+            sum_hi = _mm_add_epi32(sum_hi, _mm_unpackhi_epi16(h, zero));
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), sum_lo);
+        _mm_storeu_si128((__m128i*)(dst + i + 4), sum_hi);
+    }
+    box_row_scalar(column_sum + i, dst + i, count - i, step, taps);
+}
+
+// Four (sum * multiplier) >> shift quotients; _mm_mul_epu32 multiplies the even lanes only
+static __m128i box_divide4_sse2(__m128i sum, __m128i multiplier, __m128i shift) {
+    __m128i even = _mm_srl_epi64(_mm_mul_epu32(sum, multiplier), shift);
+    __m128i odd = _mm_srl_epi64(_mm_mul_epu32(_mm_srli_epi64(sum, 32), multiplier), shift);
+    return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+static void box_divide_sse2(const uint32_t* sum, unsigned char* dst, int count, uint32_t multiplier, int shift) {
+    const __m128i m = _mm_set1_epi32((int)multiplier);
+    const __m128i s = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i q0 = box_divide4_sse2(_mm_loadu_si128((const __m128i*)(sum + i)), m, s);
+        __m128i q1 = box_divide4_sse2(_mm_loadu_si128((const __m128i*)(sum + i + 4)), m, s);
+        __m128i q2 = box_divide4_sse2(_mm_loadu_si128((const __m128i*)(sum + i + 8)), m, s);
+        __m128i q3 = box_divide4_sse2(_mm_loadu_si128((const __m128i*)(sum + i + 12)), m, s);
+        // Quotients are below 256, so the signed packs do not saturate
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(q0, q1), _mm_packs_epi32(q2, q3));
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+    box_divide_scalar(sum + i, dst + i, count - i, multiplier, shift);
+}
+
+TARGET_AVX2
+static void gaussian_row_avx2(const unsigned char* src, uint16_t* dst, int count, int step, const uint16_t* weights, int taps) {
+    const __m256i round = _mm256_set1_epi32(1 << (GAUSSIAN_ROW_SHIFT - 1));
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i sum_lo = round;
+        __m256i sum_hi = round;
+        for (int t = 0; t < taps; t++) {
+            __m256i w = _mm256_set1_epi16((short)weights[t]);
+            __m256i px = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(src + i + t * step)));
+            __m256i prod_lo = _mm256_mullo_epi16(px, w);
+            __m256i prod_hi = _mm256_mulhi_epu16(px, w);
+            sum_lo = _mm256_add_epi32(sum_lo, _mm256_unpacklo_epi16(prod_lo, prod_hi));
+            sum_hi = _mm256_add_epi32(sum_hi, _mm256_unpackhi_epi16(prod_lo, prod_hi));
+        }
+        // The per-lane unpack and pack cancel out, so no permute is needed here
+        sum_lo = _mm256_srli_epi32(sum_lo, GAUSSIAN_ROW_SHIFT);
+        sum_hi = _mm256_srli_epi32(sum_hi, GAUSSIAN_ROW_SHIFT);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_packus_epi32(sum_lo, sum_hi));
+    }
+    gaussian_row_scalar(src + i, dst + i, count - i, step, weights, taps);
+}
+
+TARGET_AVX2
+static void gaussian_column_avx2(const uint16_t* const* rows, unsigned char* dst, int count, const uint16_t* weights, int taps) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i sum_lo = _mm256_setzero_si256();
+        __m256i sum_hi = _mm256_setzero_si256();
+        for (int t = 0; t < taps; t++) {
+            __m256i w = _mm256_set1_epi16((short)weights[t]);
+            __m256i h = _mm256_loadu_si256((const __m256i*)(rows[t] + i));
+            __m256i prod_lo = _mm256_mullo_epi16(h, w);
+            __m256i prod_hi = _mm256_mulhi_epu16(h, w);
+            sum_lo = _mm256_add_epi32(sum_lo, _mm256_unpacklo_epi16(prod_lo, prod_hi));
+            sum_hi = _mm256_add_epi32(sum_hi, _mm256_unpackhi_epi16(prod_lo, prod_hi));
+        }
+        sum_lo = _mm256_srli_epi32(sum_lo, GAUSSIAN_COLUMN_SHIFT);
+        sum_hi = _mm256_srli_epi32(sum_hi, GAUSSIAN_COLUMN_SHIFT);
+        // Unpack and pack both work per 128-bit lane, so element order is restored here
+        __m256i packed = _mm256_packs_epi32(sum_lo, sum_hi);
+        packed = _mm256_packus_epi16(packed, packed);
+        packed = _mm256_permute4x64_epi64(packed, 0x08);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm256_castsi256_si128(packed));
+    }
+    if (i < count) {
+        const uint16_t* tail_rows[64];
+        for (int t = 0; t < taps; t++) tail_rows[t] = rows[t] + i;
+        gaussian_column_scalar(tail_rows, dst + i, count - i, weights, taps);
+    }
+}
+
+TARGET_AVX2
+static void box_column_add_avx2(uint16_t* column_sum, const unsigned char* row, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i px = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row + i)));
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(column_sum + i));
+        _mm256_storeu_si256((__m256i*)(column_sum + i), _mm256_add_epi16(sum, px));
+    }
+    box_column_add_scalar(column_sum + i, row + i, count - i);
+}
+
+TARGET_AVX2
+static void box_column_sub_avx2(uint16_t* column_sum, const unsigned char* row, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i px = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(row + i)));
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(column_sum + i));
+        _mm256_storeu_si256((__m256i*)(column_sum + i), _mm256_sub_epi16(sum, px));
+    }
+    box_column_sub_scalar(column_sum + i, row + i, count - i);
+}
+
+TARGET_AVX2
+static void box_row_avx2(const uint16_t* column_sum, uint32_t* dst, int count, int step, int taps) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int t = 0; t < taps; t++) {
+            __m128i h = _mm_loadu_si128((const __m128i*)(column_sum + i + t * step));
+            sum = _mm256_add_epi32(sum, _mm256_cvtepu16_epi32(h));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), sum);
+    }
+    box_row_scalar(column_sum + i, dst + i, count - i, step, taps);
+}
+
+TARGET_AVX2
+static __m256i box_divide8_avx2(__m256i sum, __m256i multiplier, __m128i shift) {
+    __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(sum, multiplier), shift);
+    __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(sum, 32), multiplier), shift);
+    return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+TARGET_AVX2
+static void box_divide_avx2(const uint32_t* sum, unsigned char* dst, int count, uint32_t multiplier, int shift) {
+    const __m256i m = _mm256_set1_epi32((int)multiplier);
+    const __m128i s = _mm_cvtsi32_si128(shift);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i q0 = box_divide8_avx2(_mm256_loadu_si256((const __m256i*)(sum + i)), m, s);
+        __m256i q1 = box_divide8_avx2(_mm256_loadu_si256((const __m256i*)(sum + i + 8)), m, s);
+        // packs works per 128-bit lane; the permute restores element order before the final pack
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(q0, q1), 0xD8);
+        _mm_storeu_si128((__m128i*)(dst + i),
+            _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1)));
+    }
+    box_divide_scalar(sum + i, dst + i, count - i, multiplier, shift);
+}
+#endif // CPU_X86
+
+#if defined(CPU_ARM64)
+static void gaussian_row_neon(const unsigned char* src, uint16_t* dst, int count, int step, const uint16_t* weights, int taps) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t sum_lo = vdupq_n_u32(0);
+        uint32x4_t sum_hi = vdupq_n_u32(0);
+        for (int t = 0; t < taps; t++) {
+            uint16x8_t px = vmovl_u8(vld1_u8(src + i + t * step));
+            sum_lo = vmlal_n_u16(sum_lo, vget_low_u16(px), weights[t]);
+            sum_hi = vmlal_n_u16(sum_hi, vget_high_u16(px), weights[t]);
+        }
+        vst1q_u16(dst + i, vcombine_u16(vrshrn_n_u32(sum_lo, GAUSSIAN_ROW_SHIFT),
+            vrshrn_n_u32(sum_hi, GAUSSIAN_ROW_SHIFT)));
+    }
+    gaussian_row_scalar(src + i, dst + i, count - i, step, weights, taps);
+}
+
+static void gaussian_column_neon(const uint16_t* const* rows, unsigned char* dst, int count, const uint16_t* weights, int taps) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t sum_lo = vdupq_n_u32(0);
+        uint32x4_t sum_hi = vdupq_n_u32(0);
+        for (int t = 0; t < taps; t++) {
+            uint16x8_t h = vld1q_u16(rows[t] + i);
+            sum_lo = vmlal_n_u16(sum_lo, vget_low_u16(h), weights[t]);
+            sum_hi = vmlal_n_u16(sum_hi, vget_high_u16(h), weights[t]);
+        }
+        // vshrn_n_u32 shifts by at most 16
+        uint16x8_t narrowed = vcombine_u16(vmovn_u32(vshrq_n_u32(sum_lo, GAUSSIAN_COLUMN_SHIFT)),
+            vmovn_u32(vshrq_n_u32(sum_hi, GAUSSIAN_COLUMN_SHIFT)));
+        vst1_u8(dst + i, vmovn_u16(narrowed));
+    }
+    if (i < count) {
+        const uint16_t* tail_rows[64];
+        for (int t = 0; t < taps; t++) tail_rows[t] = rows[t] + i;
+        gaussian_column_scalar(tail_rows, dst + i, count - i, weights, taps);
+    }
+}
+
+static void box_column_add_neon(uint16_t* column_sum, const unsigned char* row, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(column_sum + i, vaddw_u8(vld1q_u16(column_sum + i), vld1_u8(row + i)));
+    }
+    box_column_add_scalar(column_sum + i, row + i, count - i);
+}
+
+static void box_column_sub_neon(uint16_t* column_sum, const unsigned char* row, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(column_sum + i, vsubw_u8(vld1q_u16(column_sum + i), vld1_u8(row + i)));
+    }
+    box_column_sub_scalar(column_sum + i, row + i, count - i);
+}
+
+static void box_row_neon(const uint16_t* column_sum, uint32_t* dst, int count, int step, int taps) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t sum_lo = vdupq_n_u32(0);
+        uint32x4_t sum_hi = vdupq_n_u32(0);
+        for (int t = 0; t < taps; t++) {
+            uint16x8_t h = vld1q_u16(column_sum + i + t * step);
+            sum_lo = vaddw_u16(sum_lo, vget_low_u16(h));
+            sum_hi = vaddw_u16(sum_hi, vget_high_u16(h));
+        }
+        vst1q_u32(dst + i, sum_lo);
+        vst1q_u32(dst + i + 4, sum_hi);
+    }
+    box_row_scalar(column_sum + i, dst + i, count - i, step, taps);
+}
+
+static void box_divide_neon(const uint32_t* sum, unsigned char* dst, int count, uint32_t multiplier, int shift) {
+    const uint32x2_t m = vdup_n_u32(multiplier);
+    const int64x2_t s = vdupq_n_s64(-shift);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint32x4_t lo = vld1q_u32(sum + i);
+        uint32x4_t hi = vld1q_u32(sum + i + 4);
+        uint32x4_t q_lo = vcombine_u32(vmovn_u64(vshlq_u64(vmull_u32(vget_low_u32(lo), m), s)),
+            vmovn_u64(vshlq_u64(vmull_u32(vget_high_u32(lo), m), s)));
+        uint32x4_t q_hi = vcombine_u32(vmovn_u64(vshlq_u64(vmull_u32(vget_low_u32(hi), m), s)),
+            vmovn_u64(vshlq_u64(vmull_u32(vget_high_u32(hi), m), s)));
+        vst1_u8(dst + i, vmovn_u16(vcombine_u16(vmovn_u32(q_lo), vmovn_u32(q_hi))));
+    }
+    box_divide_scalar(sum + i, dst + i, count - i, multiplier, shift);
+}
+#endif // CPU_ARM64
+
+static const FilterKernels* filter_kernels(void) {
+    static const FilterKernels scalar = {
+        gaussian_row_scalar, gaussian_column_scalar, box_column_add_scalar, box_column_sub_scalar,
+        box_row_scalar, box_divide_scalar
+    };
+#if defined(CPU_X86)
+    static const FilterKernels sse2 = {
+        gaussian_row_sse2, gaussian_column_sse2, box_column_add_sse2, box_column_sub_sse2,
+        box_row_sse2, box_divide_sse2
+    };
+    static const FilterKernels avx2 = {
+        gaussian_row_avx2, gaussian_column_avx2, box_column_add_avx2, box_column_sub_avx2,
+        box_row_avx2, box_divide_avx2
+    };
+    int features = cpu_features();
+    if (features & CPU_FEATURE_AVX2) return &avx2;
+    if (features & CPU_FEATURE_SSE2) return &sse2;
+#elif defined(CPU_ARM64)
+    static const FilterKernels neon = {
+        gaussian_row_neon, gaussian_column_neon, box_column_add_neon, box_column_sub_neon,
+        box_row_neon, box_divide_neon
+    };
+    if (cpu_features() & CPU_FEATURE_NEON) return &neon;
+#endif
+    return &scalar;
+}
+
+// Wider windows slide a running sum along the row instead of adding every tap
+#define BOX_DIRECT_TAPS 16
+
+// Reciprocals for floor(sum / count), the truncating divide of the 2D loop. With
+// m = ceil(2^shift / count) = (2^shift + e) / count and 0 <= e < count, (sum * m) >> shift adds
+// sum * e / 2^shift < 1 to the numerator, so it is exact whenever sum * count < 2^shift. Sums are at
+// most 255 * count, so shift is sized for the widest window of the row. Window widths on one row
+// lie in [min_cols, max_cols] with max_cols < 2 * min_cols, which keeps m under 2^27.
+static int box_reciprocals(uint32_t* multiplier, int min_cols, int max_cols, int rows) {
+    uint64_t max_count = (uint64_t)max_cols * rows;
+    int shift = 0;
+    while ((255 * max_count * max_count) >> shift) shift++;
+    for (int cols = min_cols; cols <= max_cols; cols++) {
+        uint64_t count = (uint64_t)cols * rows;
+        multiplier[cols] = (uint32_t)(((1ULL << shift) + count - 1) / count);
+    }
+    return shift;
+}
+
+// Horizontal sums for border columns [x0, x1), dropping out-of-bounds columns
+static void box_row_border(const uint16_t* column_sum, uint32_t* row_sum, int x0, int x1,
+    int width, int channels, int half) {
+    for (int x = x0; x < x1; x++) {
+        int nx0 = x - half < 0 ? 0 : x - half;
+        int nx1 = x + half >= width ? width - 1 : x + half;
+        for (int c = 0; c < channels; c++) {
+            uint32_t sum = 0;
+            for (int nx = nx0; nx <= nx1; nx++) {
+                sum += column_sum[nx * channels + c];
+            }
+            row_sum[x * channels + c] = sum;
+        }
+    }
+}
+
+// Horizontal sums of the whole row by a running sum, all channels in one interleaved pass.
+// The window gains column i + enter and loses column i - leave; the index ranges where only one
+// of them (or neither, on rows narrower than the window) is in bounds are split out.
+static void box_row_running(const uint16_t* column_sum, uint32_t* row_sum, int width, int channels, int half) {
+    int row_elements = width * channels;
+    int enter = half * channels;
+    int leave = (half + 1) * channels;
+
+    box_row_border(column_sum, row_sum, 0, 1, width, channels, half);
+
+    int lo = leave < row_elements - enter ? leave : row_elements - enter;
+    int hi = leave < row_elements - enter ? row_elements - enter : leave;
+    lo = lo < channels ? channels : lo > row_elements ? row_elements : lo;
+    hi = hi < lo ? lo : hi > row_elements ? row_elements : hi;
+
+    int i = channels;
+    for (; i < lo; i++) {
+        row_sum[i] = row_sum[i - channels] + column_sum[i + enter];
+    }
+    if (leave <= row_elements - enter) {
+        for (; i < hi; i++) {
+            row_sum[i] = row_sum[i - channels] + column_sum[i + enter] - column_sum[i - leave];
+        }
+    }
+    else {
+        for (; i < hi; i++) {
+            row_sum[i] = row_sum[i - channels];
+        }
+    }
+    for (; i < row_elements; i++) {
+        row_sum[i] = row_sum[i - channels] - column_sum[i - leave];
+    }
+}
+
+// Border columns [x0, x1) of the division, each with the reciprocal of its clipped window width
+static void box_divide_border(const uint32_t* row_sum, unsigned char* out_row, int x0, int x1,
+    int width, int channels, int half, const uint32_t* multiplier, int shift) {
+    for (int x = x0; x < x1; x++) {
+        int nx0 = x - half < 0 ? 0 : x - half;
+        int nx1 = x + half >= width ? width - 1 : x + half;
+        box_divide_scalar(row_sum + x * channels, out_row + x * channels, channels, multiplier[nx1 - nx0 + 1], shift);
+    }
+}
+
+int box_filter_u8(const unsigned char* input_img, unsigned char* output_img,
+    int width, int height, int channels, int box_size) {
+
+    int half = box_size / 2;
+    int taps = 2 * half + 1;
+    int row_elements = width * channels;
+
+    // Column sums of up to `taps` 8-bit rows must fit in 16 bits
+    if (taps > 257) {
+        fprintf(stderr, "Error: Box filter size %d is too large\n", box_size);
+        return -1;
+    }
+
+    uint16_t* column_sum = (uint16_t*)calloc(row_elements, sizeof(uint16_t));
+    uint32_t* row_sum = (uint32_t*)malloc(row_elements * sizeof(uint32_t));
+    if (column_sum == NULL || row_sum == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(column_sum);
+        free(row_sum);
+        return -1;
+    }
+
+    const FilterKernels* kernels = filter_kernels();
+
+    // Columns [x_begin, x_end) see the whole window; the rest are borders
+    int x_begin = half < width ? half : width;
+    int x_end = width - half > x_begin ? width - half : x_begin;
+    int min_cols = half + 1 < width ? half + 1 : width;
+    int max_cols = taps < width ? taps : width;
+
+    // Vertical running sum: start with rows [0, half]
+    for (int y = 0; y <= half && y < height; y++) {
+        kernels->box_column_add(column_sum, input_img + (size_t)y * row_elements, row_elements);
+    }
+
+    uint32_t multiplier[258];
+    for (int y = 0; y < height; y++) {
+        int y0 = y - half < 0 ? 0 : y - half;
+        int y1 = y + half >= height ? height - 1 : y + half;
+        int shift = box_reciprocals(multiplier, min_cols, max_cols, y1 - y0 + 1);
+
+        // Horizontal pass: every channel of the interior at once, then the clipped borders
+        if (taps <= BOX_DIRECT_TAPS) {
+            box_row_border(column_sum, row_sum, 0, x_begin, width, channels, half);
+            if (x_end > x_begin) {
+                kernels->box_row(column_sum + (x_begin - half) * channels, row_sum + x_begin * channels,
+                    (x_end - x_begin) * channels, channels, taps);
+            }
+            box_row_border(column_sum, row_sum, x_end, width, width, channels, half);
+        }
+        else {
+            box_row_running(column_sum, row_sum, width, channels, half);
+        }
+
+        unsigned char* out_row = output_img + (size_t)y * row_elements;
+        box_divide_border(row_sum, out_row, 0, x_begin, width, channels, half, multiplier, shift);
+        if (x_end > x_begin) {
+            kernels->box_divide(row_sum + x_begin * channels, out_row + x_begin * channels,
+                (x_end - x_begin) * channels, multiplier[taps], shift);
+        }
+        box_divide_border(row_sum, out_row, x_end, width, width, channels, half, multiplier, shift);
+
+        // Slide the vertical window down one row
+        if (y + half + 1 < height) {
+            kernels->box_column_add(column_sum, input_img + (size_t)(y + half + 1) * row_elements, row_elements);
+        }
+        if (y - half >= 0) {
+            kernels->box_column_sub(column_sum, input_img + (size_t)(y - half) * row_elements, row_elements);
+        }
+    }
+
+    free(column_sum);
+    free(row_sum);
+    return 0;
+}
+
+// Border columns [x0, x1) of the horizontal pass, dropping out-of-bounds taps
+static void gaussian_row_border(const unsigned char* src, uint16_t* dst, int x0, int x1,
+    int width, int channels, const uint16_t* weights, int radius) {
+    for (int x = x0; x < x1; x++) {
+        for (int c = 0; c < channels; c++) {
+            uint32_t sum = 1u << (GAUSSIAN_ROW_SHIFT - 1);
+            for (int t = 0; t < 2 * radius + 1; t++) {
+                int nx = x + t - radius;
+                if (nx >= 0 && nx < width) {
+                    sum += (uint32_t)weights[t] * src[nx * channels + c];
+                }
+            }
+            dst[x * channels + c] = (uint16_t)(sum >> GAUSSIAN_ROW_SHIFT);
+        }
+    }
+}
+
+// Horizontal pass over one source row: SIMD over the interior, scalar taps at the borders
+static void gaussian_row_pass(const FilterKernels* kernels, const unsigned char* src, uint16_t* dst,
+    int width, int channels, const uint16_t* weights, int radius) {
+
+    int x_begin = radius < width ? radius : width;
+    int x_end = width - radius > x_begin ? width - radius : x_begin;
+
+    gaussian_row_border(src, dst, 0, x_begin, width, channels, weights, radius);
+    if (x_end > x_begin) {
+        kernels->gaussian_row(src + (x_begin - radius) * channels, dst + x_begin * channels,
+            (x_end - x_begin) * channels, channels, weights, 2 * radius + 1);
+    }
+    gaussian_row_border(src, dst, x_end, width, width, channels, weights, radius);
+}
+
+int gaussian_blur_u8(const unsigned char* input_img, unsigned char* output_img,
+    int width, int height, int channels, int kernel_size) {
+
+    int radius = kernel_size / 2;
+    int taps = 2 * radius + 1;
+    int row_elements = width * channels;
+    if (taps > 64) {
+        fprintf(stderr, "Error: Gaussian kernel size %d is too large\n", kernel_size);
+        return -1;
+    }
+
+    // Same 1D kernel as before, rounded to fixed point with the remainder folded into the centre tap
+    double sigma = kernel_size / 6.0;
+    double kernel[64];
+    double kernel_sum = 0.0;
+    for (int i = -radius; i <= radius; i++) {
+        kernel[i + radius] = exp(-(i * i) / (2 * sigma * sigma));
+        kernel_sum += kernel[i + radius];
+    }
+    uint16_t weights[64];
+    int weight_sum = 0;
+    for (int t = 0; t < taps; t++) {
+        weights[t] = (uint16_t)floor(kernel[t] / kernel_sum * (1 << GAUSSIAN_WEIGHT_BITS) + 0.5);
+        weight_sum += weights[t];
+    }
+    weights[radius] = (uint16_t)(weights[radius] + (1 << GAUSSIAN_WEIGHT_BITS) - weight_sum);
+
+    // Ring of horizontally filtered rows, indexed by source row modulo taps
+    uint16_t* row_ring = (uint16_t*)malloc((size_t)taps * row_elements * sizeof(uint16_t));
+    if (row_ring == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+
+    const FilterKernels* kernels = filter_kernels();
+    int next_row = 0;
+    for (int y = 0; y < height; y++) {
+        int y0 = y - radius < 0 ? 0 : y - radius;
+        int y1 = y + radius >= height ? height - 1 : y + radius;
+
+        for (; next_row <= y1; next_row++) {
+            gaussian_row_pass(kernels, input_img + (size_t)next_row * row_elements,
+                row_ring + (size_t)(next_row % taps) * row_elements, width, channels, weights, radius);
+        }
+
+        // Only in-bounds rows contribute, matching the 2D loop that skipped them
+        const uint16_t* rows[64];
+        for (int sy = y0; sy <= y1; sy++) {
+            rows[sy - y0] = row_ring + (size_t)(sy % taps) * row_elements;
+        }
+        kernels->gaussian_column(rows, output_img + (size_t)y * row_elements, row_elements,
+            weights + (y0 - (y - radius)), y1 - y0 + 1);
+    }
+
+    free(row_ring);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef IMAGE_FILTER_H
+#define IMAGE_FILTER_H
+
+#include <stdint.h>
+
+// Separable, integer-domain filters over interleaved 8-bit images (channels = 1 or 3).
+// Row/column kernels are picked at runtime from SSE2/AVX2/NEON or a scalar fallback.
+
+// Mean over the in-bounds part of a (2 * (box_size / 2) + 1)^2 window, truncated like an integer divide
+int box_filter_u8(const unsigned char* input_img, unsigned char* output_img,
+    int width, int height, int channels, int box_size);
+
+// Gaussian with sigma = kernel_size / 6 (at most 64 taps) and 15-bit fixed-point weights, within one gray
+// level of the exact result; out-of-bounds taps are dropped
+int gaussian_blur_u8(const unsigned char* input_img, unsigned char* output_img,
+    int width, int height, int channels, int kernel_size);
+
+#endif // IMAGE_FILTER_H
@@ -0,0 +1,418 @@
+#include "ivf_index.h"
+#include "gallery_file.h"
+#include "id_map.h"
+#include "matching.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Rows assigned per batch identification call while indexing
+#define IVF_ASSIGN_CHUNK 4096
+
+struct IvfIndex {
+	Gallery* centroids;     // nlist normalized centroids, ids are list numbers
+	Gallery** lists;
+	int nlist;
+	IdMap locations;        // id -> (list << 32) | row; empty for mapped indexes
+	int read_only;          // Mapped from a gallery file: lists are views into the mapping
+	MappedFile* mapping;
+};
+
+// Index section of a gallery file: rows of list j are [list_offsets[j], list_offsets[j + 1])
+// of the template block, followed by the centroids' ids and norms and the 64-byte aligned
+// centroid rows
+typedef struct IvfFileHeader {
+	uint32_t nlist;
+	uint32_t reserved;
+} IvfFileHeader;
+
+static size_t ivf_centroids_offset(int nlist) {
+	size_t offset = sizeof(IvfFileHeader) + ((size_t)nlist + 1) * sizeof(uint64_t) + (size_t)nlist * (sizeof(int64_t) + sizeof(float));
+	return (offset + MEMORY_ALIGNMENT - 1) & ~(size_t)(MEMORY_ALIGNMENT - 1);
+}
+
+// Nearest centroid per row, through the batched GEMM path
+static int assign_rows(const Gallery* centroids, const float* rows, int count, int* out_lists, float* out_distances) {
+	int64_t* ids = (int64_t*)malloc(IVF_ASSIGN_CHUNK * sizeof(int64_t));
+	float* scores = (float*)malloc(IVF_ASSIGN_CHUNK * sizeof(float));
+	int* counts = (int*)malloc(IVF_ASSIGN_CHUNK * sizeof(int));
+	if (ids == NULL || scores == NULL || counts == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(ids);
+		free(scores);
+		free(counts);
+		return -1;
+	}
+
+	int status = 0;
+	for (int start = 0; start < count && status == 0; start += IVF_ASSIGN_CHUNK) {
+		int chunk = count - start < IVF_ASSIGN_CHUNK ? count - start : IVF_ASSIGN_CHUNK;
+		// Distances never exceed 2, so this threshold accepts every centroid
+		status = fingerprint_identify_batch(rows + (size_t)start * TEMPLATE_SIZE, chunk, centroids, 1, 3.0f, ids, scores, counts);
+		for (int i = 0; i < chunk && status == 0; i++) {
+			out_lists[start + i] = (int)ids[i];
+			if (out_distances != NULL) out_distances[start + i] = scores[i];
+		}
+	}
+
+	free(ids);
+	free(scores);
+	free(counts);
+	return status;
+}
+
+// Spherical k-means on an evenly strided sample of the gallery
+static int train_centroids(IvfIndex* index, const Gallery* gallery) {
+	int nlist = index->nlist;
+	int samples = gallery->size < nlist * IVF_TRAINING_POINTS_PER_LIST ? gallery->size : nlist * IVF_TRAINING_POINTS_PER_LIST;
+
+	float* sample = (float*)aligned_malloc((size_t)samples * TEMPLATE_SIZE * sizeof(float), MEMORY_ALIGNMENT);
+	float* sums = (float*)calloc((size_t)nlist * TEMPLATE_SIZE, sizeof(float));
+	int* counts = (int*)malloc(nlist * sizeof(int));
+	int* lists = (int*)malloc(samples * sizeof(int));
+	float* distances = (float*)malloc(samples * sizeof(float));
+	if (sample == NULL || sums == NULL || counts == NULL || lists == NULL || distances == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		aligned_free(sample);
+		free(sums);
+		free(counts);
+		free(lists);
+		free(distances);
+		return -1;
+	}
+
+	for (int i = 0; i < samples; i++) {
+		size_t row = (size_t)i * gallery->size / samples;
+		memcpy(sample + (size_t)i * TEMPLATE_SIZE, gallery->templates + row * TEMPLATE_SIZE, TEMPLATE_SIZE * sizeof(float));
+	}
+	for (int j = 0; j < nlist; j++) {
+		add_to_gallery(index->centroids, sample + (size_t)j * samples / nlist * TEMPLATE_SIZE, j);
+	}
+
+	int status = 0;
+	for (int iteration = 0; iteration < IVF_KMEANS_ITERATIONS && status == 0; iteration++) {
+		status = assign_rows(index->centroids, sample, samples, lists, distances);
+		if (status != 0) break;
+
+		memset(sums, 0, (size_t)nlist * TEMPLATE_SIZE * sizeof(float));
+		memset(counts, 0, nlist * sizeof(int));
+		for (int i = 0; i < samples; i++) {
+			float* sum = sums + (size_t)lists[i] * TEMPLATE_SIZE;
+			const float* row = sample + (size_t)i * TEMPLATE_SIZE;
+			for (int d = 0; d < TEMPLATE_SIZE; d++) {
+				sum[d] += row[d];
+			}
+			counts[lists[i]]++;
+		}
+
+		for (int j = 0; j < nlist; j++) {
+			float* centroid = index->centroids->templates + (size_t)j * TEMPLATE_SIZE;
+			if (counts[j] > 0) {
+				normalize_template(sums + (size_t)j * TEMPLATE_SIZE, centroid);
+				continue;
+			}
+			// Reseed an empty list with the sample point worst served by its centroid
+			int worst = 0;
+			for (int i = 1; i < samples; i++) {
+				if (distances[i] > distances[worst]) worst = i;
+			}
+			memcpy(centroid, sample + (size_t)worst * TEMPLATE_SIZE, TEMPLATE_SIZE * sizeof(float));
+			distances[worst] = 0.0f;
+		}
+	}
+
+	aligned_free(sample);
+	free(sums);
+	free(counts);
+	free(lists);
+	free(distances);
+	return status;
+}
+
+// Appends a row (already assigned to a list) and records where it lives
+static int insert_row(IvfIndex* index, int list, const float* template_data, int64_t id) {
+	Gallery* target = index->lists[list];
+	if (add_to_gallery(target, template_data, id) != 0) return -1;
+	if (id_map_put(&index->locations, id, ((int64_t)list << 32) | (target->size - 1)) != 0) {
+		target->size--;
+		return -1;
+	}
+	return 0;
+}
+
+// API function
+int create_ivf_index(const Gallery* gallery, int nlist, IvfIndex** out_index) {
+	if (gallery == NULL || out_index == NULL || nlist <= 0 || gallery->size < nlist) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	IvfIndex* index = (IvfIndex*)calloc(1, sizeof(IvfIndex));
+	if (index == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+	index->nlist = nlist;
+	index->lists = (Gallery**)calloc(nlist, sizeof(Gallery*));
+	if (index->lists == NULL || create_gallery(nlist, &index->centroids) != 0 ||
+		id_map_init(&index->locations, gallery->size) != 0) {
+		clean_ivf_index(index);
+		return -1;
+	}
+	for (int j = 0; j < nlist; j++) {
+		if (create_gallery(gallery->size / nlist, &index->lists[j]) != 0) {
+			clean_ivf_index(index);
+			return -1;
+		}
+	}
+
+	int* lists = (int*)malloc(((size_t)gallery->size + 1) * sizeof(int));
+	if (lists == NULL || train_centroids(index, gallery) != 0 ||
+		assign_rows(index->centroids, gallery->templates, gallery->size, lists, NULL) != 0) {
+		free(lists);
+		clean_ivf_index(index);
+		return -1;
+	}
+	for (int i = 0; i < gallery->size; i++) {
+		if (id_map_get(&index->locations, gallery->ids[i]) != NULL) {
+			fprintf(stderr, "Error: Duplicate template id %lld\n", (long long)gallery->ids[i]);
+			free(lists);
+			clean_ivf_index(index);
+			return -1;
+		}
+		if (insert_row(index, lists[i], gallery->templates + (size_t)i * TEMPLATE_SIZE, gallery->ids[i]) != 0) {
+			free(lists);
+			clean_ivf_index(index);
+			return -1;
+		}
+		// Rows arrive normalized; keep the original magnitude
+		Gallery* list = index->lists[lists[i]];
+		list->norms[list->size - 1] = gallery->norms[i];
+	}
+	free(lists);
+
+	*out_index = index;
+	return 0;
+}
+
+int ivf_add(IvfIndex* index, const float* template_data, int64_t id) {
+	if (index == NULL || template_data == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	if (index->read_only) {
+		fprintf(stderr, "Error: IVF index is read-only\n");
+		return -1;
+	}
+	if (id_map_get(&index->locations, id) != NULL) {
+		fprintf(stderr, "Error: Duplicate template id %lld\n", (long long)id);
+		return -1;
+	}
+
+	int64_t list;
+	float distance;
+	if (fingerprint_identify_topk(template_data, index->centroids, 1, 3.0f, &list, &distance) != 1) return -1;
+	return insert_row(index, (int)list, template_data, id);
+}
+
+int ivf_remove(IvfIndex* index, int64_t id) {
+	if (index == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	if (index->read_only) {
+		fprintf(stderr, "Error: IVF index is read-only\n");
+		return -1;
+	}
+	int64_t* location = id_map_get(&index->locations, id);
+	if (location == NULL) return -1;
+
+	int list = (int)(*location >> 32);
+	int row = (int)(*location & 0xffffffff);
+	Gallery* target = index->lists[list];
+	gallery_swap_remove(target, row);
+	id_map_remove(&index->locations, id);
+
+	// The former last row now lives at the freed slot
+	if (row < target->size) {
+		id_map_put(&index->locations, target->ids[row], ((int64_t)list << 32) | row);
+	}
+	return 0;
+}
+
+int ivf_size(const IvfIndex* index) {
+	if (index == NULL) return 0;
+
+	int size = 0;
+	for (int j = 0; j < index->nlist; j++) {
+		size += index->lists[j]->size;
+	}
+	return size;
+}
+
+int fingerprint_identify_ivf(const float* query_template, const IvfIndex* index, int nprobe, int k, float threshold,
+	int64_t* out_ids, float* out_scores) {
+	if (query_template == NULL || index == NULL || k <= 0 || out_ids == NULL || out_scores == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	if (nprobe < 1) nprobe = 1;
+	if (nprobe > index->nlist) nprobe = index->nlist;
+
+	int64_t* probes = (int64_t*)malloc(nprobe * sizeof(int64_t));
+	float* probe_distances = (float*)malloc(nprobe * sizeof(float));
+	if (probes == NULL || probe_distances == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(probes);
+		free(probe_distances);
+		return -1;
+	}
+	int probed = fingerprint_identify_topk(query_template, index->centroids, nprobe, 3.0f, probes, probe_distances);
+	if (probed < 0) {
+		free(probes);
+		free(probe_distances);
+		return -1;
+	}
+
+	float query[TEMPLATE_SIZE];
+	normalize_template(query_template, query);
+
+	TopK topk;
+	topk_init(&topk, out_scores, out_ids, k);
+	for (int p = 0; p < probed; p++) {
+		const Gallery* list = index->lists[probes[p]];
+		score_rows_topk(query, list, 0, list->size, threshold, &topk);
+	}
+	topk_sort(&topk);
+
+	free(probes);
+	free(probe_distances);
+	return topk.size;
+}
+
+void clean_ivf_index(IvfIndex* index) {
+	if (index == NULL) return;
+
+	if (index->lists != NULL) {
+		for (int j = 0; j < index->nlist; j++) {
+			clean_gallery(index->lists[j]);
+		}
+		free(index->lists);
+	}
+	clean_gallery(index->centroids);
+	id_map_free(&index->locations);
+	if (index->mapping != NULL) {
+		unmap_file(index->mapping);
+		free(index->mapping);
+	}
+	free(index);
+}
+
+// Writes the rows list by list, so each list is one contiguous run of the template block
+int save_ivf_index(const char* filename, const IvfIndex* index) {
+	if (filename == NULL || index == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	int nlist = index->nlist;
+	size_t centroids_offset = ivf_centroids_offset(nlist);
+	size_t index_size = centroids_offset + (size_t)nlist * TEMPLATE_SIZE * sizeof(float);
+	char* blob = (char*)calloc(1, index_size);
+	GallerySegment* segments = (GallerySegment*)malloc(nlist * sizeof(GallerySegment));
+	if (blob == NULL || segments == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(blob);
+		free(segments);
+		return -1;
+	}
+
+	IvfFileHeader* header = (IvfFileHeader*)blob;
+	uint64_t* list_offsets = (uint64_t*)(blob + sizeof(IvfFileHeader));
+	int64_t* centroid_ids = (int64_t*)(list_offsets + nlist + 1);
+	float* centroid_norms = (float*)(centroid_ids + nlist);
+	header->nlist = (uint32_t)nlist;
+	list_offsets[0] = 0;
+	for (int j = 0; j < nlist; j++) {
+		const Gallery* list = index->lists[j];
+		GallerySegment segment = { list->templates, list->norms, list->ids, list->size };
+		segments[j] = segment;
+		list_offsets[j + 1] = list_offsets[j] + (uint64_t)list->size;
+		centroid_ids[j] = index->centroids->ids[j];
+		centroid_norms[j] = index->centroids->norms[j];
+	}
+	memcpy(blob + centroids_offset, index->centroids->templates, (size_t)nlist * TEMPLATE_SIZE * sizeof(float));
+
+	int status = write_gallery_file(filename, segments, nlist, GALLERY_INDEX_IVF_FLAT, blob, index_size);
+	free(blob);
+	free(segments);
+	return status;
+}
+
+int map_ivf_index(const char* filename, IvfIndex** out_index) {
+	if (filename == NULL || out_index == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	IvfIndex* index = (IvfIndex*)calloc(1, sizeof(IvfIndex));
+	MappedFile* file = (MappedFile*)malloc(sizeof(MappedFile));
+	const GalleryFileHeader* header = NULL;
+	if (index == NULL || file == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(index);
+		free(file);
+		return -1;
+	}
+	if (open_gallery_file(filename, file, &header) != 0) {
+		free(index);
+		free(file);
+		return -1;
+	}
+	index->read_only = 1;
+	index->mapping = file;
+
+	const char* blob = (const char*)file->data + header->index_offset;
+	const IvfFileHeader* ivf = (const IvfFileHeader*)blob;
+	int nlist = header->index_kind == GALLERY_INDEX_IVF_FLAT && header->index_size >= sizeof(IvfFileHeader) ? (int)ivf->nlist : 0;
+	if (nlist <= 0 || nlist > INT32_MAX / 2 ||
+		header->index_size != ivf_centroids_offset(nlist) + (size_t)nlist * TEMPLATE_SIZE * sizeof(float)) {
+		fprintf(stderr, "Error: Gallery file %s has no valid IVF index\n", filename);
+		clean_ivf_index(index);
+		return -1;
+	}
+	const uint64_t* list_offsets = (const uint64_t*)(blob + sizeof(IvfFileHeader));
+	for (int j = 0; j < nlist; j++) {
+		if (list_offsets[j] > list_offsets[j + 1] || list_offsets[j + 1] > header->count) {
+			fprintf(stderr, "Error: Gallery file %s has no valid IVF index\n", filename);
+			clean_ivf_index(index);
+			return -1;
+		}
+	}
+
+	index->nlist = nlist;
+	index->lists = (Gallery**)calloc(nlist, sizeof(Gallery*));
+	index->centroids = (Gallery*)calloc(1, sizeof(Gallery));
+	if (index->lists == NULL || index->centroids == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		clean_ivf_index(index);
+		return -1;
+	}
+	index->centroids->ids = (int64_t*)(list_offsets + nlist + 1);
+	index->centroids->norms = (float*)(index->centroids->ids + nlist);
+	index->centroids->templates = (float*)(blob + ivf_centroids_offset(nlist));
+	index->centroids->size = nlist;
+	index->centroids->capacity = nlist;
+	index->centroids->read_only = 1;
+	for (int j = 0; j < nlist; j++) {
+		int begin = (int)list_offsets[j];
+		if (gallery_view(file, header, begin, (int)list_offsets[j + 1] - begin, &index->lists[j]) != 0) {
+			clean_ivf_index(index);
+			return -1;
+		}
+	}
+
+	*out_index = index;
+	return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef IVF_INDEX_H
+#define IVF_INDEX_H
+
+#include "config.h"
+#include "gallery.h"
+
+// Training sample per list and Lloyd iterations for the coarse quantizer
+#define IVF_TRAINING_POINTS_PER_LIST 64
+#define IVF_KMEANS_ITERATIONS 10
+
+// IVF-flat index: spherical k-means centroids partition the gallery into inverted
+// lists, and a search scans only the nprobe lists whose centroids are nearest.
+// Lists hold fp32 normalized rows, so probed candidates are scored exactly.
+typedef struct IvfIndex IvfIndex;
+
+// API function
+// Trains nlist centroids on a sample of the gallery and indexes every row
+DllAPI int create_ivf_index(const Gallery* gallery, int nlist, IvfIndex** out_index);
+DllAPI int ivf_add(IvfIndex* index, const float* template_data, int64_t id);
+DllAPI int ivf_remove(IvfIndex* index, int64_t id);
+DllAPI int ivf_size(const IvfIndex* index);
+// nprobe trades recall for latency: 1 scans the nearest list only, nlist is a full scan
+DllAPI int fingerprint_identify_ivf(const float* query_template, const IvfIndex* index, int nprobe, int k, float threshold,
+	int64_t* out_ids, float* out_scores);
+// Saves the rows grouped by list plus an IVF index section (see gallery_file.h)
+DllAPI int save_ivf_index(const char* filename, const IvfIndex* index);
+// Maps a saved index in place; the result is read-only (add / remove fail)
+DllAPI int map_ivf_index(const char* filename, IvfIndex** out_index);
+DllAPI void clean_ivf_index(IvfIndex* index);
+
+#endif // IVF_INDEX_H
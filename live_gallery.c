@@ -0,0 +1,409 @@
+#include "live_gallery.h"
+#include "id_map.h"
+#include "matching.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct LiveSegment {
+	float* templates;
+	float* norms;
+	int64_t* ids;
+	uint8_t* tombstones;        // Set under the mutex, read by searches without it
+	int capacity;
+	volatile int64_t reserved;  // Next row handed to an appender
+	volatile int64_t committed; // Rows [0, committed) are fully written
+	int indexed;                // Rows already in the id map (mutex)
+	int dead;                   // Tombstoned rows (mutex)
+} LiveSegment;
+
+// Immutable once published; replaced wholesale on rollover or compaction
+typedef struct SegmentTable {
+	int count;
+	LiveSegment* segments[];
+} SegmentTable;
+
+struct LiveGallery {
+	void* volatile table;
+	volatile int64_t epoch;
+	volatile int64_t readers[LIVE_MAX_READERS];  // Epoch each active reader entered in, 0 when free
+
+	// Serializes everything except appends into a non-full segment and searches
+	platform_mutex mutex;
+	IdMap locations;            // id -> (segment position << 32) | row
+	int64_t live_rows;
+
+	int background;
+	platform_thread compactor;
+	platform_cond compact_wanted;
+	int compact_requested;
+	int stop;
+};
+
+static LiveSegment* create_segment(int capacity) {
+	LiveSegment* segment = (LiveSegment*)calloc(1, sizeof(LiveSegment));
+	if (segment == NULL) return NULL;
+
+	segment->templates = (float*)aligned_malloc((size_t)capacity * TEMPLATE_SIZE * sizeof(float), MEMORY_ALIGNMENT);
+	segment->norms = (float*)malloc((size_t)capacity * sizeof(float));
+	segment->ids = (int64_t*)malloc((size_t)capacity * sizeof(int64_t));
+	segment->tombstones = (uint8_t*)calloc(capacity, sizeof(uint8_t));
+	if (segment->templates == NULL || segment->norms == NULL || segment->ids == NULL || segment->tombstones == NULL) {
+		aligned_free(segment->templates);
+		free(segment->norms);
+		free(segment->ids);
+		free(segment->tombstones);
+		free(segment);
+		return NULL;
+	}
+	segment->capacity = capacity;
+	return segment;
+}
+
+static void free_segment(LiveSegment* segment) {
+	if (segment == NULL) return;
+
+	aligned_free(segment->templates);
+	free(segment->norms);
+	free(segment->ids);
+	free(segment->tombstones);
+	free(segment);
+}
+
+static SegmentTable* create_table(int count) {
+	SegmentTable* table = (SegmentTable*)calloc(1, sizeof(SegmentTable) + (size_t)count * sizeof(LiveSegment*));
+	if (table != NULL) table->count = count;
+	return table;
+}
+
+// Registers a reader in the current epoch; the table it loads afterwards stays valid until epoch_exit
+static int epoch_enter(LiveGallery* live) {
+	for (;;) {
+		for (int i = 0; i < LIVE_MAX_READERS; i++) {
+			int64_t epoch = atomic_load_64(&live->epoch);
+			if (atomic_load_64(&live->readers[i]) == 0 && atomic_cas_64(&live->readers[i], 0, epoch)) return i;
+		}
+		thread_yield();
+	}
+}
+
+static void epoch_exit(LiveGallery* live, int slot) {
+	atomic_store_64(&live->readers[slot], 0);
+}
+
+// Waits until no reader can still hold a table published before this call
+static void epoch_synchronize(LiveGallery* live) {
+	int64_t target = atomic_fetch_add_64(&live->epoch, 1) + 1;
+	for (int i = 0; i < LIVE_MAX_READERS; i++) {
+		for (;;) {
+			int64_t entered = atomic_load_64(&live->readers[i]);
+			if (entered == 0 || entered >= target) break;
+			thread_yield();
+		}
+	}
+}
+
+// Brings the id map up to date with rows committed since the last call (mutex held)
+static int index_new_rows(LiveGallery* live, SegmentTable* table) {
+	for (int p = 0; p < table->count; p++) {
+		LiveSegment* segment = table->segments[p];
+		int committed = (int)atomic_load_64(&segment->committed);
+		for (; segment->indexed < committed; segment->indexed++) {
+			int row = segment->indexed;
+			if (id_map_put(&live->locations, segment->ids[row], ((int64_t)p << 32) | row) != 0) return -1;
+		}
+	}
+	return 0;
+}
+
+// Copies the live rows of a full segment into an exactly sized one and repoints the id map (mutex held)
+static LiveSegment* compact_segment(LiveGallery* live, const LiveSegment* segment, int position) {
+	int live_count = segment->capacity - segment->dead;
+	LiveSegment* compacted = create_segment(live_count > 0 ? live_count : 1);
+	if (compacted == NULL) return NULL;
+
+	int row = 0;
+	for (int i = 0; i < segment->capacity; i++) {
+		if (segment->tombstones[i]) continue;
+		memcpy(compacted->templates + (size_t)row * TEMPLATE_SIZE, segment->templates + (size_t)i * TEMPLATE_SIZE,
+			TEMPLATE_SIZE * sizeof(float));
+		compacted->norms[row] = segment->norms[i];
+		compacted->ids[row] = segment->ids[i];
+		id_map_put(&live->locations, segment->ids[i], ((int64_t)position << 32) | row);
+		row++;
+	}
+	// Sealed: appenders only ever target the last segment
+	compacted->capacity = live_count;
+	compacted->reserved = live_count;
+	compacted->committed = live_count;
+	compacted->indexed = live_count;
+	return compacted;
+}
+
+static void repoint_segment(LiveGallery* live, const LiveSegment* segment, int position) {
+	for (int i = 0; i < segment->indexed; i++) {
+		if (!segment->tombstones[i]) id_map_put(&live->locations, segment->ids[i], ((int64_t)position << 32) | i);
+	}
+}
+
+static int needs_compaction(const LiveSegment* segment) {
+	return atomic_load_64((volatile int64_t*)&segment->committed) == segment->capacity && segment->dead > 0 &&
+		segment->dead >= segment->capacity * LIVE_COMPACT_DEAD_FRACTION;
+}
+
+static int compact_locked(LiveGallery* live) {
+	SegmentTable* table = (SegmentTable*)atomic_load_ptr(&live->table);
+	if (index_new_rows(live, table) != 0) return -1;
+
+	// The last segment may still be receiving appends, so it is never rewritten
+	int candidates = 0;
+	for (int p = 0; p + 1 < table->count; p++) {
+		candidates += needs_compaction(table->segments[p]);
+	}
+	if (candidates == 0) return 0;
+
+	SegmentTable* next = create_table(table->count);
+	if (next == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		return -1;
+	}
+	for (int p = 0; p < table->count; p++) {
+		LiveSegment* segment = table->segments[p];
+		next->segments[p] = segment;
+		if (p + 1 < table->count && needs_compaction(segment)) {
+			LiveSegment* compacted = compact_segment(live, segment, p);
+			if (compacted == NULL) {
+				// Nothing published yet: point the map back at the old rows and drop the copies
+				fprintf(stderr, "Error: Memory allocation failed\n");
+				for (int q = 0; q < p; q++) {
+					if (next->segments[q] == table->segments[q]) continue;
+					repoint_segment(live, table->segments[q], q);
+					free_segment(next->segments[q]);
+				}
+				free(next);
+				return -1;
+			}
+			next->segments[p] = compacted;
+		}
+	}
+
+	atomic_store_ptr(&live->table, next);
+	epoch_synchronize(live);
+	for (int p = 0; p < table->count; p++) {
+		if (next->segments[p] != table->segments[p]) free_segment(table->segments[p]);
+	}
+	free(table);
+	return 0;
+}
+
+static void compactor_main(void* arg) {
+	LiveGallery* live = (LiveGallery*)arg;
+
+	mutex_lock(&live->mutex);
+	for (;;) {
+		while (!live->stop && !live->compact_requested) {
+			cond_wait(&live->compact_wanted, &live->mutex);
+		}
+		if (live->stop) break;
+		live->compact_requested = 0;
+		compact_locked(live);
+	}
+	mutex_unlock(&live->mutex);
+}
+
+// Appends a fresh last segment unless another appender already did (mutex taken here)
+static int roll_over(LiveGallery* live, LiveSegment* full) {
+	mutex_lock(&live->mutex);
+	SegmentTable* table = (SegmentTable*)atomic_load_ptr(&live->table);
+	if (table->segments[table->count - 1] != full) {
+		mutex_unlock(&live->mutex);
+		return 0;
+	}
+
+	SegmentTable* next = create_table(table->count + 1);
+	LiveSegment* segment = create_segment(LIVE_SEGMENT_ROWS);
+	if (next == NULL || segment == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(next);
+		free_segment(segment);
+		mutex_unlock(&live->mutex);
+		return -1;
+	}
+	memcpy(next->segments, table->segments, (size_t)table->count * sizeof(LiveSegment*));
+	next->segments[table->count] = segment;
+
+	atomic_store_ptr(&live->table, next);
+	epoch_synchronize(live);
+	free(table);
+	mutex_unlock(&live->mutex);
+	return 0;
+}
+
+// API function
+int create_live_gallery(int background_compaction, LiveGallery** out_live) {
+	if (out_live == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	LiveGallery* live = (LiveGallery*)calloc(1, sizeof(LiveGallery));
+	SegmentTable* table = create_table(1);
+	LiveSegment* segment = create_segment(LIVE_SEGMENT_ROWS);
+	if (live == NULL || table == NULL || segment == NULL || id_map_init(&live->locations, LIVE_SEGMENT_ROWS) != 0) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(live);
+		free(table);
+		free_segment(segment);
+		return -1;
+	}
+	table->segments[0] = segment;
+	live->table = table;
+	live->epoch = 1;
+	mutex_init(&live->mutex);
+	cond_init(&live->compact_wanted);
+
+	if (background_compaction) {
+		live->background = 1;
+		if (thread_create(&live->compactor, compactor_main, live) != 0) {
+			fprintf(stderr, "Error: Failed to start compaction thread\n");
+			live->background = 0;
+			clean_live_gallery(live);
+			return -1;
+		}
+	}
+
+	*out_live = live;
+	return 0;
+}
+
+int live_gallery_append(LiveGallery* live, const float* template_data, int64_t id) {
+	if (live == NULL || template_data == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	for (;;) {
+		int slot = epoch_enter(live);
+		SegmentTable* table = (SegmentTable*)atomic_load_ptr(&live->table);
+		LiveSegment* segment = table->segments[table->count - 1];
+		int64_t row = atomic_fetch_add_64(&segment->reserved, 1);
+
+		if (row < segment->capacity) {
+			segment->norms[row] = normalize_template(template_data, segment->templates + (size_t)row * TEMPLATE_SIZE);
+			segment->ids[row] = id;
+			// Publish in reservation order so committed rows are always a complete prefix
+			while (atomic_load_64(&segment->committed) != row) {
+				thread_yield();
+			}
+			atomic_store_64(&segment->committed, row + 1);
+			epoch_exit(live, slot);
+			atomic_fetch_add_64(&live->live_rows, 1);
+			return 0;
+		}
+
+		epoch_exit(live, slot);
+		if (roll_over(live, segment) != 0) return -1;
+	}
+}
+
+int live_gallery_delete(LiveGallery* live, int64_t id) {
+	if (live == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	mutex_lock(&live->mutex);
+	SegmentTable* table = (SegmentTable*)atomic_load_ptr(&live->table);
+	int64_t* location = index_new_rows(live, table) == 0 ? id_map_get(&live->locations, id) : NULL;
+	if (location == NULL) {
+		mutex_unlock(&live->mutex);
+		return -1;
+	}
+
+	LiveSegment* segment = table->segments[*location >> 32];
+	atomic_store_flag(segment->tombstones + (*location & 0xffffffff), 1);
+	segment->dead++;
+	id_map_remove(&live->locations, id);
+	atomic_fetch_add_64(&live->live_rows, -1);
+
+	if (live->background && needs_compaction(segment) && segment != table->segments[table->count - 1]) {
+		live->compact_requested = 1;
+		cond_signal(&live->compact_wanted);
+	}
+	mutex_unlock(&live->mutex);
+	return 0;
+}
+
+int live_gallery_compact(LiveGallery* live) {
+	if (live == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	mutex_lock(&live->mutex);
+	int status = compact_locked(live);
+	mutex_unlock(&live->mutex);
+	return status;
+}
+
+int live_gallery_size(LiveGallery* live) {
+	return live == NULL ? 0 : (int)atomic_load_64(&live->live_rows);
+}
+
+int fingerprint_identify_live(const float* query_template, LiveGallery* live, int k, float threshold,
+	int64_t* out_ids, float* out_scores) {
+	if (query_template == NULL || live == NULL || k <= 0 || out_ids == NULL || out_scores == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	float query[TEMPLATE_SIZE];
+	normalize_template(query_template, query);
+
+	TopK topk;
+	topk_init(&topk, out_scores, out_ids, k);
+
+	int slot = epoch_enter(live);
+	SegmentTable* table = (SegmentTable*)atomic_load_ptr(&live->table);
+	for (int p = 0; p < table->count; p++) {
+		LiveSegment* segment = table->segments[p];
+		// Each segment is scored as a plain Gallery view over its committed prefix
+		Gallery view;
+		memset(&view, 0, sizeof(view));
+		view.templates = segment->templates;
+		view.norms = segment->norms;
+		view.ids = segment->ids;
+		view.tombstones = segment->tombstones;
+		view.size = (int)atomic_load_64(&segment->committed);
+		view.capacity = segment->capacity;
+		view.read_only = 1;
+		score_rows_topk(query, &view, 0, view.size, threshold, &topk);
+	}
+	epoch_exit(live, slot);
+
+	topk_sort(&topk);
+	return topk.size;
+}
+
+void clean_live_gallery(LiveGallery* live) {
+	if (live == NULL) return;
+
+	if (live->background) {
+		mutex_lock(&live->mutex);
+		live->stop = 1;
+		cond_signal(&live->compact_wanted);
+		mutex_unlock(&live->mutex);
+		thread_join(live->compactor);
+	}
+
+	SegmentTable* table = (SegmentTable*)live->table;
+	for (int p = 0; p < table->count; p++) {
+		free_segment(table->segments[p]);
+	}
+	free(table);
+	id_map_free(&live->locations);
+	cond_destroy(&live->compact_wanted);
+	mutex_destroy(&live->mutex);
+	free(live);
+}
@@ -0,0 +1,35 @@
+#ifndef LIVE_GALLERY_H
+#define LIVE_GALLERY_H
+
+#include "config.h"
+#include "gallery.h"
+
+// Rows per append segment (16 MB of fp32 templates)
+#define LIVE_SEGMENT_ROWS 65536
+// Concurrent searches / appends tracked for safe reclamation of swapped-out segments
+#define LIVE_MAX_READERS 128
+// A full segment is rewritten once this fraction of its rows is deleted
+#define LIVE_COMPACT_DEAD_FRACTION 0.25f
+
+// Gallery for continuous enrollment. Appends reserve a row in the last segment with an
+// atomic increment (no lock until a segment fills up), deletes set a tombstone that
+// searches skip, and compaction rewrites full segments into a new segment table that
+// is swapped in while searches keep reading the old one. Old segments are freed only
+// after every search that could still see them has finished (epoch-based reclamation).
+// Ids must be unique.
+typedef struct LiveGallery LiveGallery;
+
+// API function
+// background_compaction starts a thread that compacts whenever deletes cross the threshold
+DllAPI int create_live_gallery(int background_compaction, LiveGallery** out_live);
+DllAPI int live_gallery_append(LiveGallery* live, const float* template_data, int64_t id);
+DllAPI int live_gallery_delete(LiveGallery* live, int64_t id);
+// Rewrites full segments that reached LIVE_COMPACT_DEAD_FRACTION deleted rows; safe during searches
+DllAPI int live_gallery_compact(LiveGallery* live);
+// Rows appended and not deleted
+DllAPI int live_gallery_size(LiveGallery* live);
+DllAPI int fingerprint_identify_live(const float* query_template, LiveGallery* live, int k, float threshold,
+	int64_t* out_ids, float* out_scores);
+DllAPI void clean_live_gallery(LiveGallery* live);
+
+#endif // LIVE_GALLERY_H
@@ -1,6 +1,21 @@
 #include "matching.h"
+#include "cpu_features.h"
+#include "platform.h"
+#include "stats.h"
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef FINGERPRINT_USE_CBLAS
+#include <cblas.h>
+#endif
+
+#if defined(CPU_X86)
+#include <immintrin.h>
+#elif defined(CPU_ARM64)
+#include <arm_neon.h>
+#endif
 
 float cosine_similarity(const float* vector1, const float* vector2, int vector_length) {
 	float dot_product = 0.0;
@@ -37,14 +52,921 @@ float template_distance(const float* template1, const float* template2) {
 
 // API function	
 int fingerprint_identification(float* query_template, float** template_db, int db_size, float* score) {
+	STATS_START(timer);
 
 	for (int i = 0; i < db_size; i++) {
 		score[i] = template_distance(query_template, template_db[i]);
 	}
 
+	STATS_STOP(STATS_IDENTIFY, timer, db_size);
 	return 0;
 }
 
 float fingerprint_verification(const float* query_template, const float* verify_template) {
 	return template_distance(query_template, verify_template);
 }
+
+// Gallery scoring: distance[i] = 1 - dot(query, templates[i]) over L2-normalized rows.
+// Rows are scored in blocks of 4 so the query stays in registers and the four
+// horizontal sums share one reduction.
+typedef void (*score_kernel_fn)(const float* query, const float* templates, int count, float* distance);
+
+static void score_rows_scalar(const float* query, const float* templates, int count, float* distance) {
+	for (int i = 0; i < count; i++) {
+		const float* row = templates + (size_t)i * TEMPLATE_SIZE;
+		float dot_product = 0.0;
+		for (int k = 0; k < TEMPLATE_SIZE; k++) {
+			dot_product += query[k] * row[k];
+		}
+		distance[i] = 1.0f - dot_product;
+	}
+}
+
+#if defined(CPU_X86)
+TARGET_AVX2
+static void score_rows_avx2(const float* query, const float* templates, int count, float* distance) {
+	__m256 q[TEMPLATE_SIZE / 8];
+	for (int k = 0; k < TEMPLATE_SIZE / 8; k++) {
+		q[k] = _mm256_loadu_ps(query + k * 8);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float* row = templates + (size_t)i * TEMPLATE_SIZE;
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		__m256 acc2 = _mm256_setzero_ps();
+		__m256 acc3 = _mm256_setzero_ps();
+		for (int k = 0; k < TEMPLATE_SIZE / 8; k++) {
+			acc0 = _mm256_fmadd_ps(q[k], _mm256_load_ps(row + k * 8), acc0);
+			acc1 = _mm256_fmadd_ps(q[k], _mm256_load_ps(row + TEMPLATE_SIZE + k * 8), acc1);
+			acc2 = _mm256_fmadd_ps(q[k], _mm256_load_ps(row + 2 * TEMPLATE_SIZE + k * 8), acc2);
+			acc3 = _mm256_fmadd_ps(q[k], _mm256_load_ps(row + 3 * TEMPLATE_SIZE + k * 8), acc3);
+		}
+		// Reduce four accumulators to [dot0, dot1, dot2, dot3]
+		__m256 sum01 = _mm256_hadd_ps(acc0, acc1);
+		__m256 sum23 = _mm256_hadd_ps(acc2, acc3);
+		__m256 sum = _mm256_hadd_ps(sum01, sum23);
+		__m128 dots = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		_mm_storeu_ps(distance + i, _mm_sub_ps(_mm_set1_ps(1.0f), dots));
+	}
+	score_rows_scalar(query, templates + (size_t)i * TEMPLATE_SIZE, count - i, distance + i);
+}
+
+TARGET_AVX512
+static void score_rows_avx512(const float* query, const float* templates, int count, float* distance) {
+	__m512 q[TEMPLATE_SIZE / 16];
+	for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+		q[k] = _mm512_loadu_ps(query + k * 16);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float* row = templates + (size_t)i * TEMPLATE_SIZE;
+		__m512 acc[4];
+		for (int r = 0; r < 4; r++) {
+			acc[r] = _mm512_setzero_ps();
+			for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+				acc[r] = _mm512_fmadd_ps(q[k], _mm512_load_ps(row + r * TEMPLATE_SIZE + k * 16), acc[r]);
+			}
+		}
+		// Fold 512 -> 256 bits, then the same reduction as AVX2
+		__m256 half[4];
+		for (int r = 0; r < 4; r++) {
+			half[r] = _mm256_add_ps(_mm512_castps512_ps256(acc[r]),
+				_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc[r]), 1)));
+		}
+		__m256 sum = _mm256_hadd_ps(_mm256_hadd_ps(half[0], half[1]), _mm256_hadd_ps(half[2], half[3]));
+		__m128 dots = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		_mm_storeu_ps(distance + i, _mm_sub_ps(_mm_set1_ps(1.0f), dots));
+	}
+	score_rows_scalar(query, templates + (size_t)i * TEMPLATE_SIZE, count - i, distance + i);
+}
+#endif // CPU_X86
+
+#if defined(CPU_ARM64)
+static void score_rows_neon(const float* query, const float* templates, int count, float* distance) {
+	float32x4_t q[TEMPLATE_SIZE / 4];
+	for (int k = 0; k < TEMPLATE_SIZE / 4; k++) {
+		q[k] = vld1q_f32(query + k * 4);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const float* row = templates + (size_t)i * TEMPLATE_SIZE;
+		float32x4_t acc[4];
+		for (int r = 0; r < 4; r++) {
+			acc[r] = vdupq_n_f32(0.0f);
+			for (int k = 0; k < TEMPLATE_SIZE / 4; k++) {
+				acc[r] = vfmaq_f32(acc[r], q[k], vld1q_f32(row + r * TEMPLATE_SIZE + k * 4));
+			}
+		}
+		float32x4_t dots = vpaddq_f32(vpaddq_f32(acc[0], acc[1]), vpaddq_f32(acc[2], acc[3]));
+		vst1q_f32(distance + i, vsubq_f32(vdupq_n_f32(1.0f), dots));
+	}
+	score_rows_scalar(query, templates + (size_t)i * TEMPLATE_SIZE, count - i, distance + i);
+}
+#endif // CPU_ARM64
+
+static score_kernel_fn score_kernel(void) {
+#if defined(CPU_X86)
+	int features = cpu_features();
+	if (features & CPU_FEATURE_AVX512F) return score_rows_avx512;
+	if (features & CPU_FEATURE_AVX2) return score_rows_avx2;
+#elif defined(CPU_ARM64)
+	if (cpu_features() & CPU_FEATURE_NEON) return score_rows_neon;
+#endif
+	return score_rows_scalar;
+}
+
+// Per-call state shared by the shard tasks of one parallel search
+typedef struct ShardSearch {
+	const float* query;
+	const Gallery* gallery;
+	float threshold;
+	TopK* heaps;     // One per worker, merged after the run
+	float* score;    // Full score array when no top-K is requested
+} ShardSearch;
+
+static int shard_count(const Gallery* gallery) {
+	return (gallery->size + GALLERY_SHARD_SIZE - 1) / GALLERY_SHARD_SIZE;
+}
+
+static void score_shard(void* arg, int shard, int thread_index) {
+	ShardSearch* search = (ShardSearch*)arg;
+	(void)thread_index;
+
+	int begin = shard * GALLERY_SHARD_SIZE;
+	int count = search->gallery->size - begin < GALLERY_SHARD_SIZE ? search->gallery->size - begin : GALLERY_SHARD_SIZE;
+	score_kernel()(search->query, search->gallery->templates + (size_t)begin * TEMPLATE_SIZE, count, search->score + begin);
+}
+
+static void score_shard_topk(void* arg, int shard, int thread_index) {
+	ShardSearch* search = (ShardSearch*)arg;
+
+	int begin = shard * GALLERY_SHARD_SIZE;
+	int end = begin + GALLERY_SHARD_SIZE < search->gallery->size ? begin + GALLERY_SHARD_SIZE : search->gallery->size;
+	score_rows_topk(search->query, search->gallery, begin, end, search->threshold, &search->heaps[thread_index]);
+}
+
+// API function
+int fingerprint_identification_gallery(const float* query_template, const Gallery* gallery, float* score) {
+	if (query_template == NULL || gallery == NULL || score == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	STATS_START(timer);
+
+	// Normalize the query once instead of once per gallery entry
+	float query[TEMPLATE_SIZE];
+	normalize_template(query_template, query);
+
+	int result = 0;
+	if (gallery->pool != NULL && gallery->size > GALLERY_SHARD_SIZE) {
+		ShardSearch search = { query, gallery, 0.0f, NULL, score };
+		result = thread_pool_run(gallery->pool, score_shard, &search, shard_count(gallery));
+	}
+	else {
+		score_kernel()(query, gallery->templates, gallery->size, score);
+	}
+
+	if (result == 0) STATS_STOP(STATS_IDENTIFY_GALLERY, timer, gallery->size);
+	return result;
+}
+
+// Bounded max-heap on distance: the root is the worst of the current k best
+void topk_init(TopK* topk, float* scores, int64_t* ids, int k) {
+	topk->scores = scores;
+	topk->ids = ids;
+	topk->size = 0;
+	topk->k = k;
+}
+
+static void topk_swap(TopK* topk, int a, int b) {
+	float score = topk->scores[a];
+	int64_t id = topk->ids[a];
+	topk->scores[a] = topk->scores[b];
+	topk->ids[a] = topk->ids[b];
+	topk->scores[b] = score;
+	topk->ids[b] = id;
+}
+
+void topk_push(TopK* topk, float score, int64_t id) {
+	if (topk->size < topk->k) {
+		// Sift up
+		int i = topk->size++;
+		topk->scores[i] = score;
+		topk->ids[i] = id;
+		while (i > 0 && topk->scores[(i - 1) / 2] < topk->scores[i]) {
+			topk_swap(topk, i, (i - 1) / 2);
+			i = (i - 1) / 2;
+		}
+		return;
+	}
+	if (topk->k == 0 || score >= topk->scores[0]) return;
+
+	// Replace the root and sift down
+	topk->scores[0] = score;
+	topk->ids[0] = id;
+	int i = 0;
+	for (;;) {
+		int largest = i;
+		int left = 2 * i + 1, right = 2 * i + 2;
+		if (left < topk->size && topk->scores[left] > topk->scores[largest]) largest = left;
+		if (right < topk->size && topk->scores[right] > topk->scores[largest]) largest = right;
+		if (largest == i) break;
+		topk_swap(topk, i, largest);
+		i = largest;
+	}
+}
+
+void topk_merge(TopK* topk, const TopK* other) {
+	for (int i = 0; i < other->size; i++) {
+		topk_push(topk, other->scores[i], other->ids[i]);
+	}
+}
+
+// Heap-sort in place: ascending distance, best match first
+void topk_sort(TopK* topk) {
+	int size = topk->size;
+	while (topk->size > 1) {
+		topk_swap(topk, 0, topk->size - 1);
+		topk->size--;
+		int i = 0;
+		for (;;) {
+			int largest = i;
+			int left = 2 * i + 1, right = 2 * i + 2;
+			if (left < topk->size && topk->scores[left] > topk->scores[largest]) largest = left;
+			if (right < topk->size && topk->scores[right] > topk->scores[largest]) largest = right;
+			if (largest == i) break;
+			topk_swap(topk, i, largest);
+			i = largest;
+		}
+	}
+	topk->size = size;
+}
+
+// Current rejection bound: the threshold until k candidates are held, then the k-th best
+float topk_bound(const TopK* topk, float threshold) {
+	if (topk->size < topk->k) return threshold;
+	return topk->scores[0] < threshold ? topk->scores[0] : threshold;
+}
+
+// Offers one block of distances; most rows fail the bound check and never touch the heap,
+// so tombstones (may be NULL) are only consulted for rows that would be kept
+static void push_block(TopK* topk, const float* distance, int count, const int64_t* ids,
+	const volatile uint8_t* tombstones, float threshold) {
+	float bound = topk_bound(topk, threshold);
+	for (int i = 0; i < count; i++) {
+		if (distance[i] < bound || (distance[i] == bound && topk->size < topk->k)) {
+			if (tombstones != NULL && atomic_load_flag(tombstones + i)) continue;
+			topk_push(topk, distance[i], ids[i]);
+			bound = topk_bound(topk, threshold);
+		}
+	}
+}
+
+// Scores gallery rows [begin, end) block by block into the heap; no full score array is materialized
+void score_rows_topk(const float* query, const Gallery* gallery, int begin, int end, float threshold, TopK* topk) {
+	score_kernel_fn kernel = score_kernel();
+	float distance[SCORE_BLOCK_SIZE];
+
+	for (int start = begin; start < end; start += SCORE_BLOCK_SIZE) {
+		int count = end - start < SCORE_BLOCK_SIZE ? end - start : SCORE_BLOCK_SIZE;
+		kernel(query, gallery->templates + (size_t)start * TEMPLATE_SIZE, count, distance);
+
+		push_block(topk, distance, count, gallery->ids + start,
+			gallery->tombstones != NULL ? gallery->tombstones + start : NULL, threshold);
+	}
+}
+
+// API function
+int fingerprint_identify_topk(const float* query_template, const Gallery* gallery, int k, float threshold,
+	int64_t* out_ids, float* out_scores) {
+	if (query_template == NULL || gallery == NULL || k <= 0 || out_ids == NULL || out_scores == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	STATS_START(timer);
+
+	float query[TEMPLATE_SIZE];
+	normalize_template(query_template, query);
+
+	TopK topk;
+	topk_init(&topk, out_scores, out_ids, k);
+
+	if (gallery->pool != NULL && gallery->size > GALLERY_SHARD_SIZE) {
+		int num_threads = thread_pool_size(gallery->pool);
+		TopK* heaps = (TopK*)malloc(num_threads * sizeof(TopK));
+		float* heap_scores = (float*)malloc((size_t)num_threads * k * sizeof(float));
+		int64_t* heap_ids = (int64_t*)malloc((size_t)num_threads * k * sizeof(int64_t));
+		if (heaps == NULL || heap_scores == NULL || heap_ids == NULL) {
+			fprintf(stderr, "Error: Memory allocation failed\n");
+			free(heaps);
+			free(heap_scores);
+			free(heap_ids);
+			return -1;
+		}
+		for (int t = 0; t < num_threads; t++) {
+			topk_init(&heaps[t], heap_scores + (size_t)t * k, heap_ids + (size_t)t * k, k);
+		}
+
+		ShardSearch search = { query, gallery, threshold, heaps, NULL };
+		thread_pool_run(gallery->pool, score_shard_topk, &search, shard_count(gallery));
+		for (int t = 0; t < num_threads; t++) {
+			topk_merge(&topk, &heaps[t]);
+		}
+
+		free(heaps);
+		free(heap_scores);
+		free(heap_ids);
+	}
+	else {
+		score_rows_topk(query, gallery, 0, gallery->size, threshold, &topk);
+	}
+	topk_sort(&topk);
+
+	STATS_STOP(STATS_IDENTIFY_TOPK, timer, gallery->size);
+	return topk.size;
+}
+
+// Batch scoring: dots = queries x block^T. A block of BATCH_BLOCK_ROWS gallery rows is
+// packed dimension-major once and reused by every query, so the gallery streams
+// through memory once per batch instead of once per probe. The micro-kernels compute
+// a 4-query x BATCH_BLOCK_ROWS tile with queries broadcast against packed columns.
+typedef void (*gemm_kernel_fn)(const float* queries, const float* packed, float* dots);
+
+// Transposes rows into packed[d * BATCH_BLOCK_ROWS + r], zero-padding past count
+static void pack_block(const float* templates, int count, float* packed) {
+	for (int d = 0; d < TEMPLATE_SIZE; d++) {
+		float* column = packed + (size_t)d * BATCH_BLOCK_ROWS;
+		for (int r = 0; r < count; r++) {
+			column[r] = templates[(size_t)r * TEMPLATE_SIZE + d];
+		}
+		for (int r = count; r < BATCH_BLOCK_ROWS; r++) {
+			column[r] = 0.0f;
+		}
+	}
+}
+
+static void gemm_tile_scalar(const float* queries, const float* packed, float* dots) {
+	for (int q = 0; q < 4; q++) {
+		float* out = dots + q * BATCH_BLOCK_ROWS;
+		for (int c = 0; c < BATCH_BLOCK_ROWS; c++) {
+			out[c] = 0.0f;
+		}
+		for (int d = 0; d < TEMPLATE_SIZE; d++) {
+			float value = queries[q * TEMPLATE_SIZE + d];
+			const float* column = packed + (size_t)d * BATCH_BLOCK_ROWS;
+			for (int c = 0; c < BATCH_BLOCK_ROWS; c++) {
+				out[c] += value * column[c];
+			}
+		}
+	}
+}
+
+#if defined(CPU_X86)
+TARGET_AVX2
+static void gemm_tile_avx2(const float* queries, const float* packed, float* dots) {
+	for (int c = 0; c < BATCH_BLOCK_ROWS; c += 16) {
+		__m256 acc[4][2];
+		for (int q = 0; q < 4; q++) {
+			acc[q][0] = _mm256_setzero_ps();
+			acc[q][1] = _mm256_setzero_ps();
+		}
+		for (int d = 0; d < TEMPLATE_SIZE; d++) {
+			__m256 g0 = _mm256_load_ps(packed + (size_t)d * BATCH_BLOCK_ROWS + c);
+			__m256 g1 = _mm256_load_ps(packed + (size_t)d * BATCH_BLOCK_ROWS + c + 8);
+			for (int q = 0; q < 4; q++) {
+				__m256 value = _mm256_broadcast_ss(queries + q * TEMPLATE_SIZE + d);
+				acc[q][0] = _mm256_fmadd_ps(value, g0, acc[q][0]);
+				acc[q][1] = _mm256_fmadd_ps(value, g1, acc[q][1]);
+			}
+		}
+		for (int q = 0; q < 4; q++) {
+			_mm256_store_ps(dots + q * BATCH_BLOCK_ROWS + c, acc[q][0]);
+			_mm256_store_ps(dots + q * BATCH_BLOCK_ROWS + c + 8, acc[q][1]);
+		}
+	}
+}
+
+TARGET_AVX512
+static void gemm_tile_avx512(const float* queries, const float* packed, float* dots) {
+	for (int c = 0; c < BATCH_BLOCK_ROWS; c += 32) {
+		__m512 acc[4][2];
+		for (int q = 0; q < 4; q++) {
+			acc[q][0] = _mm512_setzero_ps();
+			acc[q][1] = _mm512_setzero_ps();
+		}
+		for (int d = 0; d < TEMPLATE_SIZE; d++) {
+			__m512 g0 = _mm512_load_ps(packed + (size_t)d * BATCH_BLOCK_ROWS + c);
+			__m512 g1 = _mm512_load_ps(packed + (size_t)d * BATCH_BLOCK_ROWS + c + 16);
+			for (int q = 0; q < 4; q++) {
+				__m512 value = _mm512_set1_ps(queries[q * TEMPLATE_SIZE + d]);
+				acc[q][0] = _mm512_fmadd_ps(value, g0, acc[q][0]);
+				acc[q][1] = _mm512_fmadd_ps(value, g1, acc[q][1]);
+			}
+		}
+		for (int q = 0; q < 4; q++) {
+			_mm512_store_ps(dots + q * BATCH_BLOCK_ROWS + c, acc[q][0]);
+			_mm512_store_ps(dots + q * BATCH_BLOCK_ROWS + c + 16, acc[q][1]);
+		}
+	}
+}
+#endif // CPU_X86
+
+#if defined(CPU_ARM64)
+static void gemm_tile_neon(const float* queries, const float* packed, float* dots) {
+	for (int c = 0; c < BATCH_BLOCK_ROWS; c += 8) {
+		float32x4_t acc[4][2];
+		for (int q = 0; q < 4; q++) {
+			acc[q][0] = vdupq_n_f32(0.0f);
+			acc[q][1] = vdupq_n_f32(0.0f);
+		}
+		for (int d = 0; d < TEMPLATE_SIZE; d++) {
+			float32x4_t g0 = vld1q_f32(packed + (size_t)d * BATCH_BLOCK_ROWS + c);
+			float32x4_t g1 = vld1q_f32(packed + (size_t)d * BATCH_BLOCK_ROWS + c + 4);
+			for (int q = 0; q < 4; q++) {
+				float value = queries[q * TEMPLATE_SIZE + d];
+				acc[q][0] = vfmaq_n_f32(acc[q][0], g0, value);
+				acc[q][1] = vfmaq_n_f32(acc[q][1], g1, value);
+			}
+		}
+		for (int q = 0; q < 4; q++) {
+			vst1q_f32(dots + q * BATCH_BLOCK_ROWS + c, acc[q][0]);
+			vst1q_f32(dots + q * BATCH_BLOCK_ROWS + c + 4, acc[q][1]);
+		}
+	}
+}
+#endif // CPU_ARM64
+
+static gemm_kernel_fn gemm_kernel(void) {
+#if defined(CPU_X86)
+	int features = cpu_features();
+	if (features & CPU_FEATURE_AVX512F) return gemm_tile_avx512;
+	if (features & CPU_FEATURE_AVX2) return gemm_tile_avx2;
+#elif defined(CPU_ARM64)
+	if (cpu_features() & CPU_FEATURE_NEON) return gemm_tile_neon;
+#endif
+	return gemm_tile_scalar;
+}
+
+// Per-worker scratch: one packed block followed by one dot tile
+#define BATCH_SCRATCH_SIZE ((size_t)TEMPLATE_SIZE * BATCH_BLOCK_ROWS + (size_t)BATCH_QUERY_TILE * BATCH_BLOCK_ROWS)
+
+typedef struct BatchSearch {
+	const float* queries;   // Normalized, padded with zero rows to a multiple of 4
+	int num_queries;
+	const Gallery* gallery;
+	float threshold;
+	TopK* heaps;            // num_queries per worker
+	float* scratch;         // BATCH_SCRATCH_SIZE per worker
+} BatchSearch;
+
+static void score_batch_rows(const BatchSearch* search, int begin, int end, TopK* heaps, float* scratch) {
+	const Gallery* gallery = search->gallery;
+	float* packed = scratch;
+	float* dots = scratch + (size_t)TEMPLATE_SIZE * BATCH_BLOCK_ROWS;
+#ifndef FINGERPRINT_USE_CBLAS
+	gemm_kernel_fn kernel = gemm_kernel();
+#endif
+
+	for (int start = begin; start < end; start += BATCH_BLOCK_ROWS) {
+		int count = end - start < BATCH_BLOCK_ROWS ? end - start : BATCH_BLOCK_ROWS;
+		const float* rows = gallery->templates + (size_t)start * TEMPLATE_SIZE;
+#ifndef FINGERPRINT_USE_CBLAS
+		pack_block(rows, count, packed);
+#else
+		(void)packed;
+#endif
+
+		for (int q0 = 0; q0 < search->num_queries; q0 += BATCH_QUERY_TILE) {
+			int tile = search->num_queries - q0 < BATCH_QUERY_TILE ? search->num_queries - q0 : BATCH_QUERY_TILE;
+#ifdef FINGERPRINT_USE_CBLAS
+			cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, tile, count, TEMPLATE_SIZE, 1.0f,
+				search->queries + (size_t)q0 * TEMPLATE_SIZE, TEMPLATE_SIZE, rows, TEMPLATE_SIZE, 0.0f, dots, BATCH_BLOCK_ROWS);
+#else
+			for (int q = 0; q < tile; q += 4) {
+				kernel(search->queries + (size_t)(q0 + q) * TEMPLATE_SIZE, packed, dots + (size_t)q * BATCH_BLOCK_ROWS);
+			}
+#endif
+			for (int q = 0; q < tile; q++) {
+				float* distance = dots + (size_t)q * BATCH_BLOCK_ROWS;
+				for (int i = 0; i < count; i++) {
+					distance[i] = 1.0f - distance[i];
+				}
+				push_block(&heaps[q0 + q], distance, count, gallery->ids + start,
+					gallery->tombstones != NULL ? gallery->tombstones + start : NULL, search->threshold);
+			}
+		}
+	}
+}
+
+static void score_batch_shard(void* arg, int shard, int thread_index) {
+	BatchSearch* search = (BatchSearch*)arg;
+
+	int begin = shard * GALLERY_SHARD_SIZE;
+	int end = begin + GALLERY_SHARD_SIZE < search->gallery->size ? begin + GALLERY_SHARD_SIZE : search->gallery->size;
+	score_batch_rows(search, begin, end, search->heaps + (size_t)thread_index * search->num_queries,
+		search->scratch + (size_t)thread_index * BATCH_SCRATCH_SIZE);
+}
+
+// API function
+int fingerprint_identify_batch(const float* query_templates, int num_queries, const Gallery* gallery, int k, float threshold,
+	int64_t* out_ids, float* out_scores, int* out_counts) {
+	if (query_templates == NULL || num_queries < 0 || gallery == NULL || k <= 0 ||
+		out_ids == NULL || out_scores == NULL || out_counts == NULL) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+	if (num_queries == 0) return 0;
+	STATS_START(timer);
+
+	int parallel = gallery->pool != NULL && gallery->size > GALLERY_SHARD_SIZE;
+	int num_threads = parallel ? thread_pool_size(gallery->pool) : 1;
+	// Worker heaps only exist when there is more than one partial result to merge
+	size_t heap_entries = parallel ? (size_t)num_threads * num_queries * k : 0;
+	int padded_queries = (num_queries + 3) & ~3;
+
+	float* queries = (float*)aligned_malloc((size_t)padded_queries * TEMPLATE_SIZE * sizeof(float), MEMORY_ALIGNMENT);
+	float* scratch = (float*)aligned_malloc((size_t)num_threads * BATCH_SCRATCH_SIZE * sizeof(float), MEMORY_ALIGNMENT);
+	TopK* heaps = (TopK*)malloc(((size_t)num_threads + 1) * num_queries * sizeof(TopK));
+	float* heap_scores = NULL;
+	int64_t* heap_ids = NULL;
+	if (heap_entries > 0) {
+		heap_scores = (float*)malloc(heap_entries * sizeof(float));
+		heap_ids = (int64_t*)malloc(heap_entries * sizeof(int64_t));
+	}
+	if (queries == NULL || scratch == NULL || heaps == NULL ||
+		(heap_entries > 0 && (heap_scores == NULL || heap_ids == NULL))) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		aligned_free(queries);
+		aligned_free(scratch);
+		free(heaps);
+		free(heap_scores);
+		free(heap_ids);
+		return -1;
+	}
+
+	for (int q = 0; q < num_queries; q++) {
+		normalize_template(query_templates + (size_t)q * TEMPLATE_SIZE, queries + (size_t)q * TEMPLATE_SIZE);
+	}
+	memset(queries + (size_t)num_queries * TEMPLATE_SIZE, 0, (size_t)(padded_queries - num_queries) * TEMPLATE_SIZE * sizeof(float));
+
+	// The last num_queries heaps are the outputs
+	TopK* results = heaps + (size_t)num_threads * num_queries;
+	for (int q = 0; q < num_queries; q++) {
+		topk_init(&results[q], out_scores + (size_t)q * k, out_ids + (size_t)q * k, k);
+	}
+
+	BatchSearch search = { queries, num_queries, gallery, threshold, heaps, scratch };
+	if (parallel) {
+		for (size_t h = 0; h < (size_t)num_threads * num_queries; h++) {
+			topk_init(&heaps[h], heap_scores + h * k, heap_ids + h * k, k);
+		}
+		thread_pool_run(gallery->pool, score_batch_shard, &search, shard_count(gallery));
+		for (int t = 0; t < num_threads; t++) {
+			for (int q = 0; q < num_queries; q++) {
+				topk_merge(&results[q], &heaps[(size_t)t * num_queries + q]);
+			}
+		}
+	}
+	else {
+		score_batch_rows(&search, 0, gallery->size, results, scratch);
+	}
+
+	for (int q = 0; q < num_queries; q++) {
+		topk_sort(&results[q]);
+		out_counts[q] = results[q].size;
+	}
+
+	aligned_free(queries);
+	aligned_free(scratch);
+	free(heaps);
+	free(heap_scores);
+	free(heap_ids);
+	STATS_STOP(STATS_IDENTIFY_BATCH, timer, (uint64_t)num_queries * gallery->size);
+	return 0;
+}
+
+// Quantized scoring. int8 kernels return exact integer dots of the codes; fp16
+// kernels widen to fp32 in registers and return distances like score_kernel.
+typedef void (*int8_kernel_fn)(const int8_t* query, const int8_t* codes, int count, int32_t* dots);
+typedef void (*fp16_kernel_fn)(const float* query, const uint16_t* codes, int count, float* distance);
+
+static void dot_rows_int8_scalar(const int8_t* query, const int8_t* codes, int count, int32_t* dots) {
+	for (int i = 0; i < count; i++) {
+		const int8_t* row = codes + (size_t)i * TEMPLATE_SIZE;
+		int32_t dot_product = 0;
+		for (int k = 0; k < TEMPLATE_SIZE; k++) {
+			dot_product += query[k] * row[k];
+		}
+		dots[i] = dot_product;
+	}
+}
+
+static void score_rows_fp16_scalar(const float* query, const uint16_t* codes, int count, float* distance) {
+	for (int i = 0; i < count; i++) {
+		const uint16_t* row = codes + (size_t)i * TEMPLATE_SIZE;
+		float dot_product = 0.0;
+		for (int k = 0; k < TEMPLATE_SIZE; k++) {
+			dot_product += query[k] * half_to_float(row[k]);
+		}
+		distance[i] = 1.0f - dot_product;
+	}
+}
+
+#if defined(CPU_X86)
+// abs(q) * sign(g, q) == q * g keeps maddubs (u8 x s8 -> s16 pairs) clear of saturation for codes in [-127, 127]
+TARGET_AVX2
+static void dot_rows_int8_avx2(const int8_t* query, const int8_t* codes, int count, int32_t* dots) {
+	__m256i q0 = _mm256_loadu_si256((const __m256i*)query);
+	__m256i q1 = _mm256_loadu_si256((const __m256i*)(query + 32));
+	__m256i q0_abs = _mm256_abs_epi8(q0);
+	__m256i q1_abs = _mm256_abs_epi8(q1);
+	__m256i ones = _mm256_set1_epi16(1);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256i acc[4];
+		for (int r = 0; r < 4; r++) {
+			const int8_t* row = codes + (size_t)(i + r) * TEMPLATE_SIZE;
+			__m256i g0 = _mm256_sign_epi8(_mm256_load_si256((const __m256i*)row), q0);
+			__m256i g1 = _mm256_sign_epi8(_mm256_load_si256((const __m256i*)(row + 32)), q1);
+			// Widen each half separately: two saturating s16 pair sums could overflow when added
+			acc[r] = _mm256_add_epi32(_mm256_madd_epi16(_mm256_maddubs_epi16(q0_abs, g0), ones),
+				_mm256_madd_epi16(_mm256_maddubs_epi16(q1_abs, g1), ones));
+		}
+		__m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(acc[0], acc[1]), _mm256_hadd_epi32(acc[2], acc[3]));
+		__m128i result = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		_mm_storeu_si128((__m128i*)(dots + i), result);
+	}
+	dot_rows_int8_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, dots + i);
+}
+
+// One 64-byte row per vpdpbusd; negating g where q < 0 lets |q| serve as the unsigned operand
+TARGET_AVX512_VNNI
+static void dot_rows_int8_vnni(const int8_t* query, const int8_t* codes, int count, int32_t* dots) {
+	__m512i q = _mm512_loadu_si512((const void*)query);
+	__m512i q_abs = _mm512_abs_epi8(q);
+	__mmask64 negative = _mm512_movepi8_mask(q);
+	__m512i zero = _mm512_setzero_si512();
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256i half[4];
+		for (int r = 0; r < 4; r++) {
+			__m512i g = _mm512_load_si512((const void*)(codes + (size_t)(i + r) * TEMPLATE_SIZE));
+			g = _mm512_mask_sub_epi8(g, negative, zero, g);
+			__m512i acc = _mm512_dpbusd_epi32(zero, q_abs, g);
+			half[r] = _mm256_add_epi32(_mm512_castsi512_si256(acc), _mm512_extracti64x4_epi64(acc, 1));
+		}
+		__m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(half[0], half[1]), _mm256_hadd_epi32(half[2], half[3]));
+		__m128i result = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		_mm_storeu_si128((__m128i*)(dots + i), result);
+	}
+	dot_rows_int8_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, dots + i);
+}
+
+TARGET_AVX2_F16C
+static void score_rows_fp16_avx2(const float* query, const uint16_t* codes, int count, float* distance) {
+	__m256 q[TEMPLATE_SIZE / 8];
+	for (int k = 0; k < TEMPLATE_SIZE / 8; k++) {
+		q[k] = _mm256_loadu_ps(query + k * 8);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256 acc[4];
+		for (int r = 0; r < 4; r++) {
+			const uint16_t* row = codes + (size_t)(i + r) * TEMPLATE_SIZE;
+			acc[r] = _mm256_setzero_ps();
+			for (int k = 0; k < TEMPLATE_SIZE / 8; k++) {
+				__m256 g = _mm256_cvtph_ps(_mm_load_si128((const __m128i*)(row + k * 8)));
+				acc[r] = _mm256_fmadd_ps(q[k], g, acc[r]);
+			}
+		}
+		__m256 sum = _mm256_hadd_ps(_mm256_hadd_ps(acc[0], acc[1]), _mm256_hadd_ps(acc[2], acc[3]));
+		__m128 dots = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		_mm_storeu_ps(distance + i, _mm_sub_ps(_mm_set1_ps(1.0f), dots));
+	}
+	score_rows_fp16_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, distance + i);
+}
+
+TARGET_AVX512
+static void score_rows_fp16_avx512(const float* query, const uint16_t* codes, int count, float* distance) {
+	__m512 q[TEMPLATE_SIZE / 16];
+	for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+		q[k] = _mm512_loadu_ps(query + k * 16);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256 half[4];
+		for (int r = 0; r < 4; r++) {
+			const uint16_t* row = codes + (size_t)(i + r) * TEMPLATE_SIZE;
+			__m512 acc = _mm512_setzero_ps();
+			for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+				__m512 g = _mm512_cvtph_ps(_mm256_load_si256((const __m256i*)(row + k * 16)));
+				acc = _mm512_fmadd_ps(q[k], g, acc);
+			}
+			half[r] = _mm256_add_ps(_mm512_castps512_ps256(acc),
+				_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc), 1)));
+		}
+		__m256 sum = _mm256_hadd_ps(_mm256_hadd_ps(half[0], half[1]), _mm256_hadd_ps(half[2], half[3]));
+		__m128 dots = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		_mm_storeu_ps(distance + i, _mm_sub_ps(_mm_set1_ps(1.0f), dots));
+	}
+	score_rows_fp16_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, distance + i);
+}
+#endif // CPU_X86
+
+#if defined(CPU_ARM64)
+static void dot_rows_int8_neon(const int8_t* query, const int8_t* codes, int count, int32_t* dots) {
+	int8x16_t q[TEMPLATE_SIZE / 16];
+	for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+		q[k] = vld1q_s8(query + k * 16);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		int32x4_t acc[4];
+		for (int r = 0; r < 4; r++) {
+			const int8_t* row = codes + (size_t)(i + r) * TEMPLATE_SIZE;
+			acc[r] = vdupq_n_s32(0);
+			for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+				int8x16_t g = vld1q_s8(row + k * 16);
+				int16x8_t products = vmull_s8(vget_low_s8(q[k]), vget_low_s8(g));
+				products = vmlal_s8(products, vget_high_s8(q[k]), vget_high_s8(g));
+				acc[r] = vpadalq_s16(acc[r], products);
+			}
+		}
+		vst1q_s32(dots + i, vpaddq_s32(vpaddq_s32(acc[0], acc[1]), vpaddq_s32(acc[2], acc[3])));
+	}
+	dot_rows_int8_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, dots + i);
+}
+
+TARGET_NEON_DOTPROD
+static void dot_rows_int8_sdot(const int8_t* query, const int8_t* codes, int count, int32_t* dots) {
+	int8x16_t q[TEMPLATE_SIZE / 16];
+	for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+		q[k] = vld1q_s8(query + k * 16);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		int32x4_t acc[4];
+		for (int r = 0; r < 4; r++) {
+			const int8_t* row = codes + (size_t)(i + r) * TEMPLATE_SIZE;
+			acc[r] = vdupq_n_s32(0);
+			for (int k = 0; k < TEMPLATE_SIZE / 16; k++) {
+				acc[r] = vdotq_s32(acc[r], q[k], vld1q_s8(row + k * 16));
+			}
+		}
+		vst1q_s32(dots + i, vpaddq_s32(vpaddq_s32(acc[0], acc[1]), vpaddq_s32(acc[2], acc[3])));
+	}
+	dot_rows_int8_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, dots + i);
+}
+
+static void score_rows_fp16_neon(const float* query, const uint16_t* codes, int count, float* distance) {
+	float32x4_t q[TEMPLATE_SIZE / 4];
+	for (int k = 0; k < TEMPLATE_SIZE / 4; k++) {
+		q[k] = vld1q_f32(query + k * 4);
+	}
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t acc[4];
+		for (int r = 0; r < 4; r++) {
+			const uint16_t* row = codes + (size_t)(i + r) * TEMPLATE_SIZE;
+			acc[r] = vdupq_n_f32(0.0f);
+			for (int k = 0; k < TEMPLATE_SIZE / 4; k++) {
+				float32x4_t g = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(row + k * 4)));
+				acc[r] = vfmaq_f32(acc[r], q[k], g);
+			}
+		}
+		float32x4_t dots = vpaddq_f32(vpaddq_f32(acc[0], acc[1]), vpaddq_f32(acc[2], acc[3]));
+		vst1q_f32(distance + i, vsubq_f32(vdupq_n_f32(1.0f), dots));
+	}
+	score_rows_fp16_scalar(query, codes + (size_t)i * TEMPLATE_SIZE, count - i, distance + i);
+}
+#endif // CPU_ARM64
+
+static int8_kernel_fn int8_kernel(void) {
+#if defined(CPU_X86)
+	int features = cpu_features();
+	if (features & CPU_FEATURE_AVX512_VNNI) return dot_rows_int8_vnni;
+	if (features & CPU_FEATURE_AVX2) return dot_rows_int8_avx2;
+#elif defined(CPU_ARM64)
+	int features = cpu_features();
+	if (features & CPU_FEATURE_NEON_DOTPROD) return dot_rows_int8_sdot;
+	if (features & CPU_FEATURE_NEON) return dot_rows_int8_neon;
+#endif
+	return dot_rows_int8_scalar;
+}
+
+static fp16_kernel_fn fp16_kernel(void) {
+#if defined(CPU_X86)
+	int features = cpu_features();
+	if (features & CPU_FEATURE_AVX512F) return score_rows_fp16_avx512;
+	if ((features & CPU_FEATURE_AVX2) && (features & CPU_FEATURE_F16C)) return score_rows_fp16_avx2;
+#elif defined(CPU_ARM64)
+	if (cpu_features() & CPU_FEATURE_NEON) return score_rows_fp16_neon;
+#endif
+	return score_rows_fp16_scalar;
+}
+
+// Approximate distances for quantized rows [start, start + count)
+static void score_rows_quantized(const QuantizedGallery* quantized, const float* query, const int8_t* query_codes,
+	float query_scale, int start, int count, float* distance) {
+	if (quantized->encoding == GALLERY_ENCODING_FP16) {
+		fp16_kernel()(query, (const uint16_t*)quantized->codes + (size_t)start * TEMPLATE_SIZE, count, distance);
+		return;
+	}
+
+	int32_t dots[SCORE_BLOCK_SIZE];
+	int8_kernel()(query_codes, (const int8_t*)quantized->codes + (size_t)start * TEMPLATE_SIZE, count, dots);
+	if (quantized->encoding == GALLERY_ENCODING_INT8) {
+		for (int i = 0; i < count; i++) {
+			distance[i] = 1.0f - (float)dots[i] * query_scale * quantized->scales[start + i];
+		}
+	}
+	else {
+		float scale = query_scale * quantized->scale;
+		for (int i = 0; i < count; i++) {
+			distance[i] = 1.0f - (float)dots[i] * scale;
+		}
+	}
+}
+
+// API function
+int fingerprint_identify_topk_quantized(const float* query_template, const QuantizedGallery* quantized,
+	const Gallery* rerank_gallery, int k, float threshold, int64_t* out_ids, float* out_scores) {
+	if (query_template == NULL || quantized == NULL || k <= 0 || out_ids == NULL || out_scores == NULL ||
+		(rerank_gallery != NULL && rerank_gallery->size != quantized->size)) {
+		fprintf(stderr, "Invalid input parameters.\n");
+		return -1;
+	}
+
+	STATS_START(timer);
+
+	float query[TEMPLATE_SIZE];
+	normalize_template(query_template, query);
+
+	float max_abs = 0.0f;
+	for (int i = 0; i < TEMPLATE_SIZE; i++) {
+		if (fabsf(query[i]) > max_abs) max_abs = fabsf(query[i]);
+	}
+	int8_t query_codes[TEMPLATE_SIZE];
+	float query_scale = quantize_int8(query, TEMPLATE_SIZE, max_abs, query_codes);
+
+	// With rerank, over-fetch row indices with a looser bound, then rescore them exactly
+	int candidates = rerank_gallery != NULL ? k * QUANTIZED_RERANK_FACTOR : k;
+	float bound = rerank_gallery != NULL ? threshold + QUANTIZED_RERANK_MARGIN : threshold;
+	float* candidate_scores = (float*)malloc(candidates * sizeof(float));
+	int64_t* candidate_rows = (int64_t*)malloc(candidates * sizeof(int64_t));
+	if (candidate_scores == NULL || candidate_rows == NULL) {
+		fprintf(stderr, "Error: Memory allocation failed\n");
+		free(candidate_scores);
+		free(candidate_rows);
+		return -1;
+	}
+
+	TopK topk;
+	topk_init(&topk, candidate_scores, candidate_rows, candidates);
+	float distance[SCORE_BLOCK_SIZE];
+	int64_t rows[SCORE_BLOCK_SIZE];
+	for (int start = 0; start < quantized->size; start += SCORE_BLOCK_SIZE) {
+		int count = quantized->size - start < SCORE_BLOCK_SIZE ? quantized->size - start : SCORE_BLOCK_SIZE;
+		score_rows_quantized(quantized, query, query_codes, query_scale, start, count, distance);
+		for (int i = 0; i < count; i++) {
+			rows[i] = start + i;
+		}
+		push_block(&topk, distance, count, rows, NULL, bound);
+	}
+
+	TopK result;
+	topk_init(&result, out_scores, out_ids, k);
+	for (int c = 0; c < topk.size; c++) {
+		int64_t row = candidate_rows[c];
+		if (rerank_gallery != NULL) {
+			float exact;
+			score_kernel()(query, rerank_gallery->templates + (size_t)row * TEMPLATE_SIZE, 1, &exact);
+			if (exact <= threshold) topk_push(&result, exact, row);
+		}
+		else {
+			topk_push(&result, candidate_scores[c], row);
+		}
+	}
+	topk_sort(&result);
+	for (int r = 0; r < result.size; r++) {
+		out_ids[r] = quantized->ids[out_ids[r]];
+	}
+
+	free(candidate_scores);
+	free(candidate_rows);
+	STATS_STOP(STATS_IDENTIFY_QUANTIZED, timer, quantized->size);
+	return result.size;
+}
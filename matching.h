@@ -3,12 +3,53 @@
 
 #include <math.h>
 #include "config.h"
+#include "gallery.h"
 
 float cosine_similarity(const float* vector1, const float* vector2, int vector_length);
 float template_distance(const float* template1, const float* template2);
 
+// Rows scored per kernel call when only the best candidates are kept
+#define SCORE_BLOCK_SIZE 1024
+
+// Batch identification tiles: gallery rows packed per block (64 KB) and probes per tile
+#define BATCH_BLOCK_ROWS 256
+#define BATCH_QUERY_TILE 64
+
+// Quantized search over-fetches this many candidates per result for the fp32 rerank,
+// accepting approximate distances up to threshold + margin
+#define QUANTIZED_RERANK_FACTOR 4
+#define QUANTIZED_RERANK_MARGIN 0.05f
+
+// Bounded candidate list (max-heap on distance) over caller-provided storage
+typedef struct TopK {
+	float* scores;
+	int64_t* ids;
+	int size;
+	int k;
+} TopK;
+
+void topk_init(TopK* topk, float* scores, int64_t* ids, int k);
+void topk_push(TopK* topk, float score, int64_t id);
+void topk_merge(TopK* topk, const TopK* other);
+void topk_sort(TopK* topk);
+float topk_bound(const TopK* topk, float threshold);
+void score_rows_topk(const float* query, const Gallery* gallery, int begin, int end, float threshold, TopK* topk);
+
 // API function
 DllAPI int fingerprint_identification(float* query_template, float** template_db, int db_size, float* score);
 DllAPI float fingerprint_verification(const float* query_template, const float* verify_template);
+// Same distances as fingerprint_identification (1 - cosine), one per gallery row
+DllAPI int fingerprint_identification_gallery(const float* query_template, const Gallery* gallery, float* score);
+// Best k matches with distance <= threshold, best first; returns how many were found
+DllAPI int fingerprint_identify_topk(const float* query_template, const Gallery* gallery, int k, float threshold,
+	int64_t* out_ids, float* out_scores);
+// Top-k for num_queries contiguous probes in one cache-blocked pass over the gallery.
+// Probe q owns out_ids / out_scores [q * k, q * k + k) and out_counts[q] results
+DllAPI int fingerprint_identify_batch(const float* query_templates, int num_queries, const Gallery* gallery, int k, float threshold,
+	int64_t* out_ids, float* out_scores, int* out_counts);
+// Top-k over an int8 / fp16 gallery. A non-NULL rerank_gallery (the fp32 source of the
+// quantized copy) rescores the over-fetched candidates exactly; returns how many were found
+DllAPI int fingerprint_identify_topk_quantized(const float* query_template, const QuantizedGallery* quantized,
+	const Gallery* rerank_gallery, int k, float threshold, int64_t* out_ids, float* out_scores);
 
 #endif // MATCHING_H
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include "model_registry.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <wchar.h>
+#endif
+
+// Process-wide env, guarded by a spin lock
+static volatile int64_t env_lock;
+static OrtEnv* shared_env;
+static int env_refs;
+
+int acquire_ort_env(const OrtApi* g_ort, const ModelOptions* options, OrtEnv** out_env) {
+    if (g_ort == NULL || out_env == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    spin_lock(&env_lock);
+    if (shared_env == NULL && create_ort_env(g_ort, options, &shared_env) != 0) {
+        spin_unlock(&env_lock);
+        return -1;
+    }
+    env_refs++;
+    *out_env = shared_env;
+    spin_unlock(&env_lock);
+    return 0;
+}
+
+void release_ort_env(const OrtApi* g_ort) {
+    spin_lock(&env_lock);
+    if (env_refs > 0 && --env_refs == 0) {
+        g_ort->ReleaseEnv(shared_env);
+        shared_env = NULL;
+    }
+    spin_unlock(&env_lock);
+}
+
+#ifdef _WIN32
+static size_t path_length(const ORTCHAR_T* path) { return wcslen(path); }
+static int path_equal(const ORTCHAR_T* a, const ORTCHAR_T* b) { return wcscmp(a, b) == 0; }
+#define model_file_stamp file_stamp_wide
+#else
+static size_t path_length(const ORTCHAR_T* path) { return strlen(path); }
+static int path_equal(const ORTCHAR_T* a, const ORTCHAR_T* b) { return strcmp(a, b) == 0; }
+#define model_file_stamp file_stamp
+#endif
+
+// One session per model file version, shared by every entry loaded from it while the file is unchanged
+typedef struct SharedSession {
+    OrtSession* session;
+    ORTCHAR_T* model_path;
+    FileStamp stamp;  // The file as it was when the session was created
+    int shareable;    // Cleared when the file changed during the load
+    int refs;
+} SharedSession;
+
+struct ModelHandle {
+    char* name;
+    char* version;
+    SharedSession* shared;
+    int refs;     // One for the registry while registered, one per acquire
+    int current;  // Selected when no version is requested
+};
+
+struct ModelRegistry {
+    const OrtApi* g_ort;
+    OrtEnv* env;
+    ModelOptions options;
+    OrtPrepackedWeightsContainer* prepacked_weights;  // Owned when the caller did not supply one
+    platform_mutex mutex;
+
+    // Registered models in load order, and the sessions behind them
+    ModelHandle** models;
+    int num_models;
+    int models_capacity;
+    SharedSession** sessions;
+    int num_sessions;
+    int sessions_capacity;
+};
+
+static char* copy_string(const char* text) {
+    size_t length = strlen(text) + 1;
+    char* copy = (char*)malloc(length);
+    if (copy != NULL) memcpy(copy, text, length);
+    return copy;
+}
+
+static int grow_array(void*** array, int* capacity, int count) {
+    if (count < *capacity) return 0;
+
+    int new_capacity = *capacity > 0 ? *capacity * 2 : 8;
+    void** grown = (void**)realloc(*array, (size_t)new_capacity * sizeof(void*));
+    if (grown == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// Caller holds the registry mutex. A path alone is not enough: a model file replaced on disk
+// must get a session of its own, or the old graph (and its cached templates) would keep serving
+static SharedSession* find_session(ModelRegistry* registry, const ORTCHAR_T* model_path, const FileStamp* stamp) {
+    for (int i = 0; i < registry->num_sessions; i++) {
+        SharedSession* shared = registry->sessions[i];
+        if (shared->shareable && path_equal(shared->model_path, model_path) && file_stamp_equal(&shared->stamp, stamp)) {
+            return shared;
+        }
+    }
+    return NULL;
+}
+
+static int find_model(ModelRegistry* registry, const char* name, const char* version) {
+    for (int i = registry->num_models - 1; i >= 0; i--) {
+        ModelHandle* model = registry->models[i];
+        if (strcmp(model->name, name) != 0) continue;
+        if (version == NULL ? model->current : strcmp(model->version, version) == 0) return i;
+    }
+    return -1;
+}
+
+// Caller holds the registry mutex; the session goes with its last user
+static void release_session(ModelRegistry* registry, SharedSession* shared) {
+    if (--shared->refs > 0) return;
+
+    for (int i = 0; i < registry->num_sessions; i++) {
+        if (registry->sessions[i] == shared) {
+            registry->sessions[i] = registry->sessions[--registry->num_sessions];
+            break;
+        }
+    }
+    release_model_session(registry->g_ort, shared->session);
+    free(shared->model_path);
+    free(shared);
+}
+
+static void release_handle(ModelRegistry* registry, ModelHandle* handle) {
+    if (--handle->refs > 0) return;
+
+    if (handle->shared != NULL) release_session(registry, handle->shared);
+    free(handle->name);
+    free(handle->version);
+    free(handle);
+}
+
+// Takes a model out of the registry; in-flight holders keep it alive until they release it
+static void remove_model(ModelRegistry* registry, int index) {
+    ModelHandle* model = registry->models[index];
+    memmove(&registry->models[index], &registry->models[index + 1], (size_t)(registry->num_models - index - 1) * sizeof(ModelHandle*));
+    registry->num_models--;
+
+    // The most recently loaded remaining version of the name takes over
+    if (model->current) {
+        for (int i = registry->num_models - 1; i >= 0; i--) {
+            if (strcmp(registry->models[i]->name, model->name) == 0) {
+                registry->models[i]->current = 1;
+                break;
+            }
+        }
+    }
+    release_handle(registry, model);
+}
+
+int create_model_registry(const OrtApi* g_ort, const ModelOptions* options, ModelRegistry** out_registry) {
+    if (g_ort == NULL || out_registry == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    ModelRegistry* registry = (ModelRegistry*)calloc(1, sizeof(ModelRegistry));
+    if (registry == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    if (acquire_ort_env(g_ort, options, &registry->env) != 0) {
+        free(registry);
+        return -1;
+    }
+    registry->g_ort = g_ort;
+    if (options != NULL) registry->options = *options;
+    // The optimized-model cache is one file per model, so it cannot apply to every entry
+    registry->options.optimized_model_path = NULL;
+    mutex_init(&registry->mutex);
+
+    // Every model in the registry shares one set of prepacked weights
+    if (registry->options.prepacked_weights == NULL) {
+        OrtStatus* status = g_ort->CreatePrepackedWeightsContainer(&registry->prepacked_weights);
+        if (status != NULL) {
+            fprintf(stderr, "Error: %s\n", g_ort->GetErrorMessage(status));
+            g_ort->ReleaseStatus(status);
+            clean_model_registry(registry);
+            return -1;
+        }
+        registry->options.prepacked_weights = registry->prepacked_weights;
+    }
+
+    *out_registry = registry;
+    return 0;
+}
+
+// Finds or creates the session for the current contents of model_path, with one reference taken
+// for the caller. New sessions still share prepacked weights through the registry's container
+static SharedSession* acquire_session(ModelRegistry* registry, const ORTCHAR_T* model_path) {
+    FileStamp stamp;
+    if (model_file_stamp(model_path, &stamp) != 0) {
+        fprintf(stderr, "Error: Cannot open model file\n");
+        return NULL;
+    }
+
+    mutex_lock(&registry->mutex);
+    SharedSession* shared = find_session(registry, model_path, &stamp);
+    if (shared != NULL) shared->refs++;
+    mutex_unlock(&registry->mutex);
+    if (shared != NULL) return shared;
+
+    // Load outside the lock so requests keep flowing while the graph is optimized
+    OrtSession* session = NULL;
+    if (create_model_session(registry->g_ort, registry->env, model_path, &registry->options, &session) != 0) {
+        return NULL;
+    }
+
+    // The stamp taken before the load only describes the session if the file did not change meanwhile
+    FileStamp loaded;
+    int shareable = model_file_stamp(model_path, &loaded) == 0 && file_stamp_equal(&stamp, &loaded);
+
+    mutex_lock(&registry->mutex);
+    shared = shareable ? find_session(registry, model_path, &stamp) : NULL;
+    if (shared != NULL) {
+        // Another thread loaded the same file meanwhile: keep one copy
+        shared->refs++;
+        mutex_unlock(&registry->mutex);
+        release_model_session(registry->g_ort, session);
+        return shared;
+    }
+
+    size_t path_size = (path_length(model_path) + 1) * sizeof(ORTCHAR_T);
+    shared = (SharedSession*)calloc(1, sizeof(SharedSession));
+    ORTCHAR_T* path = (ORTCHAR_T*)malloc(path_size);
+    if (shared == NULL || path == NULL ||
+        grow_array((void***)&registry->sessions, &registry->sessions_capacity, registry->num_sessions) != 0) {
+        mutex_unlock(&registry->mutex);
+        if (shared == NULL || path == NULL) fprintf(stderr, "Error: Memory allocation failed\n");
+        free(shared);
+        free(path);
+        release_model_session(registry->g_ort, session);
+        return NULL;
+    }
+    memcpy(path, model_path, path_size);
+    shared->session = session;
+    shared->model_path = path;
+    shared->stamp = stamp;
+    shared->shareable = shareable;
+    shared->refs = 1;
+    registry->sessions[registry->num_sessions++] = shared;
+    mutex_unlock(&registry->mutex);
+    return shared;
+}
+
+int registry_load(ModelRegistry* registry, const char* name, const char* version, const ORTCHAR_T* model_path) {
+    if (registry == NULL || name == NULL || version == NULL || model_path == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    ModelHandle* handle = (ModelHandle*)calloc(1, sizeof(ModelHandle));
+    if (handle == NULL || (handle->name = copy_string(name)) == NULL || (handle->version = copy_string(version)) == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        if (handle != NULL) {
+            free(handle->name);
+            free(handle);
+        }
+        return -1;
+    }
+    handle->refs = 1;
+    handle->current = 1;
+
+    handle->shared = acquire_session(registry, model_path);
+    if (handle->shared == NULL) {
+        free(handle->name);
+        free(handle->version);
+        free(handle);
+        return -1;
+    }
+
+    // Swap in under the lock: new acquires see the new model, in-flight ones finish on the old
+    mutex_lock(&registry->mutex);
+    if (grow_array((void***)&registry->models, &registry->models_capacity, registry->num_models) != 0) {
+        release_handle(registry, handle);
+        mutex_unlock(&registry->mutex);
+        return -1;
+    }
+    int existing = find_model(registry, name, version);
+    if (existing >= 0) {
+        remove_model(registry, existing);
+    }
+    for (int i = 0; i < registry->num_models; i++) {
+        if (strcmp(registry->models[i]->name, name) == 0) registry->models[i]->current = 0;
+    }
+    registry->models[registry->num_models++] = handle;
+    mutex_unlock(&registry->mutex);
+    return 0;
+}
+
+ModelHandle* registry_acquire(ModelRegistry* registry, const char* name, const char* version) {
+    if (registry == NULL || name == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return NULL;
+    }
+
+    mutex_lock(&registry->mutex);
+    int index = find_model(registry, name, version);
+    ModelHandle* handle = index >= 0 ? registry->models[index] : NULL;
+    if (handle != NULL) handle->refs++;
+    mutex_unlock(&registry->mutex);
+    return handle;
+}
+
+void registry_release(ModelRegistry* registry, ModelHandle* handle) {
+    if (registry == NULL || handle == NULL) return;
+
+    mutex_lock(&registry->mutex);
+    release_handle(registry, handle);
+    mutex_unlock(&registry->mutex);
+}
+
+int registry_unload(ModelRegistry* registry, const char* name, const char* version) {
+    if (registry == NULL || name == NULL || version == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    mutex_lock(&registry->mutex);
+    int index = find_model(registry, name, version);
+    if (index >= 0) {
+        remove_model(registry, index);
+    }
+    mutex_unlock(&registry->mutex);
+    return index >= 0 ? 0 : -1;
+}
+
+OrtEnv* registry_env(const ModelRegistry* registry) {
+    return registry != NULL ? registry->env : NULL;
+}
+
+OrtSession* model_handle_session(const ModelHandle* handle) {
+    return handle != NULL ? handle->shared->session : NULL;
+}
+
+const char* model_handle_version(const ModelHandle* handle) {
+    return handle != NULL ? handle->version : NULL;
+}
+
+// Every acquired handle must have been released
+void clean_model_registry(ModelRegistry* registry) {
+    if (registry == NULL) return;
+
+    mutex_lock(&registry->mutex);
+    while (registry->num_models > 0) {
+        remove_model(registry, registry->num_models - 1);
+    }
+    mutex_unlock(&registry->mutex);
+
+    if (registry->prepacked_weights != NULL) {
+        registry->g_ort->ReleasePrepackedWeightsContainer(registry->prepacked_weights);
+    }
+    free(registry->models);
+    free(registry->sessions);
+    mutex_destroy(&registry->mutex);
+    release_ort_env(registry->g_ort);
+    free(registry);
+}
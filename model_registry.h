@@ -0,0 +1,40 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include "config.h"
+#include "template.h"
+
+// Process-wide OrtEnv shared by every registry (and any caller that wants it). The first
+// acquire creates it with the given options, later ones just take a reference; the env
+// and its thread pools are released with the last reference.
+DllAPI int acquire_ort_env(const OrtApi* g_ort, const ModelOptions* options, OrtEnv** out_env);
+DllAPI void release_ort_env(const OrtApi* g_ort);
+
+// Models loaded side by side on the shared env, keyed by name and version (A/B versions,
+// auxiliary quality models). Loading a name again makes the new version current without
+// disturbing requests still holding the old one: a model is freed when it is unloaded or
+// replaced and its last handle is released. Entries loaded from the same unchanged file (same
+// path, file id, size and modification time) share one session; a file rewritten or replaced
+// on disk gets a new session when it is next loaded. All sessions of a registry share their
+// prepacked weights.
+typedef struct ModelRegistry ModelRegistry;
+typedef struct ModelHandle ModelHandle;
+
+// API function
+// options is copied (without optimized_model_path, which is per model), but its strings must stay
+// valid while the registry loads models.
+// Without a prepacked_weights container the registry creates one for all of its sessions
+DllAPI int create_model_registry(const OrtApi* g_ort, const ModelOptions* options, ModelRegistry** out_registry);
+// Loads (or reloads) name/version and makes it the current version of name
+DllAPI int registry_load(ModelRegistry* registry, const char* name, const char* version, const ORTCHAR_T* model_path);
+// version NULL selects the current version; returns NULL if nothing matches.
+// Every acquired handle must be released
+DllAPI ModelHandle* registry_acquire(ModelRegistry* registry, const char* name, const char* version);
+DllAPI void registry_release(ModelRegistry* registry, ModelHandle* handle);
+DllAPI int registry_unload(ModelRegistry* registry, const char* name, const char* version);
+DllAPI OrtEnv* registry_env(const ModelRegistry* registry);
+DllAPI OrtSession* model_handle_session(const ModelHandle* handle);
+DllAPI const char* model_handle_version(const ModelHandle* handle);
+DllAPI void clean_model_registry(ModelRegistry* registry);
+
+#endif // MODEL_REGISTRY_H
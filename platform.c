@@ -0,0 +1,299 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#elif !defined(_WIN32)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "platform.h"
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+void* aligned_malloc(size_t size, size_t alignment) {
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0) return NULL;
+    return ptr;
+#endif
+}
+
+void aligned_free(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+#ifdef _WIN32
+
+void mutex_init(platform_mutex* mutex) { InitializeCriticalSection(mutex); }
+void mutex_lock(platform_mutex* mutex) { EnterCriticalSection(mutex); }
+void mutex_unlock(platform_mutex* mutex) { LeaveCriticalSection(mutex); }
+void mutex_destroy(platform_mutex* mutex) { DeleteCriticalSection(mutex); }
+
+void cond_init(platform_cond* cond) { InitializeConditionVariable(cond); }
+void cond_wait(platform_cond* cond, platform_mutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+void cond_signal(platform_cond* cond) { WakeConditionVariable(cond); }
+void cond_broadcast(platform_cond* cond) { WakeAllConditionVariable(cond); }
+void cond_destroy(platform_cond* cond) { (void)cond; }
+
+#else
+
+void mutex_init(platform_mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+void mutex_lock(platform_mutex* mutex) { pthread_mutex_lock(mutex); }
+void mutex_unlock(platform_mutex* mutex) { pthread_mutex_unlock(mutex); }
+void mutex_destroy(platform_mutex* mutex) { pthread_mutex_destroy(mutex); }
+
+void cond_init(platform_cond* cond) { pthread_cond_init(cond, NULL); }
+void cond_wait(platform_cond* cond, platform_mutex* mutex) { pthread_cond_wait(cond, mutex); }
+void cond_signal(platform_cond* cond) { pthread_cond_signal(cond); }
+void cond_broadcast(platform_cond* cond) { pthread_cond_broadcast(cond); }
+void cond_destroy(platform_cond* cond) { pthread_cond_destroy(cond); }
+
+#endif
+
+// Win32 and pthreads disagree on the entry point signature
+typedef struct ThreadStart {
+    platform_thread_fn fn;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID param) {
+#else
+static void* thread_entry(void* param) {
+#endif
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+int thread_create(platform_thread* thread, platform_thread_fn fn, void* arg) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (start == NULL) return -1;
+    start->fn = fn;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return -1;
+    }
+#else
+    if (pthread_create(thread, NULL, thread_entry, start) != 0) {
+        free(start);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+void thread_join(platform_thread thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+int exit_key_create(platform_exit_key* key, platform_exit_fn destructor) {
+#ifdef _WIN32
+    *key = FlsAlloc(destructor);
+    return *key != FLS_OUT_OF_INDEXES ? 0 : -1;
+#else
+    return pthread_key_create(key, destructor) == 0 ? 0 : -1;
+#endif
+}
+
+int exit_key_set(platform_exit_key key, void* value) {
+#ifdef _WIN32
+    return FlsSetValue(key, value) ? 0 : -1;
+#else
+    return pthread_setspecific(key, value) == 0 ? 0 : -1;
+#endif
+}
+
+int cpu_count(void) {
+#ifdef _WIN32
+    DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    return count > 0 ? (int)count : 1;
+#elif defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return CPU_COUNT(&set);
+    return 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+int process_id(void) {
+#ifdef _WIN32
+    return (int)GetCurrentProcessId();
+#else
+    return (int)getpid();
+#endif
+}
+
+int pin_current_thread(int cpu) {
+#ifdef _WIN32
+    // Processor groups beyond the first 64 CPUs are left to the scheduler
+    if (cpu >= 64) return -1;
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0 ? 0 : -1;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : -1;
+#else
+    (void)cpu;
+    return -1;
+#endif
+}
+
+#ifdef _WIN32
+static int map_file_handle(HANDLE file, MappedFile* out_file) {
+    out_file->data = NULL;
+    out_file->size = 0;
+    out_file->file = file;
+    if (out_file->file == INVALID_HANDLE_VALUE) return -1;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(out_file->file, &size) || size.QuadPart == 0) {
+        CloseHandle(out_file->file);
+        return -1;
+    }
+    out_file->mapping = CreateFileMappingA(out_file->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (out_file->mapping == NULL) {
+        CloseHandle(out_file->file);
+        return -1;
+    }
+    out_file->data = MapViewOfFile(out_file->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (out_file->data == NULL) {
+        CloseHandle(out_file->mapping);
+        CloseHandle(out_file->file);
+        return -1;
+    }
+    out_file->size = (size_t)size.QuadPart;
+    return 0;
+}
+
+int map_file_wide(const wchar_t* filename, MappedFile* out_file) {
+    return map_file_handle(CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL), out_file);
+}
+#endif
+
+int map_file(const char* filename, MappedFile* out_file) {
+    out_file->data = NULL;
+    out_file->size = 0;
+#ifdef _WIN32
+    return map_file_handle(CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL), out_file);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    out_file->data = data;
+    out_file->size = (size_t)st.st_size;
+#endif
+    return 0;
+}
+
+void unmap_file(MappedFile* file) {
+    if (file == NULL || file->data == NULL) return;
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+    CloseHandle(file->mapping);
+    CloseHandle(file->file);
+#else
+    munmap((void*)file->data, file->size);
+#endif
+    file->data = NULL;
+    file->size = 0;
+}
+
+#ifdef _WIN32
+static int file_stamp_handle(HANDLE file, FileStamp* out_stamp) {
+    if (file == INVALID_HANDLE_VALUE) return -1;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    BOOL ok = GetFileInformationByHandle(file, &info);
+    CloseHandle(file);
+    if (!ok) return -1;
+
+    out_stamp->device = info.dwVolumeSerialNumber;
+    out_stamp->inode = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+    out_stamp->size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+    // FILETIME counts 100 ns ticks
+    out_stamp->mtime_ns = (((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime) * 100;
+    return 0;
+}
+
+int file_stamp_wide(const wchar_t* filename, FileStamp* out_stamp) {
+    return file_stamp_handle(CreateFileW(filename, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL), out_stamp);
+}
+#endif
+
+int file_stamp(const char* filename, FileStamp* out_stamp) {
+#ifdef _WIN32
+    return file_stamp_handle(CreateFileA(filename, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL), out_stamp);
+#else
+    struct stat st;
+    if (stat(filename, &st) != 0) return -1;
+
+    out_stamp->device = (uint64_t)st.st_dev;
+    out_stamp->inode = (uint64_t)st.st_ino;
+    out_stamp->size = (uint64_t)st.st_size;
+#if defined(__APPLE__)
+    out_stamp->mtime_ns = (uint64_t)st.st_mtimespec.tv_sec * 1000000000ull + (uint64_t)st.st_mtimespec.tv_nsec;
+#else
+    out_stamp->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+    return 0;
+#endif
+}
+
+int file_stamp_equal(const FileStamp* a, const FileStamp* b) {
+    return a->device == b->device && a->inode == b->inode && a->size == b->size && a->mtime_ns == b->mtime_ns;
+}
+
+uint64_t monotonic_ns(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+        (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
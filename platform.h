@@ -0,0 +1,153 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Cache-line / AVX-512 friendly alignment for template blocks
+#define MEMORY_ALIGNMENT 64
+
+void* aligned_malloc(size_t size, size_t alignment);
+void aligned_free(void* ptr);
+
+// Thin mutex / condition variable / thread wrappers over Win32 and pthreads
+#ifdef _WIN32
+typedef CRITICAL_SECTION platform_mutex;
+typedef CONDITION_VARIABLE platform_cond;
+typedef HANDLE platform_thread;
+#else
+typedef pthread_mutex_t platform_mutex;
+typedef pthread_cond_t platform_cond;
+typedef pthread_t platform_thread;
+#endif
+
+typedef void (*platform_thread_fn)(void* arg);
+
+void mutex_init(platform_mutex* mutex);
+void mutex_lock(platform_mutex* mutex);
+void mutex_unlock(platform_mutex* mutex);
+void mutex_destroy(platform_mutex* mutex);
+
+void cond_init(platform_cond* cond);
+void cond_wait(platform_cond* cond, platform_mutex* mutex);
+void cond_signal(platform_cond* cond);
+void cond_broadcast(platform_cond* cond);
+void cond_destroy(platform_cond* cond);
+
+int thread_create(platform_thread* thread, platform_thread_fn fn, void* arg);
+void thread_join(platform_thread thread);
+
+// Per-thread slot whose non-NULL value is handed to the destructor on the exiting thread
+// (fiber-local storage on Win32, pthread key otherwise)
+#ifdef _WIN32
+typedef DWORD platform_exit_key;
+#define THREAD_EXIT_CALLBACK NTAPI
+#else
+typedef pthread_key_t platform_exit_key;
+#define THREAD_EXIT_CALLBACK
+#endif
+
+typedef void (THREAD_EXIT_CALLBACK* platform_exit_fn)(void* value);
+
+int exit_key_create(platform_exit_key* key, platform_exit_fn destructor);
+int exit_key_set(platform_exit_key key, void* value);
+
+// Thread-local storage class
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Sequentially consistent atomics on 64-bit counters and pointers
+#ifdef _WIN32
+static __inline int64_t atomic_load_64(volatile int64_t* ptr) { return InterlockedOr64((volatile LONG64*)ptr, 0); }
+static __inline void atomic_store_64(volatile int64_t* ptr, int64_t value) { InterlockedExchange64((volatile LONG64*)ptr, value); }
+static __inline int64_t atomic_fetch_add_64(volatile int64_t* ptr, int64_t value) { return InterlockedExchangeAdd64((volatile LONG64*)ptr, value); }
+static __inline int atomic_cas_64(volatile int64_t* ptr, int64_t expected, int64_t desired) {
+    return InterlockedCompareExchange64((volatile LONG64*)ptr, desired, expected) == expected;
+}
+static __inline void* atomic_load_ptr(void* volatile* ptr) { return InterlockedCompareExchangePointer(ptr, NULL, NULL); }
+static __inline void atomic_store_ptr(void* volatile* ptr, void* value) { InterlockedExchangePointer(ptr, value); }
+static __inline void thread_yield(void) { SwitchToThread(); }
+// Relaxed flag bytes: written by one thread, polled by others without ordering
+static __inline uint8_t atomic_load_flag(const volatile uint8_t* ptr) { return *ptr; }
+static __inline void atomic_store_flag(volatile uint8_t* ptr, uint8_t value) { *ptr = value; }
+// Relaxed 64-bit counters with a single writer (aligned 64-bit accesses are atomic on x64 / ARM64)
+static __inline uint64_t atomic_load_counter(const volatile uint64_t* ptr) { return *ptr; }
+static __inline void atomic_store_counter(volatile uint64_t* ptr, uint64_t value) { *ptr = value; }
+// Spin lock for rarely contended process-wide state that has no initializer to run
+static __inline void spin_lock(volatile int64_t* lock) { while (!atomic_cas_64(lock, 0, 1)) thread_yield(); }
+static __inline void spin_unlock(volatile int64_t* lock) { atomic_store_64(lock, 0); }
+#else
+static inline int64_t atomic_load_64(volatile int64_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+static inline void atomic_store_64(volatile int64_t* ptr, int64_t value) { __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST); }
+static inline int64_t atomic_fetch_add_64(volatile int64_t* ptr, int64_t value) { return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST); }
+static inline int atomic_cas_64(volatile int64_t* ptr, int64_t expected, int64_t desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline void* atomic_load_ptr(void* volatile* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+static inline void atomic_store_ptr(void* volatile* ptr, void* value) { __atomic_store_n(ptr, value, __ATOMIC_SEQ_CST); }
+static inline void thread_yield(void) { sched_yield(); }
+// Relaxed flag bytes: written by one thread, polled by others without ordering
+static inline uint8_t atomic_load_flag(const volatile uint8_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_RELAXED); }
+static inline void atomic_store_flag(volatile uint8_t* ptr, uint8_t value) { __atomic_store_n(ptr, value, __ATOMIC_RELAXED); }
+// Relaxed 64-bit counters with a single writer
+static inline uint64_t atomic_load_counter(const volatile uint64_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_RELAXED); }
+static inline void atomic_store_counter(volatile uint64_t* ptr, uint64_t value) { __atomic_store_n(ptr, value, __ATOMIC_RELAXED); }
+// Spin lock for rarely contended process-wide state that has no initializer to run
+static inline void spin_lock(volatile int64_t* lock) { while (!atomic_cas_64(lock, 0, 1)) thread_yield(); }
+static inline void spin_unlock(volatile int64_t* lock) { atomic_store_64(lock, 0); }
+#endif
+
+// Read-only shared file mapping; pages come from the page cache and are shared between processes
+typedef struct MappedFile {
+    const void* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} MappedFile;
+
+int map_file(const char* filename, MappedFile* out_file);
+#ifdef _WIN32
+int map_file_wide(const wchar_t* filename, MappedFile* out_file);
+#endif
+void unmap_file(MappedFile* file);
+
+// Identity of a file's current contents: replacing or rewriting the file changes the stamp
+typedef struct FileStamp {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtime_ns;
+} FileStamp;
+
+int file_stamp(const char* filename, FileStamp* out_stamp);
+#ifdef _WIN32
+int file_stamp_wide(const wchar_t* filename, FileStamp* out_stamp);
+#endif
+int file_stamp_equal(const FileStamp* a, const FileStamp* b);
+
+// Monotonic clock in nanoseconds, for timing only
+uint64_t monotonic_ns(void);
+
+// Number of logical processors available to the process
+int cpu_count(void);
+// Id of the calling process, for naming per-process temporary files
+int process_id(void);
+// Pins the calling thread to one logical processor; returns -1 where unsupported
+int pin_current_thread(int cpu);
+
+#endif // PLATFORM_H
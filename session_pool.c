@@ -0,0 +1,119 @@
+#include "session_pool.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SESSION_POOL_DEFAULT_CONCURRENCY 2
+
+struct SessionPool {
+    const OrtApi* g_ort;
+    OrtEnv* env;
+    OrtSession* session;
+
+    // Free-list of contexts, guarded by mutex
+    FingerprintContext** contexts;
+    FingerprintContext** free_contexts;
+    int num_contexts;
+    int num_free;
+    platform_mutex mutex;
+    platform_cond available;
+};
+
+int create_session_pool(const OrtApi* g_ort, const ORTCHAR_T* model_path, const ModelOptions* options,
+    int max_concurrency, SessionPool** out_pool) {
+    if (g_ort == NULL || model_path == NULL || out_pool == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    if (max_concurrency <= 0) max_concurrency = SESSION_POOL_DEFAULT_CONCURRENCY;
+
+    SessionPool* pool = (SessionPool*)calloc(1, sizeof(SessionPool));
+    if (pool == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    pool->g_ort = g_ort;
+    mutex_init(&pool->mutex);
+    cond_init(&pool->available);
+
+    pool->contexts = (FingerprintContext**)calloc(max_concurrency, sizeof(FingerprintContext*));
+    pool->free_contexts = (FingerprintContext**)calloc(max_concurrency, sizeof(FingerprintContext*));
+    if (pool->contexts == NULL || pool->free_contexts == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        clean_session_pool(pool);
+        return -1;
+    }
+
+    if (load_model_with_options(g_ort, model_path, options, &pool->env, &pool->session) != 0) {
+        clean_session_pool(pool);
+        return -1;
+    }
+
+    // Single-image contexts: concurrent requests are the unit of parallelism here
+    for (int i = 0; i < max_concurrency; i++) {
+        if (create_context(g_ort, pool->session, 1, &pool->contexts[i]) != 0) {
+            clean_session_pool(pool);
+            return -1;
+        }
+        pool->num_contexts++;
+        pool->free_contexts[pool->num_free++] = pool->contexts[i];
+    }
+
+    *out_pool = pool;
+    return 0;
+}
+
+FingerprintContext* session_pool_acquire(SessionPool* pool) {
+    if (pool == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return NULL;
+    }
+
+    mutex_lock(&pool->mutex);
+    while (pool->num_free == 0) {
+        cond_wait(&pool->available, &pool->mutex);
+    }
+    FingerprintContext* ctx = pool->free_contexts[--pool->num_free];
+    mutex_unlock(&pool->mutex);
+    return ctx;
+}
+
+void session_pool_release(SessionPool* pool, FingerprintContext* ctx) {
+    if (pool == NULL || ctx == NULL) return;
+
+    mutex_lock(&pool->mutex);
+    pool->free_contexts[pool->num_free++] = ctx;
+    cond_signal(&pool->available);
+    mutex_unlock(&pool->mutex);
+}
+
+int session_pool_generate_template(SessionPool* pool, const char* image_filename, float* output_template) {
+    if (pool == NULL || image_filename == NULL || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    FingerprintContext* ctx = session_pool_acquire(pool);
+    int result = generate_template_with_context(ctx, image_filename, output_template);
+    session_pool_release(pool, ctx);
+    return result;
+}
+
+// Every acquired context must have been released
+void clean_session_pool(SessionPool* pool) {
+    if (pool == NULL) return;
+
+    if (pool->contexts != NULL) {
+        for (int i = 0; i < pool->num_contexts; i++) {
+            clean_context(pool->contexts[i]);
+        }
+    }
+    if (pool->session != NULL) {
+        clean_model(pool->g_ort, pool->env, pool->session);
+    }
+    free(pool->contexts);
+    free(pool->free_contexts);
+    mutex_destroy(&pool->mutex);
+    cond_destroy(&pool->available);
+    free(pool);
+}
@@ -0,0 +1,23 @@
+#ifndef SESSION_POOL_H
+#define SESSION_POOL_H
+
+#include "config.h"
+#include "template.h"
+
+// One model session shared by concurrent request threads. ORT Run is thread-safe, so the
+// pool hands out inference contexts (pre-bound input/output tensors) rather than
+// sessions; at most max_concurrency requests run at once and the rest wait for a free
+// context, which keeps request threads from oversubscribing the ORT thread pools.
+typedef struct SessionPool SessionPool;
+
+// API function
+// options configures the ORT threading (NULL: defaults); max_concurrency <= 0 allows two runs at once
+DllAPI int create_session_pool(const OrtApi* g_ort, const ORTCHAR_T* model_path, const ModelOptions* options,
+    int max_concurrency, SessionPool** out_pool);
+// Blocks until a context is free; pass it to any *_with_context call, then release it
+DllAPI FingerprintContext* session_pool_acquire(SessionPool* pool);
+DllAPI void session_pool_release(SessionPool* pool, FingerprintContext* ctx);
+DllAPI int session_pool_generate_template(SessionPool* pool, const char* image_filename, float* output_template);
+DllAPI void clean_session_pool(SessionPool* pool);
+
+#endif // SESSION_POOL_H
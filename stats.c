@@ -0,0 +1,252 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+static const char* stage_names[STATS_STAGE_COUNT] = {
+    "read_bmp_image",
+    "decode_bmp",
+    "apply_box_filter",
+    "gaussian_blur",
+    "resize_image",
+    "normalize_image",
+    "reshape_image",
+    "preprocess_image",
+    "preprocess_image_fused",
+    "inference",
+    "generate_template",
+    "generate_templates_batch",
+    "fingerprint_identification",
+    "fingerprint_identification_gallery",
+    "fingerprint_identify_topk",
+    "fingerprint_identify_batch",
+    "fingerprint_identify_topk_quantized",
+};
+
+static void init_stats(FingerprintStats* stats) {
+    memset(stats, 0, sizeof(FingerprintStats));
+    for (int s = 0; s < STATS_STAGE_COUNT; s++) {
+        stats->stages[s].name = stage_names[s];
+    }
+}
+
+#ifdef FINGERPRINT_STATS
+
+// One block per thread that has recorded anything. Only the owning thread writes it (relaxed
+// stores, no locked instructions); readers sum every block of the current generation. A reset
+// bumps the generation, and each owner zeroes its block on its next record. When a thread exits,
+// its block is folded into retired_stats and freed, so finished workers stay in the totals.
+typedef struct ThreadStats {
+    volatile uint64_t count[STATS_STAGE_COUNT];
+    volatile uint64_t items[STATS_STAGE_COUNT];
+    volatile uint64_t total_ns[STATS_STAGE_COUNT];
+    volatile uint64_t max_ns[STATS_STAGE_COUNT];
+    volatile uint64_t histogram[STATS_STAGE_COUNT][STATS_BUCKETS];
+    volatile int64_t generation;
+    struct ThreadStats* next;
+} ThreadStats;
+
+static THREAD_LOCAL ThreadStats* thread_stats = NULL;
+static ThreadStats* stats_threads = NULL;  // Guarded by stats_lock
+static ThreadStats retired_stats;          // Exited threads of retired_stats.generation; guarded by stats_lock
+static platform_exit_key stats_exit_key;
+static int stats_exit_key_state = 0;       // 0 not created, 1 ready, -1 failed; guarded by stats_lock
+static volatile int64_t stats_lock = 0;
+static volatile int64_t stats_generation = 1;
+static volatile int64_t stats_epoch_ns = 0;  // Start of the current window; 0 until the first record
+
+static void restart_block(ThreadStats* block, int64_t generation);
+static void THREAD_EXIT_CALLBACK retire_thread(void* value);
+
+static ThreadStats* register_thread(void) {
+    ThreadStats* block = (ThreadStats*)calloc(1, sizeof(ThreadStats));
+    if (block == NULL) return NULL;
+    block->generation = atomic_load_64(&stats_generation);
+
+    spin_lock(&stats_lock);
+    if (stats_exit_key_state == 0) {
+        stats_exit_key_state = exit_key_create(&stats_exit_key, retire_thread) == 0 ? 1 : -1;
+    }
+    int retire_on_exit = stats_exit_key_state == 1;
+    block->next = stats_threads;
+    stats_threads = block;
+    spin_unlock(&stats_lock);
+
+    // Without an exit key the block simply stays linked, as it did before recycling
+    if (retire_on_exit) exit_key_set(stats_exit_key, block);
+    thread_stats = block;
+    return block;
+}
+
+// Adds one block's counters into another; both must be stable (caller holds stats_lock and
+// the source's owner is not recording)
+static void fold_block(ThreadStats* into, ThreadStats* block) {
+    for (int s = 0; s < STATS_STAGE_COUNT; s++) {
+        into->count[s] += block->count[s];
+        into->items[s] += block->items[s];
+        into->total_ns[s] += block->total_ns[s];
+        if (block->max_ns[s] > into->max_ns[s]) into->max_ns[s] = block->max_ns[s];
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            into->histogram[s][b] += block->histogram[s][b];
+        }
+    }
+}
+
+// Runs on the exiting thread: keeps its counts in retired_stats and releases the block
+static void THREAD_EXIT_CALLBACK retire_thread(void* value) {
+    ThreadStats* block = (ThreadStats*)value;
+    thread_stats = NULL;
+
+    spin_lock(&stats_lock);
+    ThreadStats** link = &stats_threads;
+    while (*link != block) link = &(*link)->next;
+    *link = block->next;
+
+    int64_t generation = atomic_load_64(&stats_generation);
+    if (block->generation == generation) {
+        if (retired_stats.generation != generation) restart_block(&retired_stats, generation);
+        fold_block(&retired_stats, block);
+    }
+    spin_unlock(&stats_lock);
+
+    free(block);
+}
+
+// Owner-side restart after fingerprint_reset_stats; the new generation is published last
+static void restart_block(ThreadStats* block, int64_t generation) {
+    for (int s = 0; s < STATS_STAGE_COUNT; s++) {
+        atomic_store_counter(&block->count[s], 0);
+        atomic_store_counter(&block->items[s], 0);
+        atomic_store_counter(&block->total_ns[s], 0);
+        atomic_store_counter(&block->max_ns[s], 0);
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            atomic_store_counter(&block->histogram[s][b], 0);
+        }
+    }
+    atomic_store_64(&block->generation, generation);
+}
+
+static int bucket_of(uint64_t elapsed_ns) {
+    if (elapsed_ns == 0) return 0;
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanReverse64(&bit, elapsed_ns);
+    int bucket = (int)bit;
+#else
+    int bucket = 63 - __builtin_clzll(elapsed_ns);
+#endif
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+static void counter_add(volatile uint64_t* counter, uint64_t value) {
+    atomic_store_counter(counter, atomic_load_counter(counter) + value);
+}
+
+void stats_record(StatsStage stage, uint64_t elapsed_ns, uint64_t items) {
+    ThreadStats* block = thread_stats;
+    if (block == NULL && (block = register_thread()) == NULL) return;
+
+    int64_t generation = atomic_load_64(&stats_generation);
+    if (block->generation != generation) {
+        restart_block(block, generation);
+    }
+    if (atomic_load_64(&stats_epoch_ns) == 0) {
+        atomic_cas_64(&stats_epoch_ns, 0, (int64_t)monotonic_ns());
+    }
+
+    counter_add(&block->count[stage], 1);
+    counter_add(&block->items[stage], items);
+    counter_add(&block->total_ns[stage], elapsed_ns);
+    if (elapsed_ns > atomic_load_counter(&block->max_ns[stage])) {
+        atomic_store_counter(&block->max_ns[stage], elapsed_ns);
+    }
+    counter_add(&block->histogram[stage][bucket_of(elapsed_ns)], 1);
+}
+
+static void add_block(FingerprintStats* out_stats, ThreadStats* block) {
+    for (int s = 0; s < STATS_STAGE_COUNT; s++) {
+        StageStats* stage = &out_stats->stages[s];
+        stage->count += atomic_load_counter(&block->count[s]);
+        stage->items += atomic_load_counter(&block->items[s]);
+        stage->total_ns += atomic_load_counter(&block->total_ns[s]);
+        uint64_t max_ns = atomic_load_counter(&block->max_ns[s]);
+        if (max_ns > stage->max_ns) stage->max_ns = max_ns;
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            stage->histogram[b] += atomic_load_counter(&block->histogram[s][b]);
+        }
+    }
+}
+
+int fingerprint_get_stats(FingerprintStats* out_stats) {
+    if (out_stats == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    init_stats(out_stats);
+    out_stats->enabled = 1;
+
+    spin_lock(&stats_lock);
+    int64_t generation = atomic_load_64(&stats_generation);
+    for (ThreadStats* block = stats_threads; block != NULL; block = block->next) {
+        if (atomic_load_64(&block->generation) == generation) add_block(out_stats, block);
+    }
+    if (retired_stats.generation == generation) add_block(out_stats, &retired_stats);
+    spin_unlock(&stats_lock);
+
+    int64_t epoch = atomic_load_64(&stats_epoch_ns);
+    if (epoch != 0) {
+        out_stats->elapsed_seconds = (double)(monotonic_ns() - (uint64_t)epoch) * 1e-9;
+    }
+    out_stats->templates = out_stats->stages[STATS_INFERENCE].items;
+    if (out_stats->elapsed_seconds > 0.0) {
+        out_stats->templates_per_second = out_stats->templates / out_stats->elapsed_seconds;
+    }
+    return 0;
+}
+
+void fingerprint_reset_stats(void) {
+    spin_lock(&stats_lock);
+    atomic_fetch_add_64(&stats_generation, 1);
+    atomic_store_64(&stats_epoch_ns, 0);
+    spin_unlock(&stats_lock);
+}
+
+#else
+
+void stats_record(StatsStage stage, uint64_t elapsed_ns, uint64_t items) {
+}
+
+int fingerprint_get_stats(FingerprintStats* out_stats) {
+    if (out_stats == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    init_stats(out_stats);
+    return 0;
+}
+
+void fingerprint_reset_stats(void) {
+}
+
+#endif // FINGERPRINT_STATS
+
+uint64_t fingerprint_stats_quantile_ns(const StageStats* stage, double q) {
+    if (stage == NULL || stage->count == 0) return 0;
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+
+    uint64_t rank = (uint64_t)ceil(q * (double)stage->count);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += stage->histogram[b];
+        if (seen >= rank) {
+            // No call was slower than max_ns, which tightens the top buckets
+            if (b == STATS_BUCKETS - 1) return stage->max_ns;
+            uint64_t upper = (uint64_t)1 << (b + 1);
+            return upper < stage->max_ns ? upper : stage->max_ns;
+        }
+    }
+    return stage->max_ns;
+}
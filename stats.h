@@ -0,0 +1,73 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "platform.h"
+
+// Hot-path instrumentation, compiled in with FINGERPRINT_STATS (CMake option of the same name).
+// Every thread records into its own counters and log2 latency histograms, so timing a call costs
+// two clock reads and a few uncontended stores; fingerprint_get_stats sums the threads. Without
+// the flag the STATS_* macros expand to nothing and fingerprint_get_stats reports enabled = 0.
+// Only successful calls are recorded. cosine_similarity and fingerprint_verification are shorter
+// than the clock reads and are not timed.
+typedef enum StatsStage {
+    STATS_READ_BMP,            // read_bmp_image / read_bmp_image_gray: map, decode and copy
+    STATS_DECODE_BMP,          // decode_bmp header and bounds validation
+    STATS_BOX_FILTER,
+    STATS_GAUSSIAN_BLUR,
+    STATS_RESIZE,
+    STATS_NORMALIZE,
+    STATS_RESHAPE,
+    STATS_PREPROCESS,          // preprocess_image
+    STATS_PREPROCESS_FUSED,    // preprocess_image_fused, taken by every generate_template* path
+    STATS_INFERENCE,           // ORT Run in run_model, run_model_single and context_run; items = images
+    STATS_TEMPLATE,            // generate_template* end to end
+    STATS_TEMPLATE_BATCH,      // generate_templates_batch*; items = images
+    STATS_IDENTIFY,            // fingerprint_identification; items = templates scored
+    STATS_IDENTIFY_GALLERY,    // items = gallery rows scored
+    STATS_IDENTIFY_TOPK,       // items = gallery rows scored
+    STATS_IDENTIFY_BATCH,      // items = probes x gallery rows
+    STATS_IDENTIFY_QUANTIZED,  // items = gallery rows scored
+    STATS_STAGE_COUNT
+} StatsStage;
+
+// Bucket b counts calls that took [2^b, 2^(b+1)) ns; bucket 0 also holds 0 ns and the last is open-ended
+#define STATS_BUCKETS 40
+
+typedef struct StageStats {
+    const char* name;          // Function or stage name, e.g. "preprocess_image_fused"
+    uint64_t count;
+    uint64_t items;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t histogram[STATS_BUCKETS];
+} StageStats;
+
+typedef struct FingerprintStats {
+    int enabled;               // 0 when built without FINGERPRINT_STATS; everything else is zero then
+    double elapsed_seconds;    // Since the first recorded call or the last fingerprint_reset_stats
+    uint64_t templates;        // Images run through the model (the Siamese graph counts two per run)
+    double templates_per_second;
+    StageStats stages[STATS_STAGE_COUNT];
+} FingerprintStats;
+
+void stats_record(StatsStage stage, uint64_t elapsed_ns, uint64_t items);
+
+#ifdef FINGERPRINT_STATS
+#define STATS_START(timer) uint64_t timer = monotonic_ns()
+#define STATS_STOP(stage, timer, items) stats_record((stage), monotonic_ns() - (timer), (uint64_t)(items))
+#else
+#define STATS_START(timer) ((void)0)
+#define STATS_STOP(stage, timer, items) ((void)0)
+#endif
+
+// API function
+// Snapshot of every thread's counters; safe to call from a metrics thread while requests run
+DllAPI int fingerprint_get_stats(FingerprintStats* out_stats);
+// Starts a new window: counts, histograms and elapsed_seconds restart from zero
+DllAPI void fingerprint_reset_stats(void);
+// Upper bound in ns of the histogram bucket holding quantile q (0..1) of a stage; 0 if it has no calls
+DllAPI uint64_t fingerprint_stats_quantile_ns(const StageStats* stage, double q);
+
+#endif // STATS_H
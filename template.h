@@ -5,12 +5,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <assert.h>
 #include <onnxruntime_c_api.h>
 #include "config.h"
+#include "image_filter.h"
+
+// Persistent inference context (opaque), created once per session and thread
+typedef struct FingerprintContext FingerprintContext;
+
+// Validated 8-bit gray BMP decoded in place: pixels points at the top row inside the caller's buffer,
+// stride is negative for bottom-up files
+typedef struct BmpView {
+    const unsigned char* pixels;
+    int width;
+    int height;
+    ptrdiff_t stride;
+} BmpView;
 
 // Image
+int decode_bmp(const uint8_t* data, size_t size, BmpView* view);
 int read_bmp_image(const char* filename, unsigned char** img, int* width, int* height);
+int read_bmp_image_gray(const char* filename, unsigned char** img, int* width, int* height);
 void apply_box_filter(unsigned char* input_img, unsigned char* output_img,
     int width, int height, int box_size);
 unsigned char interpolate_linear(unsigned char* image, int width, int height, int channel, float x, float y);
@@ -21,14 +37,80 @@ void normalize_image(unsigned char* input_img, float* output_img, int output_wid
 void preprocess_image(unsigned char* input_img, float* output_img, int input_width, int input_height, int output_width, int output_height);
 void reshape_image(float* original_image, float* reshaped_image, int width, int height, int channels);
 
+// Fused resize + normalize + HWC->CHW: reads two source rows per output row and writes the model tensor directly.
+// input_stride is the byte distance between rows (may be negative); input_channels is 1 or 3.
+// A 1-channel source is interpolated once and broadcast to output_channels planes (3 = ImageNet-normalized
+// RGB, 1 = v / 255 for a gray model with the normalization folded in).
+#define PREPROCESS_MAX_WIDTH 1024
+int preprocess_image_fused(const unsigned char* input_img, int input_width, int input_height, ptrdiff_t input_stride,
+    int input_channels, float* output_chw, int output_channels, int output_width, int output_height);
+
 // ONNX Model
+// input_size is the float count of one CHW image (3 or 1 x 224 x 224); the tensor shape follows it
 int run_model(const OrtApi* g_ort, OrtSession* session, float* input_data1, size_t input_size1,
     float* input_data2, size_t input_size2, float* output_data1, size_t output_size1,
     float* output_data2, size_t output_size2);
+int run_model_single(const OrtApi* g_ort, OrtSession* session, float* input_data, size_t input_size,
+    float* output_data, size_t output_size);
+int is_single_tower_model(const OrtApi* g_ort, OrtSession* session);
+int model_batch_capacity(const OrtApi* g_ort, OrtSession* session);
+int model_input_channels(const OrtApi* g_ort, OrtSession* session);
+
+// Context input slots and batched run, for callers that fill the input tensor themselves
+float* context_input(FingerprintContext* ctx, int index);
+OrtSession* context_session(const FingerprintContext* ctx);
+int context_max_batch(const FingerprintContext* ctx);
+int context_run(FingerprintContext* ctx, int batch_size, float* output_templates);
+
+// ORT threading and load-path options for load_model_with_options; zero fields keep ORT's defaults
+typedef struct ModelOptions {
+    int intra_op_threads;           // Threads per operator (0: one per physical core)
+    int inter_op_threads;           // > 1 also runs independent graph nodes concurrently
+    int global_thread_pools;        // Env-wide pools shared by every session on the env instead of one set per session
+    int disable_spinning;           // Idle pool threads block instead of spin-waiting for the next Run
+    const char* intra_op_affinity;  // ORT affinity string: ';'-separated processor lists, one per intra-op thread but the first
+    // Optimized-graph cache: the first load writes the ORT_ENABLE_ALL result here in ORT format,
+    // later loads map it and skip optimization. <path>.key records the source model (path, file id,
+    // size, mtime), ORT version and CPU features; on any mismatch the cache is rebuilt. New caches
+    // are written to a temporary file and renamed into place, never rewritten under a mapping
+    const ORTCHAR_T* optimized_model_path;
+    // Prepacked (layout-transformed) weights shared by every session created with this container
+    OrtPrepackedWeightsContainer* prepacked_weights;
+    // ORT profiling: per-node timings go to <prefix>_<timestamp>.json (Chrome trace format) once
+    // end_model_profiling is called; adds a timer around every kernel, so keep it off in production
+    const ORTCHAR_T* profile_file_prefix;
+} ModelOptions;
+
+int create_ort_env(const OrtApi* g_ort, const ModelOptions* options, OrtEnv** out_env);
+int create_model_session(const OrtApi* g_ort, OrtEnv* env, const ORTCHAR_T* model_path, const ModelOptions* options, OrtSession** out_session);
+// Releases a session from create_model_session together with any model file mapped for it and the
+// contexts generate_template* kept for it
+void release_model_session(const OrtApi* g_ort, OrtSession* session);
+// Process-unique number of a live session, never reused after release_model_session even when ORT
+// hands out the same address again; 0 if it cannot be recorded
+uint64_t model_session_serial(OrtSession* session);
 
 // API function
 DllAPI int load_model(const OrtApi* g_ort, const ORTCHAR_T* model_path, OrtEnv** out_env, OrtSession** out_session);
+DllAPI int load_model_with_options(const OrtApi* g_ort, const ORTCHAR_T* model_path, const ModelOptions* options, OrtEnv** out_env, OrtSession** out_session);
+// Safe to call from many threads on one session: each call borrows an idle context of the session
+// (input tensor, IoBinding), created on first use; up to MAX_IDLE_CONTEXTS stay cached per session
+// until release_model_session / clean_model
 DllAPI int generate_template(const char* image_filename, const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template);
+// Decodes a BMP held in memory (capture SDK / socket payload) without copying the pixel array
+DllAPI int generate_template_from_buffer(const uint8_t* data, size_t size, const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template);
+// Raw 8-bit gray frame straight from a sensor: stride is the byte distance between rows (>= width,
+// or <= -width with gray pointing at the top row of a bottom-up frame)
+DllAPI int generate_template_from_pixels(const uint8_t* gray, int width, int height, int stride, const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template);
+DllAPI int generate_templates_batch(const char** image_filenames, int num_images, const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_templates);
 DllAPI void clean_model(const OrtApi* g_ort, OrtEnv* env, OrtSession* session);
+// Stops profiling on a session loaded with profile_file_prefix and copies the trace file name to out_path
+DllAPI int end_model_profiling(const OrtApi* g_ort, OrtSession* session, char* out_path, size_t out_size);
+DllAPI int create_context(const OrtApi* g_ort, OrtSession* session, int max_batch, FingerprintContext** out_ctx);
+DllAPI int generate_template_with_context(FingerprintContext* ctx, const char* image_filename, float* output_template);
+DllAPI int generate_template_from_buffer_with_context(FingerprintContext* ctx, const uint8_t* data, size_t size, float* output_template);
+DllAPI int generate_template_from_pixels_with_context(FingerprintContext* ctx, const uint8_t* gray, int width, int height, int stride, float* output_template);
+DllAPI int generate_templates_batch_with_context(FingerprintContext* ctx, const char** image_filenames, int num_images, float* output_templates);
+DllAPI void clean_context(FingerprintContext* ctx);
 
 #endif // TEMPLATE_H
@@ -0,0 +1,390 @@
+#include "template_cache.h"
+#include "platform.h"
+#include <string.h>
+
+#define TEMPLATE_CACHE_DEFAULT_SHARDS 16
+
+typedef struct CacheEntry {
+    TemplateCacheKey key;
+    int lru_prev;      // Towards the most recently used entry, -1 at the head
+    int lru_next;      // Towards the least recently used entry, -1 at the tail
+    int chain_next;    // Next entry in the same hash bucket, -1 at the end
+    float template_data[TEMPLATE_SIZE];
+} CacheEntry;
+
+typedef struct CacheShard {
+    platform_mutex mutex;
+    CacheEntry* entries;
+    int* buckets;      // Head entry per bucket, -1 when empty; num_buckets is a power of two
+    int num_buckets;
+    int capacity;
+    int size;
+    int lru_head;
+    int lru_tail;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+} CacheShard;
+
+struct TemplateCache {
+    CacheShard* shards;
+    int num_shards;
+};
+
+// 128-bit key: MurmurHash3 x64_128 block mixing over each row, finalized with the total length
+
+#define HASH_C1 0x87c37b91114253d5ull
+#define HASH_C2 0x4cf5ad432745937full
+
+typedef struct KeyHasher {
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t length;
+} KeyHasher;
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+static void hash_block(KeyHasher* hasher, uint64_t k1, uint64_t k2) {
+    k1 *= HASH_C1;
+    k1 = rotl64(k1, 31);
+    k1 *= HASH_C2;
+    hasher->h1 ^= k1;
+    hasher->h1 = rotl64(hasher->h1, 27) + hasher->h2;
+    hasher->h1 = hasher->h1 * 5 + 0x52dce729;
+
+    k2 *= HASH_C2;
+    k2 = rotl64(k2, 33);
+    k2 *= HASH_C1;
+    hasher->h2 ^= k2;
+    hasher->h2 = rotl64(hasher->h2, 31) + hasher->h1;
+    hasher->h2 = hasher->h2 * 5 + 0x38495ab5;
+}
+
+// Each call is zero-padded to 16 bytes, so rows hash the same whatever their stride
+static void hash_bytes(KeyHasher* hasher, const uint8_t* data, size_t size) {
+    uint64_t k[2];
+    size_t offset = 0;
+    for (; offset + 16 <= size; offset += 16) {
+        memcpy(k, data + offset, 16);
+        hash_block(hasher, k[0], k[1]);
+    }
+    if (offset < size) {
+        uint8_t tail[16] = { 0 };
+        memcpy(tail, data + offset, size - offset);
+        memcpy(k, tail, 16);
+        hash_block(hasher, k[0], k[1]);
+    }
+    hasher->length += size;
+}
+
+TemplateCacheKey template_cache_key(const BmpView* view, uint64_t model_serial) {
+    KeyHasher hasher = { 0, 0, 0 };
+    hash_block(&hasher, model_serial, ((uint64_t)view->width << 32) | (uint32_t)view->height);
+    for (int y = 0; y < view->height; y++) {
+        hash_bytes(&hasher, view->pixels + y * view->stride, (size_t)view->width);
+    }
+
+    hasher.h1 ^= hasher.length;
+    hasher.h2 ^= hasher.length;
+    hasher.h1 += hasher.h2;
+    hasher.h2 += hasher.h1;
+    hasher.h1 = fmix64(hasher.h1);
+    hasher.h2 = fmix64(hasher.h2);
+    hasher.h1 += hasher.h2;
+    hasher.h2 += hasher.h1;
+
+    TemplateCacheKey key = { hasher.h1, hasher.h2 };
+    return key;
+}
+
+static int init_shard(CacheShard* shard, int capacity) {
+    shard->num_buckets = 1;
+    while (shard->num_buckets < capacity * 2) shard->num_buckets *= 2;
+    shard->entries = (CacheEntry*)malloc((size_t)capacity * sizeof(CacheEntry));
+    shard->buckets = (int*)malloc((size_t)shard->num_buckets * sizeof(int));
+    if (shard->entries == NULL || shard->buckets == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return -1;
+    }
+    for (int b = 0; b < shard->num_buckets; b++) {
+        shard->buckets[b] = -1;
+    }
+    shard->capacity = capacity;
+    shard->lru_head = -1;
+    shard->lru_tail = -1;
+    mutex_init(&shard->mutex);
+    return 0;
+}
+
+int create_template_cache(int capacity, int num_shards, TemplateCache** out_cache) {
+    if (capacity <= 0 || out_cache == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    if (num_shards <= 0) num_shards = TEMPLATE_CACHE_DEFAULT_SHARDS;
+    if (num_shards > capacity) num_shards = capacity;
+
+    TemplateCache* cache = (TemplateCache*)calloc(1, sizeof(TemplateCache));
+    CacheShard* shards = (CacheShard*)calloc(num_shards, sizeof(CacheShard));
+    if (cache == NULL || shards == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(cache);
+        free(shards);
+        return -1;
+    }
+    cache->shards = shards;
+
+    // The first capacity % num_shards shards take one extra entry
+    for (int s = 0; s < num_shards; s++) {
+        int shard_capacity = capacity / num_shards + (s < capacity % num_shards ? 1 : 0);
+        if (init_shard(&shards[s], shard_capacity) != 0) {
+            free(shards[s].entries);
+            free(shards[s].buckets);
+            clean_template_cache(cache);
+            return -1;
+        }
+        cache->num_shards = s + 1;
+    }
+
+    *out_cache = cache;
+    return 0;
+}
+
+static CacheShard* shard_of(TemplateCache* cache, const TemplateCacheKey* key) {
+    return &cache->shards[key->lo % (uint64_t)cache->num_shards];
+}
+
+static int bucket_of(const CacheShard* shard, const TemplateCacheKey* key) {
+    return (int)(key->hi & (uint64_t)(shard->num_buckets - 1));
+}
+
+static int find_entry(const CacheShard* shard, const TemplateCacheKey* key) {
+    for (int e = shard->buckets[bucket_of(shard, key)]; e >= 0; e = shard->entries[e].chain_next) {
+        if (shard->entries[e].key.hi == key->hi && shard->entries[e].key.lo == key->lo) return e;
+    }
+    return -1;
+}
+
+static void lru_unlink(CacheShard* shard, int e) {
+    CacheEntry* entry = &shard->entries[e];
+    if (entry->lru_prev >= 0) shard->entries[entry->lru_prev].lru_next = entry->lru_next;
+    else shard->lru_head = entry->lru_next;
+    if (entry->lru_next >= 0) shard->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    else shard->lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(CacheShard* shard, int e) {
+    CacheEntry* entry = &shard->entries[e];
+    entry->lru_prev = -1;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head >= 0) shard->entries[shard->lru_head].lru_prev = e;
+    shard->lru_head = e;
+    if (shard->lru_tail < 0) shard->lru_tail = e;
+}
+
+static void chain_remove(CacheShard* shard, int e) {
+    int* link = &shard->buckets[bucket_of(shard, &shard->entries[e].key)];
+    while (*link != e) {
+        link = &shard->entries[*link].chain_next;
+    }
+    *link = shard->entries[e].chain_next;
+}
+
+int template_cache_lookup(TemplateCache* cache, const TemplateCacheKey* key, float* output_template) {
+    CacheShard* shard = shard_of(cache, key);
+    mutex_lock(&shard->mutex);
+    int e = find_entry(shard, key);
+    if (e >= 0) {
+        if (shard->lru_head != e) {
+            lru_unlink(shard, e);
+            lru_push_front(shard, e);
+        }
+        memcpy(output_template, shard->entries[e].template_data, TEMPLATE_SIZE * sizeof(float));
+        shard->hits++;
+    }
+    else {
+        shard->misses++;
+    }
+    mutex_unlock(&shard->mutex);
+    return e >= 0;
+}
+
+void template_cache_insert(TemplateCache* cache, const TemplateCacheKey* key, const float* template_data) {
+    CacheShard* shard = shard_of(cache, key);
+    mutex_lock(&shard->mutex);
+    int e = find_entry(shard, key);
+    if (e >= 0) {
+        lru_unlink(shard, e);
+    }
+    else {
+        if (shard->size < shard->capacity) {
+            e = shard->size++;
+        }
+        else {
+            // Reuse the least recently used entry
+            e = shard->lru_tail;
+            lru_unlink(shard, e);
+            chain_remove(shard, e);
+            shard->evictions++;
+        }
+        CacheEntry* entry = &shard->entries[e];
+        entry->key = *key;
+        int bucket = bucket_of(shard, key);
+        entry->chain_next = shard->buckets[bucket];
+        shard->buckets[bucket] = e;
+        shard->insertions++;
+    }
+    memcpy(shard->entries[e].template_data, template_data, TEMPLATE_SIZE * sizeof(float));
+    lru_push_front(shard, e);
+    mutex_unlock(&shard->mutex);
+}
+
+// Runs the model through ctx when given, else through the session's idle contexts; a session
+// without a serial number skips the cache rather than risk sharing entries with another model
+static int cached_template_from_view(TemplateCache* cache, const BmpView* view, const OrtApi* g_ort, OrtEnv* env,
+    OrtSession* session, FingerprintContext* ctx, float* output_template) {
+    uint64_t serial = cache != NULL ? model_session_serial(ctx != NULL ? context_session(ctx) : session) : 0;
+    TemplateCacheKey key = { 0, 0 };
+    if (serial != 0) {
+        key = template_cache_key(view, serial);
+        if (template_cache_lookup(cache, &key, output_template)) return 0;
+    }
+
+    int result = ctx != NULL ?
+        generate_template_from_pixels_with_context(ctx, view->pixels, view->width, view->height,
+            (int)view->stride, output_template) :
+        generate_template_from_pixels(view->pixels, view->width, view->height, (int)view->stride,
+            g_ort, env, session, output_template);
+    if (result == 0 && serial != 0) {
+        template_cache_insert(cache, &key, output_template);
+    }
+    return result;
+}
+
+static int cached_template_from_file(TemplateCache* cache, const char* image_filename, const OrtApi* g_ort,
+    OrtEnv* env, OrtSession* session, FingerprintContext* ctx, float* output_template) {
+    MappedFile file;
+    if (map_file(image_filename, &file) != 0) {
+        fprintf(stderr, "Error opening BMP file\n");
+        return -1;
+    }
+
+    BmpView view;
+    int result = decode_bmp((const uint8_t*)file.data, file.size, &view);
+    if (result == 0) {
+        result = cached_template_from_view(cache, &view, g_ort, env, session, ctx, output_template);
+    }
+
+    unmap_file(&file);
+    return result;
+}
+
+static int valid_pixels(const uint8_t* gray, int width, int height, int stride) {
+    return gray != NULL && width > 0 && height > 0 && stride != INT32_MIN && abs(stride) >= width;
+}
+
+int generate_template_cached(TemplateCache* cache, const char* image_filename,
+    const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template) {
+    if (image_filename == NULL || g_ort == NULL || session == NULL || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    return cached_template_from_file(cache, image_filename, g_ort, env, session, NULL, output_template);
+}
+
+int generate_template_from_buffer_cached(TemplateCache* cache, const uint8_t* data, size_t size,
+    const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template) {
+    if (data == NULL || g_ort == NULL || session == NULL || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    BmpView view;
+    if (decode_bmp(data, size, &view) != 0) return -1;
+    return cached_template_from_view(cache, &view, g_ort, env, session, NULL, output_template);
+}
+
+int generate_template_from_pixels_cached(TemplateCache* cache, const uint8_t* gray, int width, int height, int stride,
+    const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template) {
+    if (!valid_pixels(gray, width, height, stride) || g_ort == NULL || session == NULL || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    BmpView view = { gray, width, height, stride };
+    return cached_template_from_view(cache, &view, g_ort, env, session, NULL, output_template);
+}
+
+int generate_template_with_context_cached(TemplateCache* cache, FingerprintContext* ctx,
+    const char* image_filename, float* output_template) {
+    if (ctx == NULL || image_filename == NULL || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    return cached_template_from_file(cache, image_filename, NULL, NULL, NULL, ctx, output_template);
+}
+
+int generate_template_from_buffer_with_context_cached(TemplateCache* cache, FingerprintContext* ctx,
+    const uint8_t* data, size_t size, float* output_template) {
+    if (ctx == NULL || data == NULL || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    BmpView view;
+    if (decode_bmp(data, size, &view) != 0) return -1;
+    return cached_template_from_view(cache, &view, NULL, NULL, NULL, ctx, output_template);
+}
+
+int generate_template_from_pixels_with_context_cached(TemplateCache* cache, FingerprintContext* ctx,
+    const uint8_t* gray, int width, int height, int stride, float* output_template) {
+    if (ctx == NULL || !valid_pixels(gray, width, height, stride) || output_template == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+
+    BmpView view = { gray, width, height, stride };
+    return cached_template_from_view(cache, &view, NULL, NULL, NULL, ctx, output_template);
+}
+
+void template_cache_get_stats(TemplateCache* cache, TemplateCacheStats* out_stats) {
+    if (out_stats == NULL) return;
+    memset(out_stats, 0, sizeof(TemplateCacheStats));
+    if (cache == NULL) return;
+
+    for (int s = 0; s < cache->num_shards; s++) {
+        CacheShard* shard = &cache->shards[s];
+        mutex_lock(&shard->mutex);
+        out_stats->hits += shard->hits;
+        out_stats->misses += shard->misses;
+        out_stats->insertions += shard->insertions;
+        out_stats->evictions += shard->evictions;
+        out_stats->size += shard->size;
+        out_stats->capacity += shard->capacity;
+        mutex_unlock(&shard->mutex);
+    }
+}
+
+void clean_template_cache(TemplateCache* cache) {
+    if (cache == NULL) return;
+
+    for (int s = 0; s < cache->num_shards; s++) {
+        mutex_destroy(&cache->shards[s].mutex);
+        free(cache->shards[s].entries);
+        free(cache->shards[s].buckets);
+    }
+    free(cache->shards);
+    free(cache);
+}
@@ -0,0 +1,54 @@
+#ifndef TEMPLATE_CACHE_H
+#define TEMPLATE_CACHE_H
+
+#include "config.h"
+#include "template.h"
+
+// Bounded LRU of recent templates, so a capture client's retry of the same image is answered
+// without preprocessing or inference. The key is a 128-bit hash of the decoded pixels (width,
+// height and rows, not the file bytes) with the producing session's model_session_serial mixed
+// in, so a reloaded or hot-swapped model never serves templates of the one it replaced; entries of
+// a released session are never hit again and age out. Entries are spread over shards, each an LRU
+// list and hash table under its own mutex, so concurrent requests rarely share a lock.
+typedef struct TemplateCache TemplateCache;
+
+typedef struct TemplateCacheKey {
+    uint64_t hi;
+    uint64_t lo;
+} TemplateCacheKey;
+
+typedef struct TemplateCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    int size;
+    int capacity;
+} TemplateCacheStats;
+
+TemplateCacheKey template_cache_key(const BmpView* view, uint64_t model_serial);
+// Returns 1 and copies the template on a hit, 0 on a miss
+int template_cache_lookup(TemplateCache* cache, const TemplateCacheKey* key, float* output_template);
+void template_cache_insert(TemplateCache* cache, const TemplateCacheKey* key, const float* template_data);
+
+// API function
+// capacity is the total number of templates kept (under 300 bytes each); num_shards <= 0 selects 16
+DllAPI int create_template_cache(int capacity, int num_shards, TemplateCache** out_cache);
+// generate_template* behind the cache; a NULL cache always runs the model.
+// Concurrent misses on the same image each run the model; the later insert wins
+DllAPI int generate_template_cached(TemplateCache* cache, const char* image_filename,
+    const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template);
+DllAPI int generate_template_from_buffer_cached(TemplateCache* cache, const uint8_t* data, size_t size,
+    const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template);
+DllAPI int generate_template_from_pixels_cached(TemplateCache* cache, const uint8_t* gray, int width, int height, int stride,
+    const OrtApi* g_ort, OrtEnv* env, OrtSession* session, float* output_template);
+DllAPI int generate_template_with_context_cached(TemplateCache* cache, FingerprintContext* ctx,
+    const char* image_filename, float* output_template);
+DllAPI int generate_template_from_buffer_with_context_cached(TemplateCache* cache, FingerprintContext* ctx,
+    const uint8_t* data, size_t size, float* output_template);
+DllAPI int generate_template_from_pixels_with_context_cached(TemplateCache* cache, FingerprintContext* ctx,
+    const uint8_t* gray, int width, int height, int stride, float* output_template);
+DllAPI void template_cache_get_stats(TemplateCache* cache, TemplateCacheStats* out_stats);
+DllAPI void clean_template_cache(TemplateCache* cache);
+
+#endif // TEMPLATE_CACHE_H
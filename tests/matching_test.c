@@ -1,5 +1,11 @@
 #include "../matching.h"
 #include "../template.h"
+#include "../ivf_index.h"
+#include "../gallery_file.h"
+#include "../live_gallery.h"
+#include "../platform.h"
+#include "../stats.h"
+#include <string.h>
 
 void test_cosine_similarity() {
 	float vector1[] = { 1.0, 1.0 };
@@ -8,8 +14,6 @@ void test_cosine_similarity() {
 
 	float similarity = cosine_similarity(vector1, vector2, vector_length);
 	printf("Cosine Similarity: %.6f\n", similarity);
-
-	return 0;
 }
 
 void test_verification(const float* embed1, const float* embed2) {
@@ -25,44 +29,80 @@ void print_scores(float* scores, int size) {
     }
 }
 
+// Sample fingerprints used by the model-backed identification tests
+static const char* sample_images[30] = {
+    "tests/samples/fingerprint_image.bmp",
+    "tests/samples/fingerprint_image(1).bmp",
+    "tests/samples/fingerprint_image(2).bmp",
+    "tests/samples/fingerprint_image(3).bmp",
+    "tests/samples/fingerprint_image(4).bmp",
+    "tests/samples/fingerprint_image(5).bmp",
+    "tests/samples/fingerprint_image(6).bmp",
+    "tests/samples/fingerprint_image(7).bmp",
+    "tests/samples/fingerprint_image(8).bmp",
+    "tests/samples/fingerprint_image(9).bmp",
+    "tests/samples/fingerprint_image(10).bmp",
+    "tests/samples/fingerprint_image(11).bmp",
+    "tests/samples/fingerprint_image(12).bmp",
+    "tests/samples/fingerprint_image(13).bmp",
+    "tests/samples/fingerprint_image(14).bmp",
+    "tests/samples/fingerprint_image(15).bmp",
+    "tests/samples/fingerprint_image(16).bmp",
+    "tests/samples/fingerprint_image(17).bmp",
+    "tests/samples/fingerprint_image(18).bmp",
+    "tests/samples/fingerprint_image(19).bmp",
+    "tests/samples/fingerprint_image(20).bmp",
+    "tests/samples/fingerprint_image(21).bmp",
+    "tests/samples/fingerprint_image(22).bmp",
+    "tests/samples/fingerprint_image(23).bmp",
+    "tests/samples/fingerprint_image(24).bmp",
+    "tests/samples/fingerprint_image(25).bmp",
+    "tests/samples/fingerprint_image(26).bmp",
+    "tests/samples/fingerprint_image(27).bmp",
+    "tests/samples/fingerprint_image(28).bmp",
+    "tests/samples/fingerprint_image(29).bmp"
+};
+
+static void free_template_db(float** template_db, int db_size) {
+    if (template_db == NULL) return;
+    for (int i = 0; i < db_size; ++i) {
+        free(template_db[i]);
+    }
+    free(template_db);
+}
+
+// Fills one template with uniform noise in [-scale / 2, scale / 2] from rand()
+static void random_row(float* row, float scale) {
+    for (int j = 0; j < 64; ++j) {
+        row[j] = scale * ((float)rand() / RAND_MAX - 0.5f);
+    }
+}
+
+// Database of db_size noise templates, reproducible for a given seed; NULL on allocation failure
+static float** random_template_db(int db_size, unsigned int seed, float scale) {
+    float** template_db = (float**)calloc(db_size, sizeof(float*));
+    if (template_db == NULL) {
+        return NULL;
+    }
+    srand(seed);
+    for (int i = 0; i < db_size; ++i) {
+        template_db[i] = (float*)malloc(64 * sizeof(float));
+        if (template_db[i] == NULL) {
+            free_template_db(template_db, db_size);
+            return NULL;
+        }
+        random_row(template_db[i], scale);
+    }
+    return template_db;
+}
+
 // Testing function for fingerprint_identification
 void test_identification(const ORTCHAR_T* model_path) {
 
     // Image filenames for the fingerprint database
     int db_size = 30;
+    const char** image_filenames = sample_images;
 
-    const char* image_filenames[30] = {
-        "tests/samples/fingerprint_image.bmp",
-        "tests/samples/fingerprint_image(1).bmp",
-        "tests/samples/fingerprint_image(2).bmp",
-        "tests/samples/fingerprint_image(3).bmp",
-        "tests/samples/fingerprint_image(4).bmp",
-        "tests/samples/fingerprint_image(5).bmp",
-        "tests/samples/fingerprint_image(6).bmp",
-        "tests/samples/fingerprint_image(7).bmp",
-        "tests/samples/fingerprint_image(8).bmp",
-        "tests/samples/fingerprint_image(9).bmp",
-        "tests/samples/fingerprint_image(10).bmp",
-        "tests/samples/fingerprint_image(11).bmp",
-        "tests/samples/fingerprint_image(12).bmp",
-        "tests/samples/fingerprint_image(13).bmp",
-        "tests/samples/fingerprint_image(14).bmp",
-        "tests/samples/fingerprint_image(15).bmp",
-        "tests/samples/fingerprint_image(16).bmp",
-        "tests/samples/fingerprint_image(17).bmp",
-        "tests/samples/fingerprint_image(18).bmp",
-        "tests/samples/fingerprint_image(19).bmp",
-        "tests/samples/fingerprint_image(20).bmp",
-        "tests/samples/fingerprint_image(21).bmp",
-        "tests/samples/fingerprint_image(22).bmp",
-        "tests/samples/fingerprint_image(23).bmp",
-        "tests/samples/fingerprint_image(24).bmp",
-        "tests/samples/fingerprint_image(25).bmp",
-        "tests/samples/fingerprint_image(26).bmp",
-        "tests/samples/fingerprint_image(27).bmp",
-        "tests/samples/fingerprint_image(28).bmp",
-        "tests/samples/fingerprint_image(29).bmp"
-    };
 
     // Allocate memory for template database (db_size * 64 elements, assuming 64-dimensional embeddings)
     float** template_db = (float**)malloc(30 * sizeof(float*));
@@ -128,11 +168,761 @@ void test_identification(const ORTCHAR_T* model_path) {
         printf("\n");
     }
 
+    // Rank-1 (nearest non-self template) agreement of each quantized encoding with fp32
+    Gallery* gallery = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0) {
+        fprintf(stderr, "Failed to build gallery.\n");
+        return;
+    }
+    const int encodings[3] = { GALLERY_ENCODING_INT8, GALLERY_ENCODING_INT8_GLOBAL, GALLERY_ENCODING_FP16 };
+    const char* encoding_names[3] = { "int8", "int8 (global scale)", "fp16" };
+    for (int e = 0; e < 3; ++e) {
+        QuantizedGallery* quantized = NULL;
+        if (quantize_gallery(gallery, encodings[e], &quantized) != 0) {
+            fprintf(stderr, "Failed to quantize gallery.\n");
+            return;
+        }
+        int agree = 0;
+        for (int i = 0; i < db_size; ++i) {
+            int64_t ids[2], exact_ids[2];
+            float scores[2], exact_scores[2];
+            fingerprint_identify_topk(template_db[i], gallery, 2, 2.0f, exact_ids, exact_scores);
+            fingerprint_identify_topk_quantized(template_db[i], quantized, NULL, 2, 2.0f, ids, scores);
+            int64_t exact_best = exact_ids[0] == i ? exact_ids[1] : exact_ids[0];
+            int64_t best = ids[0] == i ? ids[1] : ids[0];
+            agree += best == exact_best;
+        }
+        printf("Rank-1 agreement of %s with fp32: %d/%d\n", encoding_names[e], agree, db_size);
+        clean_quantized_gallery(quantized);
+    }
+    clean_gallery(gallery);
+
     // Clean up
+    free_template_db(template_db, db_size);
+    free(score);
+    clean_model(g_ort, env, session);
+}
+// Gallery scoring must reproduce fingerprint_identification's distances
+void test_gallery_identification() {
+    int db_size = 1001;  // Not a multiple of the kernel block size
+
+    float** template_db = random_template_db(db_size, 0, 1.0f);
+    float* score = (float*)malloc(db_size * sizeof(float));
+    float* gallery_score = (float*)malloc(db_size * sizeof(float));
+    if (template_db == NULL || score == NULL || gallery_score == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+
+    Gallery* gallery = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0) {
+        fprintf(stderr, "Test failed: Failed to build gallery.\n");
+        exit(1);
+    }
+
+    fingerprint_identification(template_db[7], template_db, db_size, score);
+    fingerprint_identification_gallery(template_db[7], gallery, gallery_score);
+
+    float tolerance = 1e-5f;
     for (int i = 0; i < db_size; ++i) {
-        free(template_db[i]);
+        if (fabs(score[i] - gallery_score[i]) > tolerance) {
+            fprintf(stderr, "Error: Gallery score %d = %f, expected %f\n", i, gallery_score[i], score[i]);
+            exit(1);
+        }
     }
-    free(template_db);
+    printf("Test passed: Gallery scores match fingerprint_identification.\n");
+
+    // A missing template fails the build instead of shifting later ids
+    float* missing = template_db[3];
+    Gallery* partial = NULL;
+    template_db[3] = NULL;
+    if (gallery_from_templates(template_db, db_size, &partial) == 0 || partial != NULL) {
+        fprintf(stderr, "Test failed: Gallery built from a database with a NULL template.\n");
+        exit(1);
+    }
+    template_db[3] = missing;
+
+    free_template_db(template_db, db_size);
     free(score);
-    clean_model(g_ort, env, session);
-}
\ No newline at end of file
+    free(gallery_score);
+    clean_gallery(gallery);
+}
+
+void test_identify_topk() {
+    int db_size = 3001;  // Spans several score blocks
+    int k = 10;
+
+    float** template_db = random_template_db(db_size, 1, 1.0f);
+    float* score = (float*)malloc(db_size * sizeof(float));
+    if (template_db == NULL || score == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+
+    Gallery* gallery = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0) {
+        fprintf(stderr, "Test failed: Failed to build gallery.\n");
+        exit(1);
+    }
+    fingerprint_identification_gallery(template_db[42], gallery, score);
+
+    // Reference: k smallest distances by selection over the full score array
+    int64_t ids[10];
+    float scores[10];
+    int found = fingerprint_identify_topk(template_db[42], gallery, k, 2.0f, ids, scores);
+    if (found != k || ids[0] != 42) {
+        fprintf(stderr, "Test failed: Top-K returned %d results, best id %lld\n", found, (long long)ids[0]);
+        exit(1);
+    }
+    for (int r = 0; r < k; ++r) {
+        int best = -1;
+        for (int i = 0; i < db_size; ++i) {
+            if (score[i] >= 0.0f && (best < 0 || score[i] < score[best])) best = i;
+        }
+        if (ids[r] != best || fabs(scores[r] - score[best]) > 1e-6f) {
+            fprintf(stderr, "Error: Rank %d = id %lld (%f), expected id %d (%f)\n",
+                r, (long long)ids[r], scores[r], best, score[best]);
+            exit(1);
+        }
+        score[best] = -1.0f;
+    }
+
+    // Threshold rejects everything but the probe itself
+    found = fingerprint_identify_topk(template_db[42], gallery, k, 0.01f, ids, scores);
+    if (found != 1 || ids[0] != 42) {
+        fprintf(stderr, "Test failed: Thresholded Top-K returned %d results\n", found);
+        exit(1);
+    }
+    printf("Test passed: Top-K matches a full sort of gallery scores.\n");
+
+    free_template_db(template_db, db_size);
+    free(score);
+    clean_gallery(gallery);
+}
+
+void test_parallel_identification() {
+    int db_size = 5 * GALLERY_SHARD_SIZE + 123;  // Partial last shard
+    int k = 10;
+
+    float** template_db = random_template_db(db_size, 2, 1.0f);
+    float* score = (float*)malloc(db_size * sizeof(float));
+    float* parallel_score = (float*)malloc(db_size * sizeof(float));
+    if (template_db == NULL || score == NULL || parallel_score == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+
+    Gallery* gallery = NULL;
+    ThreadPool* pool = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0 || create_thread_pool(4, 0, &pool) != 0) {
+        fprintf(stderr, "Test failed: Failed to build gallery or thread pool.\n");
+        exit(1);
+    }
+
+    int64_t ids[10], parallel_ids[10];
+    float scores[10], parallel_scores[10];
+    fingerprint_identification_gallery(template_db[9000], gallery, score);
+    int found = fingerprint_identify_topk(template_db[9000], gallery, k, 2.0f, ids, scores);
+
+    gallery_set_thread_pool(gallery, pool);
+    fingerprint_identification_gallery(template_db[9000], gallery, parallel_score);
+    int parallel_found = fingerprint_identify_topk(template_db[9000], gallery, k, 2.0f, parallel_ids, parallel_scores);
+
+    for (int i = 0; i < db_size; ++i) {
+        if (score[i] != parallel_score[i]) {
+            fprintf(stderr, "Error: Parallel score %d = %f, expected %f\n", i, parallel_score[i], score[i]);
+            exit(1);
+        }
+    }
+    if (found != parallel_found) {
+        fprintf(stderr, "Error: Parallel Top-K found %d, expected %d\n", parallel_found, found);
+        exit(1);
+    }
+    for (int r = 0; r < found; ++r) {
+        if (ids[r] != parallel_ids[r] || scores[r] != parallel_scores[r]) {
+            fprintf(stderr, "Error: Parallel rank %d = id %lld, expected id %lld\n", r, (long long)parallel_ids[r], (long long)ids[r]);
+            exit(1);
+        }
+    }
+    printf("Test passed: Sharded search matches the single-threaded search.\n");
+
+    free_template_db(template_db, db_size);
+    free(score);
+    free(parallel_score);
+    clean_gallery(gallery);
+    clean_thread_pool(pool);
+}
+
+void test_batch_identification() {
+    int db_size = 2 * GALLERY_SHARD_SIZE + 77;
+    int num_queries = BATCH_QUERY_TILE + 6;  // Partial query tile, not a multiple of 4
+    int k = 5;
+
+    float** template_db = random_template_db(db_size, 3, 1.0f);
+    float* queries = (float*)malloc((size_t)num_queries * 64 * sizeof(float));
+    int64_t* batch_ids = (int64_t*)malloc((size_t)num_queries * k * sizeof(int64_t));
+    float* batch_scores = (float*)malloc((size_t)num_queries * k * sizeof(float));
+    int* batch_counts = (int*)malloc(num_queries * sizeof(int));
+    if (template_db == NULL || queries == NULL || batch_ids == NULL || batch_scores == NULL || batch_counts == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+    // Probes are noisy copies of gallery entries
+    for (int q = 0; q < num_queries; ++q) {
+        for (int j = 0; j < 64; ++j) {
+            queries[q * 64 + j] = template_db[q * 97][j] + 0.05f * ((float)rand() / RAND_MAX - 0.5f);
+        }
+    }
+
+    Gallery* gallery = NULL;
+    ThreadPool* pool = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0 || create_thread_pool(3, 0, &pool) != 0) {
+        fprintf(stderr, "Test failed: Failed to build gallery or thread pool.\n");
+        exit(1);
+    }
+
+    for (int pass = 0; pass < 2; ++pass) {
+        gallery_set_thread_pool(gallery, pass == 0 ? NULL : pool);
+        if (fingerprint_identify_batch(queries, num_queries, gallery, k, 0.5f, batch_ids, batch_scores, batch_counts) != 0) {
+            fprintf(stderr, "Test failed: Batch identification failed.\n");
+            exit(1);
+        }
+
+        for (int q = 0; q < num_queries; ++q) {
+            int64_t ids[5];
+            float scores[5];
+            int found = fingerprint_identify_topk(queries + q * 64, gallery, k, 0.5f, ids, scores);
+            if (found != batch_counts[q] || batch_ids[q * k] != q * 97) {
+                fprintf(stderr, "Error: Probe %d found %d (best id %lld), expected %d\n",
+                    q, batch_counts[q], (long long)batch_ids[q * k], found);
+                exit(1);
+            }
+            for (int r = 0; r < found; ++r) {
+                if (ids[r] != batch_ids[q * k + r] || fabs(scores[r] - batch_scores[q * k + r]) > 1e-5f) {
+                    fprintf(stderr, "Error: Probe %d rank %d = id %lld, expected id %lld\n",
+                        q, r, (long long)batch_ids[q * k + r], (long long)ids[r]);
+                    exit(1);
+                }
+            }
+        }
+    }
+    printf("Test passed: Batch identification matches per-probe Top-K.\n");
+
+    free_template_db(template_db, db_size);
+    free(queries);
+    free(batch_ids);
+    free(batch_scores);
+    free(batch_counts);
+    clean_gallery(gallery);
+    clean_thread_pool(pool);
+}
+
+void test_quantized_identification() {
+    int db_size = 5003;
+    int num_queries = 200;
+    int k = 5;
+
+    float** template_db = random_template_db(db_size, 4, 1.0f);
+    float* queries = (float*)malloc((size_t)num_queries * 64 * sizeof(float));
+    if (template_db == NULL || queries == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+    // Heavily perturbed probes so rank-1 is not trivially perfect
+    for (int q = 0; q < num_queries; ++q) {
+        for (int j = 0; j < 64; ++j) {
+            queries[q * 64 + j] = template_db[q * 25][j] + 2.5f * ((float)rand() / RAND_MAX - 0.5f);
+        }
+    }
+
+    Gallery* gallery = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0) {
+        fprintf(stderr, "Test failed: Failed to build gallery.\n");
+        exit(1);
+    }
+
+    int exact_hits = 0;
+    for (int q = 0; q < num_queries; ++q) {
+        int64_t ids[5];
+        float scores[5];
+        fingerprint_identify_topk(queries + q * 64, gallery, k, 2.0f, ids, scores);
+        exact_hits += ids[0] == q * 25;
+    }
+    printf("fp32 rank-1: %d/%d\n", exact_hits, num_queries);
+
+    const int encodings[3] = { GALLERY_ENCODING_INT8, GALLERY_ENCODING_INT8_GLOBAL, GALLERY_ENCODING_FP16 };
+    const char* encoding_names[3] = { "int8", "int8 (global scale)", "fp16" };
+    const float tolerances[3] = { 0.02f, 0.03f, 0.002f };
+    for (int e = 0; e < 3; ++e) {
+        QuantizedGallery* quantized = NULL;
+        if (quantize_gallery(gallery, encodings[e], &quantized) != 0) {
+            fprintf(stderr, "Test failed: Failed to quantize gallery.\n");
+            exit(1);
+        }
+
+        int hits = 0;
+        for (int q = 0; q < num_queries; ++q) {
+            int64_t ids[5], exact_ids[5], reranked_ids[5];
+            float scores[5], exact_scores[5], reranked_scores[5];
+            int found = fingerprint_identify_topk_quantized(queries + q * 64, quantized, NULL, k, 2.0f, ids, scores);
+            fingerprint_identify_topk(queries + q * 64, gallery, k, 2.0f, exact_ids, exact_scores);
+            int reranked = fingerprint_identify_topk_quantized(queries + q * 64, quantized, gallery, k, 2.0f, reranked_ids, reranked_scores);
+            if (found != k || reranked != k) {
+                fprintf(stderr, "Error: Quantized search found %d / %d results\n", found, reranked);
+                exit(1);
+            }
+            hits += ids[0] == q * 25;
+
+            // Quantized distances stay close to exact ones; reranking restores the exact result
+            float exact_distance = template_distance(queries + q * 64, template_db[ids[0]]);
+            if (fabs(scores[0] - exact_distance) > tolerances[e]) {
+                fprintf(stderr, "Error: %s distance %f, exact %f\n", encoding_names[e], scores[0], exact_distance);
+                exit(1);
+            }
+            for (int r = 0; r < k; ++r) {
+                if (reranked_ids[r] != exact_ids[r]) {
+                    fprintf(stderr, "Error: %s reranked rank %d = id %lld, expected id %lld\n",
+                        encoding_names[e], r, (long long)reranked_ids[r], (long long)exact_ids[r]);
+                    exit(1);
+                }
+            }
+        }
+        printf("%s rank-1: %d/%d\n", encoding_names[e], hits, num_queries);
+        clean_quantized_gallery(quantized);
+    }
+    printf("Test passed: Quantized galleries track fp32 and rerank to the exact result.\n");
+
+    free_template_db(template_db, db_size);
+    free(queries);
+    clean_gallery(gallery);
+}
+
+void test_ivf_identification() {
+    int num_clusters = 200;
+    int db_size = 20000;
+    int nlist = 64;
+    int k = 5;
+
+    // Clustered templates: each is a perturbed copy of one of num_clusters centres
+    float* centres = (float*)malloc((size_t)num_clusters * 64 * sizeof(float));
+    float** template_db = (float**)malloc(db_size * sizeof(float*));
+    if (centres == NULL || template_db == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+    srand(5);
+    for (int i = 0; i < num_clusters; ++i) {
+        random_row(centres + (size_t)i * 64, 1.0f);
+    }
+    for (int i = 0; i < db_size; ++i) {
+        template_db[i] = (float*)malloc(64 * sizeof(float));
+        for (int j = 0; j < 64; ++j) {
+            template_db[i][j] = centres[(i % num_clusters) * 64 + j] + 0.3f * ((float)rand() / RAND_MAX - 0.5f);
+        }
+    }
+
+    Gallery* gallery = NULL;
+    IvfIndex* index = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0 || create_ivf_index(gallery, nlist, &index) != 0) {
+        fprintf(stderr, "Test failed: Failed to build IVF index.\n");
+        exit(1);
+    }
+
+    // Probing every list is an exact search
+    int64_t ids[5], exact_ids[5];
+    float scores[5], exact_scores[5];
+    for (int q = 0; q < 50; ++q) {
+        int found = fingerprint_identify_ivf(template_db[q * 397], index, nlist, k, 2.0f, ids, scores);
+        fingerprint_identify_topk(template_db[q * 397], gallery, k, 2.0f, exact_ids, exact_scores);
+        for (int r = 0; r < k; ++r) {
+            if (found != k || ids[r] != exact_ids[r] || fabs(scores[r] - exact_scores[r]) > 1e-5f) {
+                fprintf(stderr, "Error: Full-probe IVF rank %d = id %lld, expected id %lld\n", r, (long long)ids[r], (long long)exact_ids[r]);
+                exit(1);
+            }
+        }
+    }
+
+    // Recall@1 of the exact nearest neighbour for perturbed probes as nprobe grows
+    float probe[64];
+    for (int nprobe = 1; nprobe <= 16; nprobe *= 4) {
+        int hits = 0;
+        srand(6);
+        for (int q = 0; q < 200; ++q) {
+            for (int j = 0; j < 64; ++j) {
+                probe[j] = template_db[q * 97][j] + 0.1f * ((float)rand() / RAND_MAX - 0.5f);
+            }
+            fingerprint_identify_topk(probe, gallery, 1, 2.0f, exact_ids, exact_scores);
+            fingerprint_identify_ivf(probe, index, nprobe, 1, 2.0f, ids, scores);
+            hits += ids[0] == exact_ids[0];
+        }
+        printf("IVF nlist %d nprobe %d recall@1: %d/200\n", nlist, nprobe, hits);
+    }
+
+    // Removed ids disappear, added ids are found, the rest are untouched
+    if (ivf_remove(index, 397) != 0 || ivf_remove(index, 397) == 0 || ivf_size(index) != db_size - 1) {
+        fprintf(stderr, "Test failed: IVF remove.\n");
+        exit(1);
+    }
+    fingerprint_identify_ivf(template_db[397], index, nlist, 1, 2.0f, ids, scores);
+    if (ids[0] == 397) {
+        fprintf(stderr, "Test failed: Removed id 397 still returned.\n");
+        exit(1);
+    }
+    if (ivf_add(index, template_db[397], 1000000) != 0 || ivf_add(index, template_db[397], 1000000) == 0) {
+        fprintf(stderr, "Test failed: IVF add.\n");
+        exit(1);
+    }
+    for (int i = 0; i < db_size; i += 1001) {
+        int64_t expected = i == 397 ? 1000000 : i;
+        fingerprint_identify_ivf(template_db[i], index, 4, 1, 2.0f, ids, scores);
+        if (ids[0] != expected) {
+            fprintf(stderr, "Error: IVF self-match for %d returned id %lld\n", i, (long long)ids[0]);
+            exit(1);
+        }
+    }
+    printf("Test passed: IVF index matches exact search at full probe and tracks add/remove.\n");
+
+    free_template_db(template_db, db_size);
+    free(centres);
+    clean_ivf_index(index);
+    clean_gallery(gallery);
+}
+
+void test_gallery_file() {
+    int db_size = 3000;
+    const char* gallery_path = "tests/gallery_test.fpg";
+    const char* index_path = "tests/gallery_index_test.fpg";
+
+    float** template_db = random_template_db(db_size, 7, 3.0f);
+    if (template_db == NULL) {
+        fprintf(stderr, "Memory allocation failed for template_db.\n");
+        return;
+    }
+
+    Gallery* gallery = NULL;
+    Gallery* mapped = NULL;
+    if (gallery_from_templates(template_db, db_size, &gallery) != 0 || save_gallery(gallery_path, gallery) != 0 ||
+        map_gallery(gallery_path, &mapped) != 0) {
+        fprintf(stderr, "Test failed: Failed to save and map gallery.\n");
+        exit(1);
+    }
+    if (mapped->size != db_size ||
+        memcmp(mapped->templates, gallery->templates, (size_t)db_size * 64 * sizeof(float)) != 0 ||
+        memcmp(mapped->norms, gallery->norms, db_size * sizeof(float)) != 0 ||
+        memcmp(mapped->ids, gallery->ids, db_size * sizeof(int64_t)) != 0) {
+        fprintf(stderr, "Test failed: Mapped gallery differs from the saved one.\n");
+        exit(1);
+    }
+    if (((uintptr_t)mapped->templates % MEMORY_ALIGNMENT) != 0 || add_to_gallery(mapped, template_db[0], 0) == 0) {
+        fprintf(stderr, "Test failed: Mapped gallery must be aligned and read-only.\n");
+        exit(1);
+    }
+
+    int64_t ids[5], mapped_ids[5];
+    float scores[5], mapped_scores[5];
+    fingerprint_identify_topk(template_db[11], gallery, 5, 2.0f, ids, scores);
+    fingerprint_identify_topk(template_db[11], mapped, 5, 2.0f, mapped_ids, mapped_scores);
+    if (memcmp(ids, mapped_ids, sizeof(ids)) != 0 || memcmp(scores, mapped_scores, sizeof(scores)) != 0) {
+        fprintf(stderr, "Test failed: Mapped gallery search differs.\n");
+        exit(1);
+    }
+
+    // An index section maps back to the same lists
+    IvfIndex* index = NULL;
+    IvfIndex* mapped_index = NULL;
+    if (create_ivf_index(gallery, 16, &index) != 0 || save_ivf_index(index_path, index) != 0 ||
+        map_ivf_index(index_path, &mapped_index) != 0) {
+        fprintf(stderr, "Test failed: Failed to save and map IVF index.\n");
+        exit(1);
+    }
+    if (ivf_size(mapped_index) != db_size || ivf_remove(mapped_index, 11) == 0) {
+        fprintf(stderr, "Test failed: Mapped IVF index must hold every row and be read-only.\n");
+        exit(1);
+    }
+    for (int q = 0; q < db_size; q += 101) {
+        int found = fingerprint_identify_ivf(template_db[q], index, 4, 5, 2.0f, ids, scores);
+        int mapped_found = fingerprint_identify_ivf(template_db[q], mapped_index, 4, 5, 2.0f, mapped_ids, mapped_scores);
+        if (found != mapped_found || memcmp(ids, mapped_ids, found * sizeof(int64_t)) != 0) {
+            fprintf(stderr, "Test failed: Mapped IVF search differs for query %d.\n", q);
+            exit(1);
+        }
+    }
+
+    // A plain gallery file has no index; a truncated file is rejected
+    FILE* file = fopen(gallery_path, "r+b");
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    if (map_ivf_index(gallery_path, &mapped_index) == 0) {
+        fprintf(stderr, "Test failed: Gallery without index mapped as IVF.\n");
+        exit(1);
+    }
+    clean_gallery(mapped);
+    char* bytes = (char*)malloc(size);
+    file = fopen(gallery_path, "rb");
+    fread(bytes, 1, size, file);
+    fclose(file);
+    file = fopen(gallery_path, "wb");
+    fwrite(bytes, 1, size - 8, file);
+    fclose(file);
+    free(bytes);
+    if (map_gallery(gallery_path, &mapped) == 0) {
+        fprintf(stderr, "Test failed: Truncated gallery file was accepted.\n");
+        exit(1);
+    }
+    printf("Test passed: Gallery files map in place and match the in-memory gallery.\n");
+
+    remove(gallery_path);
+    remove(index_path);
+    free_template_db(template_db, db_size);
+    clean_ivf_index(index);
+    clean_ivf_index(mapped_index);
+    clean_gallery(gallery);
+}
+
+static void random_template(float* template_data, unsigned int* seed) {
+    for (int j = 0; j < 64; ++j) {
+        *seed = *seed * 1103515245u + 12345u;
+        template_data[j] = (float)((*seed >> 8) & 0xffff) / 65535.0f - 0.5f;
+    }
+}
+
+typedef struct LiveWriter {
+    LiveGallery* live;
+    int64_t first_id;
+    int count;
+} LiveWriter;
+
+static void live_append_thread(void* arg) {
+    LiveWriter* writer = (LiveWriter*)arg;
+    float template_data[64];
+    for (int i = 0; i < writer->count; ++i) {
+        unsigned int seed = (unsigned int)(writer->first_id + i);
+        random_template(template_data, &seed);
+        if (live_gallery_append(writer->live, template_data, writer->first_id + i) != 0) {
+            fprintf(stderr, "Error: Concurrent append failed\n");
+            exit(1);
+        }
+    }
+}
+
+static void live_delete_thread(void* arg) {
+    LiveWriter* writer = (LiveWriter*)arg;
+    for (int i = 0; i < writer->count; ++i) {
+        live_gallery_delete(writer->live, writer->first_id + 2 * i);
+    }
+}
+
+void test_live_gallery() {
+    int initial = 2 * LIVE_SEGMENT_ROWS + 100;  // Two full segments and a partial one
+    float template_data[64];
+    int64_t ids[1];
+    float scores[1];
+
+    LiveGallery* live = NULL;
+    if (create_live_gallery(1, &live) != 0) {
+        fprintf(stderr, "Test failed: Failed to create live gallery.\n");
+        exit(1);
+    }
+    for (int i = 0; i < initial; ++i) {
+        unsigned int seed = (unsigned int)i;
+        random_template(template_data, &seed);
+        live_gallery_append(live, template_data, i);
+    }
+
+    // Delete every third row of the first segment: enough to trigger compaction
+    for (int i = 0; i < LIVE_SEGMENT_ROWS; i += 3) {
+        if (live_gallery_delete(live, i) != 0) {
+            fprintf(stderr, "Test failed: Delete of id %d failed.\n", i);
+            exit(1);
+        }
+    }
+    if (live_gallery_delete(live, 0) == 0 || live_gallery_compact(live) != 0 ||
+        live_gallery_size(live) != initial - (LIVE_SEGMENT_ROWS + 2) / 3) {
+        fprintf(stderr, "Test failed: Live gallery size %d after deletes.\n", live_gallery_size(live));
+        exit(1);
+    }
+    for (int i = 0; i < initial; i += 37) {
+        unsigned int seed = (unsigned int)i;
+        random_template(template_data, &seed);
+        int found = fingerprint_identify_live(template_data, live, 1, 2.0f, ids, scores);
+        int deleted = i < LIVE_SEGMENT_ROWS && i % 3 == 0;
+        if (found != 1 || (deleted ? ids[0] == i : ids[0] != i)) {
+            fprintf(stderr, "Error: Live search for %d returned id %lld\n", i, (long long)ids[0]);
+            exit(1);
+        }
+    }
+
+    // Appends and deletes racing with searches
+    LiveWriter appender = { live, initial, 20000 };
+    LiveWriter deleter = { live, 1, 10000 };   // Odd ids 1..19999, none deleted yet
+    platform_thread append_thread, delete_thread;
+    thread_create(&append_thread, live_append_thread, &appender);
+    thread_create(&delete_thread, live_delete_thread, &deleter);
+    for (int i = 0; i < 200; ++i) {
+        unsigned int seed = (unsigned int)(LIVE_SEGMENT_ROWS + i);
+        random_template(template_data, &seed);
+        if (fingerprint_identify_live(template_data, live, 1, 2.0f, ids, scores) != 1 || ids[0] != LIVE_SEGMENT_ROWS + i) {
+            fprintf(stderr, "Error: Live search during updates returned id %lld\n", (long long)ids[0]);
+            exit(1);
+        }
+    }
+    thread_join(append_thread);
+    thread_join(delete_thread);
+
+    int expected = initial - (LIVE_SEGMENT_ROWS + 2) / 3 + 20000 - 10000 + 3333;  // 3333 odd multiples of 3 were already gone
+    if (live_gallery_size(live) != expected) {
+        fprintf(stderr, "Test failed: Live gallery size %d, expected %d.\n", live_gallery_size(live), expected);
+        exit(1);
+    }
+    for (int i = initial; i < initial + 20000; i += 97) {
+        unsigned int seed = (unsigned int)i;
+        random_template(template_data, &seed);
+        if (fingerprint_identify_live(template_data, live, 1, 2.0f, ids, scores) != 1 || ids[0] != i) {
+            fprintf(stderr, "Error: Concurrently appended id %d not found\n", i);
+            exit(1);
+        }
+    }
+    printf("Test passed: Live gallery appends, deletes and compacts under concurrent search.\n");
+
+    clean_live_gallery(live);
+}
+
+// Accuracy gate for a quantized model (tools/quantize_model.py) against its fp32 source
+#define QUANTIZED_MODEL_MAX_MEAN_DISTANCE 0.05f
+#define QUANTIZED_MODEL_MIN_RANK1 0.95f
+
+void test_stats() {
+    int db_size = 2000;
+    Gallery* gallery = NULL;
+    if (create_gallery(db_size, &gallery) != 0) {
+        fprintf(stderr, "Test failed: Failed to create gallery.\n");
+        exit(1);
+    }
+    float row[TEMPLATE_SIZE];
+    srand(3);
+    for (int i = 0; i < db_size; ++i) {
+        random_row(row, 1.0f);
+        add_to_gallery(gallery, row, i);
+    }
+
+    fingerprint_reset_stats();
+    int64_t ids[5];
+    float scores[5];
+    for (int q = 0; q < 3; ++q) {
+        fingerprint_identify_topk(gallery->templates + (size_t)q * TEMPLATE_SIZE, gallery, 5, 2.0f, ids, scores);
+    }
+    fingerprint_identify_topk(row, gallery, 0, 2.0f, ids, scores);  // Rejected calls are not counted
+
+    FingerprintStats stats;
+    if (fingerprint_get_stats(&stats) != 0) {
+        fprintf(stderr, "Test failed: fingerprint_get_stats failed.\n");
+        exit(1);
+    }
+    const StageStats* topk = &stats.stages[STATS_IDENTIFY_TOPK];
+    uint64_t expected_count = stats.enabled ? 3 : 0;
+    uint64_t in_histogram = 0;
+    for (int b = 0; b < STATS_BUCKETS; ++b) {
+        in_histogram += topk->histogram[b];
+    }
+    if (strcmp(topk->name, "fingerprint_identify_topk") != 0 || topk->count != expected_count ||
+        topk->items != expected_count * db_size || in_histogram != expected_count ||
+        stats.stages[STATS_INFERENCE].count != 0) {
+        fprintf(stderr, "Test failed: %s count %llu, items %llu, histogram %llu (stats %s)\n", topk->name,
+            (unsigned long long)topk->count, (unsigned long long)topk->items, (unsigned long long)in_histogram,
+            stats.enabled ? "enabled" : "disabled");
+        exit(1);
+    }
+    if (stats.enabled) {
+        printf("Top-K: %llu calls, mean %.1f us, p99 <= %llu ns\n", (unsigned long long)topk->count,
+            topk->total_ns / 1000.0 / topk->count, (unsigned long long)fingerprint_stats_quantile_ns(topk, 0.99));
+    }
+
+    // Quantiles resolve to the bucket upper bound, capped by the slowest call
+    StageStats stage;
+    memset(&stage, 0, sizeof(stage));
+    stage.count = 100;
+    stage.histogram[10] = 50;
+    stage.histogram[12] = 49;
+    stage.histogram[20] = 1;
+    stage.max_ns = 1500000;
+    if (fingerprint_stats_quantile_ns(&stage, 0.5) != 2048 || fingerprint_stats_quantile_ns(&stage, 0.99) != 8192 ||
+        fingerprint_stats_quantile_ns(&stage, 1.0) != 1500000) {
+        fprintf(stderr, "Test failed: Histogram quantiles\n");
+        exit(1);
+    }
+    printf("Test passed: Stage counters and histograms (%s).\n", stats.enabled ? "enabled" : "compiled out");
+
+    clean_gallery(gallery);
+}
+
+void test_quantized_model(const ORTCHAR_T* fp32_model_path, const ORTCHAR_T* int8_model_path) {
+    const int db_size = 30;
+    const ORTCHAR_T* model_paths[2] = { fp32_model_path, int8_model_path };
+    static float templates[2][30][64];
+    double ms_per_template[2];
+
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    for (int m = 0; m < 2; ++m) {
+        OrtEnv* env = NULL;
+        OrtSession* session = NULL;
+        if (load_model(g_ort, model_paths[m], &env, &session) != 0) {
+            fprintf(stderr, "Test failed: Failed to load model.\n");
+            exit(1);
+        }
+        uint64_t start = monotonic_ns();
+        for (int i = 0; i < db_size; ++i) {
+            if (generate_template(sample_images[i], g_ort, env, session, templates[m][i]) != 0) {
+                fprintf(stderr, "Failed to generate template for image: %s\n", sample_images[i]);
+                exit(1);
+            }
+        }
+        ms_per_template[m] = (monotonic_ns() - start) / 1e6 / db_size;
+        clean_model(g_ort, env, session);
+    }
+
+    // Drift of each template, and whether int8 probes still find their fp32 enrollment
+    float* fp32_db[30];
+    float* int8_db[30];
+    for (int i = 0; i < db_size; ++i) {
+        fp32_db[i] = templates[0][i];
+        int8_db[i] = templates[1][i];
+    }
+    float score[30], int8_score[30];
+    float mean_distance = 0.0f, max_distance = 0.0f;
+    int rank1 = 0, agree = 0;
+    for (int i = 0; i < db_size; ++i) {
+        float distance = template_distance(fp32_db[i], int8_db[i]);
+        mean_distance += distance / db_size;
+        if (distance > max_distance) max_distance = distance;
+
+        fingerprint_identification(int8_db[i], fp32_db, db_size, score);
+        int best = 0;
+        for (int j = 1; j < db_size; ++j) {
+            if (score[j] < score[best]) best = j;
+        }
+        rank1 += best == i;
+
+        // Nearest non-self neighbour in the all-vs-all run, per model
+        fingerprint_identification(fp32_db[i], fp32_db, db_size, score);
+        fingerprint_identification(int8_db[i], int8_db, db_size, int8_score);
+        int fp32_best = i == 0 ? 1 : 0, int8_best = i == 0 ? 1 : 0;
+        for (int j = 0; j < db_size; ++j) {
+            if (j == i) continue;
+            if (score[j] < score[fp32_best]) fp32_best = j;
+            if (int8_score[j] < int8_score[int8_best]) int8_best = j;
+        }
+        agree += fp32_best == int8_best;
+    }
+
+    printf("fp32 %.2f ms/template, int8 %.2f ms/template (%.2fx)\n",
+        ms_per_template[0], ms_per_template[1], ms_per_template[0] / ms_per_template[1]);
+    printf("fp32 vs int8 template distance: mean %.4f, max %.4f\n", mean_distance, max_distance);
+    printf("int8 probes vs fp32 gallery rank-1: %d/%d\n", rank1, db_size);
+    printf("All-vs-all nearest neighbour agreement with fp32: %d/%d\n", agree, db_size);
+    if (mean_distance > QUANTIZED_MODEL_MAX_MEAN_DISTANCE || rank1 < QUANTIZED_MODEL_MIN_RANK1 * db_size) {
+        fprintf(stderr, "Test failed: Quantized model is outside the accuracy gate.\n");
+        exit(1);
+    }
+    printf("Test passed: Quantized model is within the accuracy gate.\n");
+}
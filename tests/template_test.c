@@ -1,4 +1,10 @@
 #include "../template.h"
+#include "../enroll_pipeline.h"
+#include "../session_pool.h"
+#include "../model_registry.h"
+#include "../template_cache.h"
+#include "../platform.h"
+#include <string.h>
 
 // Compare the image data with the reference data byte by byte and log mismatches
 void compare_images_unit(unsigned char* img, unsigned char* raw_img, unsigned char* reference_data, long img_data_size) {
@@ -63,6 +69,121 @@ void compare_images_float(float* img, unsigned char* raw_img, float* reference_d
     }
 }
 
+// Direct 2D box filter over in-bounds taps, used as the reference for the separable version
+static void reference_box_filter(unsigned char* input_img, unsigned char* output_img, int width, int height, int box_size) {
+    int half_kernel = box_size / 2;
+    for (int i = 0; i < width * height * 3; i++) {
+        int x = (i / 3) % width, y = (i / 3) / width, c = i % 3;
+        int sum = 0, count = 0;
+        // Only the in-bounds part of the window, so large kernels stay cheap
+        for (int ny = y - half_kernel < 0 ? 0 : y - half_kernel; ny <= y + half_kernel && ny < height; ny++) {
+            for (int nx = x - half_kernel < 0 ? 0 : x - half_kernel; nx <= x + half_kernel && nx < width; nx++) {
+                sum += input_img[(ny * width + nx) * 3 + c];
+                count++;
+            }
+        }
+        output_img[i] = sum / count;
+    }
+}
+
+// Direct 2D Gaussian with double weights, used as the reference for the fixed-point version
+static void reference_gaussian_blur(unsigned char* input_img, unsigned char* output_img, int width, int height, int kernel_size) {
+    int radius = kernel_size / 2;
+    double sigma = kernel_size / 6.0;
+    double kernel[64];
+    double sum = 0.0;
+    for (int i = -radius; i <= radius; i++) {
+        kernel[i + radius] = exp(-(i * i) / (2 * sigma * sigma));
+        sum += kernel[i + radius];
+    }
+    for (int i = 0; i < width * height * 3; i++) {
+        int x = (i / 3) % width, y = (i / 3) / width, c = i % 3;
+        double value = 0.0;
+        for (int ny = y - radius < 0 ? 0 : y - radius; ny <= y + radius && ny < height; ny++) {
+            for (int nx = x - radius < 0 ? 0 : x - radius; nx <= x + radius && nx < width; nx++) {
+                value += input_img[(ny * width + nx) * 3 + c] * kernel[nx - x + radius] * kernel[ny - y + radius] / (sum * sum);
+            }
+        }
+        output_img[i] = (unsigned char)value;
+    }
+}
+
+void test_filters() {
+    const char* bmp_filename = "tests/samples/fingerprint_image.bmp";
+    unsigned char* img = NULL;
+    int width, height;
+
+    if (read_bmp_image(bmp_filename, &img, &width, &height) != 0) {
+        fprintf(stderr, "Failed to read BMP image.\n");
+        return;
+    }
+
+    long img_data_size = width * height * 3;
+    unsigned char* filtered_img = (unsigned char*)malloc(img_data_size);
+    unsigned char* reference_data = (unsigned char*)malloc(img_data_size);
+    if (filtered_img == NULL || reference_data == NULL) {
+        fprintf(stderr, "Failed to allocate memory for filtered image.\n");
+        exit(1);
+    }
+
+    // Separable box filter is exact
+    apply_box_filter(img, filtered_img, width, height, 3);
+    reference_box_filter(img, reference_data, width, height, 3);
+    compare_images_unit(filtered_img, NULL, reference_data, img_data_size);
+    printf("Test passed: Box filter matches the 2D reference.\n");
+
+    // Fixed-point Gaussian is within one gray level
+    gaussian_blur(img, filtered_img, width, height, 5);
+    reference_gaussian_blur(img, reference_data, width, height, 5);
+    compare_images_unit(filtered_img, NULL, reference_data, img_data_size);
+    printf("Test passed: Gaussian blur matches the 2D reference.\n");
+
+    free(img);
+    free(filtered_img);
+    free(reference_data);
+}
+
+// Large kernels on noise: a wide strip exercises the running horizontal sums, a tall one the vertical
+void test_filters_large_kernels() {
+    const int shapes[][2] = { { 300, 6 }, { 6, 300 }, { 100, 37 } };
+    const int box_sizes[] = { 17, 129, 257 };
+    const int gaussian_sizes[] = { 17, 33, 63 };
+
+    srand(7);
+    for (int s = 0; s < 3; s++) {
+        int width = shapes[s][0], height = shapes[s][1];
+        long img_data_size = (long)width * height * 3;
+        unsigned char* img = (unsigned char*)malloc(img_data_size);
+        unsigned char* filtered_img = (unsigned char*)malloc(img_data_size);
+        unsigned char* reference_data = (unsigned char*)malloc(img_data_size);
+        if (img == NULL || filtered_img == NULL || reference_data == NULL) {
+            fprintf(stderr, "Error: Memory allocation failed\n");
+            exit(1);
+        }
+        for (long i = 0; i < img_data_size; i++) {
+            img[i] = (unsigned char)(rand() % 256);
+        }
+
+        for (int k = 0; k < 3; k++) {
+            apply_box_filter(img, filtered_img, width, height, box_sizes[k]);
+            reference_box_filter(img, reference_data, width, height, box_sizes[k]);
+            if (memcmp(filtered_img, reference_data, img_data_size) != 0) {
+                fprintf(stderr, "Error: %dx%d box filter of size %d differs from the 2D reference\n", width, height, box_sizes[k]);
+                exit(1);
+            }
+
+            gaussian_blur(img, filtered_img, width, height, gaussian_sizes[k]);
+            reference_gaussian_blur(img, reference_data, width, height, gaussian_sizes[k]);
+            compare_images_unit(filtered_img, img, reference_data, img_data_size);
+        }
+
+        free(img);
+        free(filtered_img);
+        free(reference_data);
+    }
+    printf("Test passed: Box filters up to 257 taps and Gaussians up to 63 taps match the 2D references.\n");
+}
+
 void test_bmp_reader() {
     const char* bmp_filename = "tests/samples/fingerprint_image.bmp";
     const char* reference_filename = "tests/samples/bmp_reference.bin";
@@ -350,11 +471,359 @@ void test_preprocess_image() {
     free(reference_data);
 }
 
+void test_preprocess_image_fused() {
+    const char* bmp_filename = "tests/samples/fingerprint_image.bmp";
+    const char* reference_filename = "tests/samples/resized_and_normalized_image_reference.bin";
+    unsigned char* img = NULL;
+    int width, height;
+
+    if (read_bmp_image(bmp_filename, &img, &width, &height) != 0) {
+        fprintf(stderr, "Failed to read BMP image.\n");
+        return;
+    }
+
+    float* fused_img = (float*)malloc(3 * 224 * 224 * sizeof(float));
+    float* preprocessed_img = (float*)malloc(224 * 224 * 3 * sizeof(float));
+    float* reshaped_img = (float*)malloc(3 * 224 * 224 * sizeof(float));
+    if (fused_img == NULL || preprocessed_img == NULL || reshaped_img == NULL) {
+        fprintf(stderr, "Failed to allocate memory for preprocessed image.\n");
+        free(img);
+        return;
+    }
+
+    if (preprocess_image_fused(img, width, height, width * 3, 3, fused_img, 3, 224, 224) != 0) {
+        fprintf(stderr, "Test failed: Fused preprocessing returned an error.\n");
+        exit(1);
+    }
+
+    // Same values as the staged pipeline (resize -> normalize -> reshape)
+    preprocess_image(img, preprocessed_img, width, height, 224, 224);
+    reshape_image(preprocessed_img, reshaped_img, 224, 224, 3);
+    for (int i = 0; i < 3 * 224 * 224; i++) {
+        if (fused_img[i] != reshaped_img[i]) {
+            fprintf(stderr, "Error: Fused output differs from staged pipeline at %d: fused = %.6f, staged = %.6f\n",
+                i, fused_img[i], reshaped_img[i]);
+            exit(1);
+        }
+    }
+    printf("Fused output matches the staged pipeline.\n");
+
+    FILE* reference_file = fopen(reference_filename, "rb");
+    if (reference_file == NULL) {
+        fprintf(stderr, "Error: Failed to open reference file\n");
+        exit(1);
+    }
+    float* reference_data = (float*)malloc(224 * 224 * 3 * sizeof(float));
+    if (reference_data == NULL || fread(reference_data, sizeof(float), 224 * 224 * 3, reference_file) != 224 * 224 * 3) {
+        fprintf(stderr, "Error: Failed to read reference data\n");
+        exit(1);
+    }
+    fclose(reference_file);
+
+    // The reference is HWC, the fused output is CHW
+    for (int i = 0; i < 224 * 224; i++) {
+        for (int c = 0; c < 3; c++) {
+            preprocessed_img[i * 3 + c] = fused_img[c * 224 * 224 + i];
+        }
+    }
+    compare_images_float(preprocessed_img, img, reference_data, 224 * 224 * 3 * sizeof(float));
+    printf("Test passed: Fused preprocessing matches the reference.\n");
+
+    free(img);
+    free(fused_img);
+    free(preprocessed_img);
+    free(reshaped_img);
+    free(reference_data);
+}
+
+// The single-channel path must produce exactly what the RGB-expanded path produces
+void test_preprocess_image_gray() {
+    const char* bmp_filename = "tests/samples/fingerprint_image.bmp";
+    unsigned char* rgb_img = NULL;
+    unsigned char* gray_img = NULL;
+    int width, height, gray_width, gray_height;
+
+    if (read_bmp_image(bmp_filename, &rgb_img, &width, &height) != 0 ||
+        read_bmp_image_gray(bmp_filename, &gray_img, &gray_width, &gray_height) != 0) {
+        fprintf(stderr, "Failed to read BMP image.\n");
+        exit(1);
+    }
+    if (width != gray_width || height != gray_height) {
+        fprintf(stderr, "Error: Gray image size %dx%d does not match RGB size %dx%d\n", gray_width, gray_height, width, height);
+        exit(1);
+    }
+    for (int i = 0; i < width * height; i++) {
+        if (gray_img[i] != rgb_img[i * 3]) {
+            fprintf(stderr, "Error: Gray pixel %d = %u, RGB pixel = %u\n", i, gray_img[i], rgb_img[i * 3]);
+            exit(1);
+        }
+    }
+
+    float* rgb_tensor = (float*)malloc(3 * 224 * 224 * sizeof(float));
+    float* gray_tensor = (float*)malloc(3 * 224 * 224 * sizeof(float));
+    if (rgb_tensor == NULL || gray_tensor == NULL) {
+        fprintf(stderr, "Failed to allocate memory for input tensors.\n");
+        exit(1);
+    }
+    preprocess_image_fused(rgb_img, width, height, width * 3, 3, rgb_tensor, 3, 224, 224);
+    preprocess_image_fused(gray_img, width, height, width, 1, gray_tensor, 3, 224, 224);
+    for (int i = 0; i < 3 * 224 * 224; i++) {
+        if (rgb_tensor[i] != gray_tensor[i]) {
+            fprintf(stderr, "Error: Gray tensor differs at %d: gray = %.6f, rgb = %.6f\n", i, gray_tensor[i], rgb_tensor[i]);
+            exit(1);
+        }
+    }
+    printf("Test passed: Grayscale preprocessing matches the RGB path.\n");
+
+    free(rgb_img);
+    free(gray_img);
+    free(rgb_tensor);
+    free(gray_tensor);
+}
+
+// Whole file in one malloc'd buffer, as a capture SDK or socket would hand it over
+static unsigned char* read_file_bytes(const char* filename, size_t* size) {
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char* data = (unsigned char*)malloc(length > 0 ? length : 1);
+    if (data != NULL && fread(data, 1, length, file) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    *size = (size_t)length;
+    return data;
+}
+
+// In-memory decoding must honour row order and reject malformed headers
+void test_bmp_decode() {
+    const char* bmp_filename = "tests/samples/fingerprint_image.bmp";
+    size_t size;
+    unsigned char* data = read_file_bytes(bmp_filename, &size);
+    unsigned char* gray_img = NULL;
+    int width, height;
+    if (data == NULL || read_bmp_image_gray(bmp_filename, &gray_img, &width, &height) != 0) {
+        fprintf(stderr, "Failed to read BMP image.\n");
+        exit(1);
+    }
+
+    BmpView view;
+    if (decode_bmp(data, size, &view) != 0 || view.width != width || view.height != height) {
+        fprintf(stderr, "Error: decode_bmp failed on %s\n", bmp_filename);
+        exit(1);
+    }
+    for (int y = 0; y < height; y++) {
+        if (memcmp(view.pixels + y * view.stride, gray_img + (size_t)y * width, width) != 0) {
+            fprintf(stderr, "Error: Decoded row %d does not match read_bmp_image_gray\n", y);
+            exit(1);
+        }
+    }
+
+    // Re-store the rows in the opposite order and flip the sign of the height: the view must not change
+    unsigned char* flipped = (unsigned char*)malloc(size);
+    if (flipped == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(flipped, data, size);
+    uint32_t pixel_offset = data[10] | (data[11] << 8) | (data[12] << 16) | ((uint32_t)data[13] << 24);
+    size_t row_size = view.stride < 0 ? (size_t)-view.stride : (size_t)view.stride;
+    for (int y = 0; y < height; y++) {
+        memcpy(flipped + pixel_offset + (size_t)y * row_size, data + pixel_offset + (size_t)(height - 1 - y) * row_size, row_size);
+    }
+    int32_t stored_height = (int32_t)(data[22] | (data[23] << 8) | (data[24] << 16) | ((uint32_t)data[25] << 24));
+    stored_height = -stored_height;
+    memcpy(flipped + 22, &stored_height, 4);
+
+    BmpView flipped_view;
+    if (decode_bmp(flipped, size, &flipped_view) != 0 || flipped_view.height != height ||
+        (flipped_view.stride < 0) == (view.stride < 0)) {
+        fprintf(stderr, "Error: decode_bmp failed on the row-flipped copy\n");
+        exit(1);
+    }
+    for (int y = 0; y < height; y++) {
+        if (memcmp(flipped_view.pixels + y * flipped_view.stride, gray_img + (size_t)y * width, width) != 0) {
+            fprintf(stderr, "Error: Row-flipped copy decodes differently at row %d\n", y);
+            exit(1);
+        }
+    }
+
+    // Truncated pixel data, wrong bit depth and compressed files are rejected
+    memcpy(flipped, data, size);
+    flipped[28] = 24;
+    if (decode_bmp(data, pixel_offset + row_size * height - 1, &view) == 0 || decode_bmp(flipped, size, &view) == 0) {
+        fprintf(stderr, "Error: decode_bmp accepted a malformed header\n");
+        exit(1);
+    }
+    memcpy(flipped, data, size);
+    flipped[30] = 1;
+    if (decode_bmp(flipped, size, &view) == 0) {
+        fprintf(stderr, "Error: decode_bmp accepted a compressed file\n");
+        exit(1);
+    }
+    printf("Test passed: In-memory BMP decoding matches the file reader in both row orders.\n");
+
+    free(data);
+    free(flipped);
+    free(gray_img);
+}
+
+#define TEMPLATE_CACHE_TEST_THREADS 4
+
+// Fills a template from its key so a hit can be checked against the image it was looked up for
+static void template_for_key(const TemplateCacheKey* key, float* template_data) {
+    for (int i = 0; i < TEMPLATE_SIZE; i++) {
+        template_data[i] = (float)((key->hi >> (i % 64)) & 0xff) + (float)(key->lo & 0xf);
+    }
+}
+
+static void cache_key_of(int image, TemplateCacheKey* key) {
+    unsigned char pixels[64];
+    for (int i = 0; i < 64; i++) {
+        pixels[i] = (unsigned char)(image * 31 + i * 7);
+    }
+    BmpView view = { pixels, 8, 8, 8 };
+    *key = template_cache_key(&view, 1);
+}
+
+typedef struct CacheWorker {
+    TemplateCache* cache;
+    int seed;
+    int failed;
+} CacheWorker;
+
+static void template_cache_worker(void* arg) {
+    CacheWorker* worker = (CacheWorker*)arg;
+    unsigned int state = (unsigned int)worker->seed;
+    float expected[TEMPLATE_SIZE];
+    float found[TEMPLATE_SIZE];
+    for (int i = 0; i < 20000; i++) {
+        state = state * 1103515245u + 12345u;
+        TemplateCacheKey key;
+        cache_key_of((int)((state >> 16) % 96), &key);
+        template_for_key(&key, expected);
+        if (template_cache_lookup(worker->cache, &key, found)) {
+            if (memcmp(found, expected, sizeof(found)) != 0) worker->failed = 1;
+        }
+        else {
+            template_cache_insert(worker->cache, &key, expected);
+        }
+    }
+}
+
+void test_template_cache() {
+    // Key: same pixels whatever the row order in memory or the stride; the model and content change it
+    int width = 37, height = 29, stride = 40;
+    unsigned char* top_down = (unsigned char*)malloc((size_t)stride * height);
+    unsigned char* bottom_up = (unsigned char*)malloc((size_t)width * height);
+    if (top_down == NULL || bottom_up == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        exit(1);
+    }
+    srand(5);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < stride; x++) {
+            top_down[y * stride + x] = (unsigned char)(x < width ? rand() % 256 : 0xee);
+        }
+        memcpy(bottom_up + (size_t)(height - 1 - y) * width, top_down + (size_t)y * stride, width);
+    }
+    BmpView view = { top_down, width, height, stride };
+    BmpView flipped = { bottom_up + (size_t)(height - 1) * width, width, height, -width };
+    TemplateCacheKey key = template_cache_key(&view, 1);
+    TemplateCacheKey same = template_cache_key(&flipped, 1);
+    TemplateCacheKey other_model = template_cache_key(&view, 2);
+    top_down[5 * stride + 11] ^= 1;
+    TemplateCacheKey other_pixels = template_cache_key(&view, 1);
+    if (key.hi != same.hi || key.lo != same.lo || (key.hi == other_model.hi && key.lo == other_model.lo) ||
+        (key.hi == other_pixels.hi && key.lo == other_pixels.lo)) {
+        fprintf(stderr, "Test failed: Cache keys do not follow the pixels and model\n");
+        exit(1);
+    }
+    free(top_down);
+    free(bottom_up);
+
+    // LRU order in a single shard: a hit refreshes an entry, the oldest one is evicted
+    TemplateCache* cache = NULL;
+    if (create_template_cache(4, 1, &cache) != 0) {
+        fprintf(stderr, "Test failed: Failed to create the template cache.\n");
+        exit(1);
+    }
+    TemplateCacheKey keys[5];
+    float template_data[TEMPLATE_SIZE];
+    for (int i = 0; i < 5; i++) {
+        cache_key_of(i, &keys[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        template_for_key(&keys[i], template_data);
+        template_cache_insert(cache, &keys[i], template_data);
+    }
+    template_cache_lookup(cache, &keys[0], template_data);
+    template_for_key(&keys[4], template_data);
+    template_cache_insert(cache, &keys[4], template_data);
+
+    float found[TEMPLATE_SIZE];
+    int hits[5];
+    for (int i = 0; i < 5; i++) {
+        hits[i] = template_cache_lookup(cache, &keys[i], found);
+        template_for_key(&keys[i], template_data);
+        if (hits[i] && memcmp(found, template_data, sizeof(found)) != 0) {
+            fprintf(stderr, "Test failed: Cache returned the wrong template for entry %d\n", i);
+            exit(1);
+        }
+    }
+    TemplateCacheStats stats;
+    template_cache_get_stats(cache, &stats);
+    if (!hits[0] || hits[1] || !hits[2] || !hits[3] || !hits[4] || stats.hits != 5 || stats.misses != 1 ||
+        stats.evictions != 1 || stats.size != 4 || stats.capacity != 4) {
+        fprintf(stderr, "Test failed: LRU hits %d%d%d%d%d, %llu hits, %llu misses, %llu evictions\n",
+            hits[0], hits[1], hits[2], hits[3], hits[4], (unsigned long long)stats.hits,
+            (unsigned long long)stats.misses, (unsigned long long)stats.evictions);
+        exit(1);
+    }
+    clean_template_cache(cache);
+
+    // Sharded cache under concurrent lookups and inserts of an over-capacity working set
+    if (create_template_cache(64, 8, &cache) != 0) {
+        fprintf(stderr, "Test failed: Failed to create the template cache.\n");
+        exit(1);
+    }
+    CacheWorker workers[TEMPLATE_CACHE_TEST_THREADS];
+    platform_thread threads[TEMPLATE_CACHE_TEST_THREADS];
+    for (int t = 0; t < TEMPLATE_CACHE_TEST_THREADS; t++) {
+        workers[t].cache = cache;
+        workers[t].seed = t + 1;
+        workers[t].failed = 0;
+        if (thread_create(&threads[t], template_cache_worker, &workers[t]) != 0) {
+            fprintf(stderr, "Test failed: Failed to start cache thread.\n");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < TEMPLATE_CACHE_TEST_THREADS; t++) {
+        thread_join(threads[t]);
+        if (workers[t].failed) {
+            fprintf(stderr, "Test failed: Cache thread %d read a template that does not match its key\n", t);
+            exit(1);
+        }
+    }
+    template_cache_get_stats(cache, &stats);
+    if (stats.hits + stats.misses != (uint64_t)TEMPLATE_CACHE_TEST_THREADS * 20000 || stats.size > stats.capacity ||
+        stats.capacity != 64 || stats.insertions - stats.evictions != (uint64_t)stats.size) {
+        fprintf(stderr, "Test failed: Inconsistent cache counters after concurrent use\n");
+        exit(1);
+    }
+    printf("Test passed: Template cache keys, LRU eviction and %llu concurrent lookups (%.0f%% hits).\n",
+        (unsigned long long)(stats.hits + stats.misses), 100.0 * stats.hits / (stats.hits + stats.misses));
+    clean_template_cache(cache);
+}
+
 void test_load_model(const ORTCHAR_T* model_path) {
     const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
     if (g_ort == NULL) {
         fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
-        return -1;
+        return;
     }
 
     if (model_path == NULL) {
@@ -373,8 +842,14 @@ void test_load_model(const ORTCHAR_T* model_path) {
 
     // Check input and output dimensions
     size_t num_input_nodes, num_output_nodes;
-    ORT_ABORT_ON_ERROR(g_ort->SessionGetInputCount(session, &num_input_nodes), g_ort);
-    ORT_ABORT_ON_ERROR(g_ort->SessionGetOutputCount(session, &num_output_nodes), g_ort);
+    OrtStatus* status = g_ort->SessionGetInputCount(session, &num_input_nodes);
+    if (status == NULL) status = g_ort->SessionGetOutputCount(session, &num_output_nodes);
+    if (status != NULL) {
+        fprintf(stderr, "Test failed: %s\n", g_ort->GetErrorMessage(status));
+        g_ort->ReleaseStatus(status);
+        clean_model(g_ort, env, session);
+        exit(1);
+    }
 
     printf("Model loaded successfully.\n");
     printf("Number of inputs: %zu\n", num_input_nodes);
@@ -420,7 +895,7 @@ void test_run_model(const ORTCHAR_T* model_path, const char* image1, const char*
     float* preprocessed_data2 = (float*)malloc(224 * 224 * 3 * sizeof(float));
     float* input_data1 = (float*)malloc(3 * 224 * 224 * sizeof(float));
     float* input_data2 = (float*)malloc(3 * 224 * 224 * sizeof(float));
-    size_t input_height, input_width;
+    int input_height, input_width;
 
     if (read_bmp_image(image1, &raw_data1, &input_width, &input_height) != 0) {
         fprintf(stderr, "Failed to load fingerprint image 1.\n");
@@ -513,7 +988,523 @@ void test_generate_template(const ORTCHAR_T* model_path, const char* image_filen
         printf("Failed to generate template.\n");
     }
 
+    // The same file handed over as a memory buffer must give the same template
+    size_t size;
+    unsigned char* data = read_file_bytes(image_filename, &size);
+    float buffer_template[64];
+    if (data == NULL || generate_template_from_buffer(data, size, g_ort, env, session, buffer_template) != 0 ||
+        memcmp(buffer_template, template, sizeof(buffer_template)) != 0) {
+        fprintf(stderr, "Test failed: Template from buffer differs from the file template.\n");
+        exit(1);
+    }
+    printf("Template from buffer matches the file template.\n");
+    free(data);
+
+    // A raw frame (what a scanner hands over) bypasses BMP entirely and must agree too
+    unsigned char* gray_img = NULL;
+    int width, height;
+    float pixels_template[64];
+    if (read_bmp_image_gray(image_filename, &gray_img, &width, &height) != 0 ||
+        generate_template_from_pixels(gray_img, width, height, width, g_ort, env, session, pixels_template) != 0 ||
+        memcmp(pixels_template, template, sizeof(pixels_template)) != 0) {
+        fprintf(stderr, "Test failed: Template from pixels differs from the file template.\n");
+        exit(1);
+    }
+    printf("Template from pixels matches the file template.\n");
+    free(gray_img);
+
     // Clean up
     free(template);
     clean_model(g_ort, env, session);
 }
+
+// The single-tower export must reproduce the Siamese model's first output
+void test_single_tower_template(const ORTCHAR_T* siamese_model_path, const ORTCHAR_T* single_model_path, const char* image_filename) {
+
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+    OrtEnv* siamese_env = NULL;
+    OrtSession* siamese_session = NULL;
+    OrtEnv* single_env = NULL;
+    OrtSession* single_session = NULL;
+
+    if (load_model(g_ort, siamese_model_path, &siamese_env, &siamese_session) != 0) {
+        fprintf(stderr, "Test failed: Failed to load Siamese model.\n");
+        return;
+    }
+    if (load_model(g_ort, single_model_path, &single_env, &single_session) != 0) {
+        fprintf(stderr, "Test failed: Failed to load single-tower model.\n");
+        clean_model(g_ort, siamese_env, siamese_session);
+        return;
+    }
+
+    if (!is_single_tower_model(g_ort, single_session)) {
+        fprintf(stderr, "Test failed: Single-tower model has more than one input.\n");
+        exit(1);
+    }
+
+    float siamese_template[64];
+    float single_template[64];
+    if (generate_template(image_filename, g_ort, siamese_env, siamese_session, siamese_template) != 0 ||
+        generate_template(image_filename, g_ort, single_env, single_session, single_template) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate template.\n");
+        exit(1);
+    }
+
+    float tolerance = 1e-4f;
+    for (int i = 0; i < 64; i++) {
+        if (fabs(siamese_template[i] - single_template[i]) > tolerance) {
+            fprintf(stderr, "Error: Template mismatch at %d: siamese = %.6f, single = %.6f\n",
+                i, siamese_template[i], single_template[i]);
+            exit(1);
+        }
+    }
+    printf("Test passed: Single-tower template matches the Siamese model.\n");
+
+    clean_model(g_ort, siamese_env, siamese_session);
+    clean_model(g_ort, single_env, single_session);
+}
+
+// Batched generation must match per-image generate_template
+void test_generate_templates_batch(const ORTCHAR_T* model_path, const char** image_filenames, int num_images) {
+
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+    OrtEnv* env = NULL;
+    OrtSession* session = NULL;
+    if (load_model(g_ort, model_path, &env, &session) != 0) {
+        fprintf(stderr, "Test failed: Failed to load model.\n");
+        return;
+    }
+
+    float* batch_templates = (float*)malloc(num_images * 64 * sizeof(float));
+    if (batch_templates == NULL) {
+        fprintf(stderr, "Memory allocation failed for batch_templates.\n");
+        clean_model(g_ort, env, session);
+        return;
+    }
+
+    printf("Model batch capacity: %d\n", model_batch_capacity(g_ort, session));
+    if (generate_templates_batch(image_filenames, num_images, g_ort, env, session, batch_templates) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate batched templates.\n");
+        exit(1);
+    }
+
+    float template[64];
+    float tolerance = 1e-4f;
+    for (int i = 0; i < num_images; i++) {
+        if (generate_template(image_filenames[i], g_ort, env, session, template) != 0) {
+            fprintf(stderr, "Test failed: Failed to generate template for %s.\n", image_filenames[i]);
+            exit(1);
+        }
+        for (int j = 0; j < 64; j++) {
+            if (fabs(template[j] - batch_templates[i * 64 + j]) > tolerance) {
+                fprintf(stderr, "Error: Batched template %d mismatch at %d: single = %.6f, batch = %.6f\n",
+                    i, j, template[j], batch_templates[i * 64 + j]);
+                exit(1);
+            }
+        }
+    }
+    printf("Test passed: Batched templates match per-image templates.\n");
+
+    free(batch_templates);
+    clean_model(g_ort, env, session);
+}
+
+// The persistent context path must match generate_template, including on repeated calls
+void test_generate_template_with_context(const ORTCHAR_T* model_path, const char* image_filename) {
+
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+    OrtEnv* env = NULL;
+    OrtSession* session = NULL;
+    if (load_model(g_ort, model_path, &env, &session) != 0) {
+        fprintf(stderr, "Test failed: Failed to load model.\n");
+        return;
+    }
+
+    FingerprintContext* ctx = NULL;
+    if (create_context(g_ort, session, 4, &ctx) != 0) {
+        fprintf(stderr, "Test failed: Failed to create context.\n");
+        clean_model(g_ort, env, session);
+        return;
+    }
+
+    float reference[64];
+    float template[64];
+    if (generate_template(image_filename, g_ort, env, session, reference) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate template.\n");
+        exit(1);
+    }
+
+    float tolerance = 1e-4f;
+    for (int run = 0; run < 3; run++) {
+        if (generate_template_with_context(ctx, image_filename, template) != 0) {
+            fprintf(stderr, "Test failed: Failed to generate template with context.\n");
+            exit(1);
+        }
+        for (int i = 0; i < 64; i++) {
+            if (fabs(reference[i] - template[i]) > tolerance) {
+                fprintf(stderr, "Error: Context template mismatch at %d (run %d): reference = %.6f, context = %.6f\n",
+                    i, run, reference[i], template[i]);
+                exit(1);
+            }
+        }
+    }
+    printf("Test passed: Context templates match generate_template.\n");
+
+    clean_context(ctx);
+    clean_model(g_ort, env, session);
+}
+
+#define ENROLL_TEST_ROUNDS 8
+
+static void collect_template(void* user_data, int64_t id, int status, const float* template_data) {
+    float* templates = (float*)user_data;
+    if (status != 0) {
+        fprintf(stderr, "Error: Enrollment of request %lld failed\n", (long long)id);
+        exit(1);
+    }
+    memcpy(templates + id * 64, template_data, 64 * sizeof(float));
+}
+
+// The pipelined engine must produce generate_template's output for every request and store each one
+void test_enroll_pipeline(const ORTCHAR_T* model_path, const char** image_filenames, int num_images) {
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+    OrtEnv* env = NULL;
+    OrtSession* session = NULL;
+    if (load_model(g_ort, model_path, &env, &session) != 0) {
+        fprintf(stderr, "Test failed: Failed to load model.\n");
+        return;
+    }
+
+    int num_requests = ENROLL_TEST_ROUNDS * num_images;
+    float* templates = (float*)malloc((size_t)num_requests * 64 * sizeof(float));
+    LiveGallery* live = NULL;
+    EnrollPipeline* pipeline = NULL;
+    EnrollConfig config = { 0 };
+    config.max_batch = 4;
+    if (templates == NULL || create_live_gallery(0, &live) != 0 ||
+        create_enroll_pipeline(g_ort, session, &config, live, collect_template, templates, &pipeline) != 0) {
+        fprintf(stderr, "Test failed: Failed to create the enrollment pipeline.\n");
+        exit(1);
+    }
+
+    for (int r = 0; r < num_requests; r++) {
+        if (enroll_submit(pipeline, image_filenames[r % num_images], r) != 0) {
+            fprintf(stderr, "Test failed: Failed to submit request %d.\n", r);
+            exit(1);
+        }
+    }
+    enroll_wait(pipeline);
+    if (live_gallery_size(live) != num_requests) {
+        fprintf(stderr, "Error: Live gallery holds %d templates, expected %d\n", live_gallery_size(live), num_requests);
+        exit(1);
+    }
+
+    float template[64];
+    for (int i = 0; i < num_images; i++) {
+        if (generate_template(image_filenames[i], g_ort, env, session, template) != 0) {
+            fprintf(stderr, "Test failed: Failed to generate template for %s.\n", image_filenames[i]);
+            exit(1);
+        }
+        for (int r = i; r < num_requests; r += num_images) {
+            for (int j = 0; j < 64; j++) {
+                if (fabs(template[j] - templates[r * 64 + j]) > 1e-4f) {
+                    fprintf(stderr, "Error: Pipelined template %d mismatch at %d: single = %.6f, pipeline = %.6f\n",
+                        r, j, template[j], templates[r * 64 + j]);
+                    exit(1);
+                }
+            }
+        }
+    }
+    printf("Test passed: %d pipelined enrollments match generate_template.\n", num_requests);
+
+    clean_enroll_pipeline(pipeline);
+    clean_live_gallery(live);
+    free(templates);
+    clean_model(g_ort, env, session);
+}
+
+#define SESSION_POOL_TEST_THREADS 4
+#define SESSION_POOL_TEST_CALLS 4
+
+typedef struct SessionPoolRequest {
+    SessionPool* pool;
+    const char* image_filename;
+    float templates[SESSION_POOL_TEST_CALLS][64];
+    int failed;
+} SessionPoolRequest;
+
+static void session_pool_request(void* arg) {
+    SessionPoolRequest* request = (SessionPoolRequest*)arg;
+    for (int i = 0; i < SESSION_POOL_TEST_CALLS; i++) {
+        if (session_pool_generate_template(request->pool, request->image_filename, request->templates[i]) != 0) {
+            request->failed = 1;
+        }
+    }
+}
+
+// More request threads than contexts, on shared global ORT pools, must all get generate_template's output
+void test_session_pool(const ORTCHAR_T* model_path, const char* image_filename) {
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+    ModelOptions options = { 0 };
+    options.intra_op_threads = 2;
+    options.global_thread_pools = 1;
+    options.disable_spinning = 1;
+    SessionPool* pool = NULL;
+    if (create_session_pool(g_ort, model_path, &options, 2, &pool) != 0) {
+        fprintf(stderr, "Test failed: Failed to create the session pool.\n");
+        exit(1);
+    }
+
+    float template[64];
+    FingerprintContext* ctx = session_pool_acquire(pool);
+    if (generate_template_with_context(ctx, image_filename, template) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate the reference template.\n");
+        exit(1);
+    }
+    session_pool_release(pool, ctx);
+
+    // A repeated capture is answered from the template cache, through a context or the plain entry point
+    TemplateCache* cache = NULL;
+    float cached[3][64];
+    ctx = session_pool_acquire(pool);
+    if (create_template_cache(16, 0, &cache) != 0 ||
+        generate_template_with_context_cached(cache, ctx, image_filename, cached[0]) != 0 ||
+        generate_template_with_context_cached(cache, ctx, image_filename, cached[1]) != 0 ||
+        generate_template_cached(cache, image_filename, g_ort, NULL, context_session(ctx), cached[2]) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate cached templates.\n");
+        exit(1);
+    }
+    session_pool_release(pool, ctx);
+    TemplateCacheStats cache_stats;
+    template_cache_get_stats(cache, &cache_stats);
+    if (memcmp(cached[0], template, sizeof(template)) != 0 || memcmp(cached[1], template, sizeof(template)) != 0 ||
+        memcmp(cached[2], template, sizeof(template)) != 0 || cache_stats.hits != 2 || cache_stats.misses != 1) {
+        fprintf(stderr, "Test failed: Cached templates differ or the repeat was not a hit\n");
+        exit(1);
+    }
+    clean_template_cache(cache);
+
+    static SessionPoolRequest requests[SESSION_POOL_TEST_THREADS];
+    platform_thread threads[SESSION_POOL_TEST_THREADS];
+    for (int t = 0; t < SESSION_POOL_TEST_THREADS; t++) {
+        requests[t].pool = pool;
+        requests[t].image_filename = image_filename;
+        requests[t].failed = 0;
+        if (thread_create(&threads[t], session_pool_request, &requests[t]) != 0) {
+            fprintf(stderr, "Test failed: Failed to start request thread.\n");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < SESSION_POOL_TEST_THREADS; t++) {
+        thread_join(threads[t]);
+    }
+
+    for (int t = 0; t < SESSION_POOL_TEST_THREADS; t++) {
+        for (int i = 0; i < SESSION_POOL_TEST_CALLS; i++) {
+            if (requests[t].failed || memcmp(requests[t].templates[i], template, sizeof(template)) != 0) {
+                fprintf(stderr, "Error: Request thread %d call %d produced a different template\n", t, i);
+                exit(1);
+            }
+        }
+    }
+    printf("Test passed: %d concurrent requests match the single-threaded template.\n",
+        SESSION_POOL_TEST_THREADS * SESSION_POOL_TEST_CALLS);
+
+    clean_session_pool(pool);
+}
+
+// Versions of one file share a session; a hot swap leaves in-flight handles usable
+// Byte copy of a model file, so the registry test can rewrite a path of its own
+static int copy_model_file(const ORTCHAR_T* from, const ORTCHAR_T* to) {
+#ifdef _WIN32
+    FILE* in = _wfopen(from, L"rb");
+    FILE* out = in != NULL ? _wfopen(to, L"wb") : NULL;
+#else
+    FILE* in = fopen(from, "rb");
+    FILE* out = in != NULL ? fopen(to, "wb") : NULL;
+#endif
+    int result = in != NULL && out != NULL ? 0 : -1;
+    char buffer[65536];
+    size_t read;
+    while (result == 0 && (read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        if (fwrite(buffer, 1, read, out) != read) result = -1;
+    }
+    if (in != NULL) fclose(in);
+    if (out != NULL && fclose(out) != 0) result = -1;
+    return result;
+}
+
+// swap_path is rewritten from single_model_path to siamese_model_path between two loads
+void test_model_registry(const ORTCHAR_T* single_model_path, const ORTCHAR_T* siamese_model_path, const ORTCHAR_T* swap_path,
+    const char* image_filename) {
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+    ModelRegistry* registry = NULL;
+    if (copy_model_file(single_model_path, swap_path) != 0 || create_model_registry(g_ort, NULL, &registry) != 0 ||
+        registry_load(registry, "deit", "v1", swap_path) != 0 || registry_load(registry, "quality", "v1", swap_path) != 0) {
+        fprintf(stderr, "Test failed: Failed to load the model into the registry.\n");
+        exit(1);
+    }
+
+    ModelHandle* v1 = registry_acquire(registry, "deit", NULL);
+    ModelHandle* quality = registry_acquire(registry, "quality", NULL);
+    float template_v1[64];
+    if (v1 == NULL || quality == NULL ||
+        generate_template(image_filename, g_ort, registry_env(registry), model_handle_session(v1), template_v1) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate a template from the registry model.\n");
+        exit(1);
+    }
+    // An unchanged file is loaded once
+    if (model_handle_session(quality) != model_handle_session(v1)) {
+        fprintf(stderr, "Error: Two entries loaded from the same unchanged file do not share the session\n");
+        exit(1);
+    }
+
+    // Same path, different model on disk: the new version must run the new file
+    if (copy_model_file(siamese_model_path, swap_path) != 0 || registry_load(registry, "deit", "v2", swap_path) != 0) {
+        fprintf(stderr, "Test failed: Failed to hot-swap the model.\n");
+        exit(1);
+    }
+    ModelHandle* v2 = registry_acquire(registry, "deit", NULL);
+    if (v2 == NULL || strcmp(model_handle_version(v2), "v2") != 0 || model_handle_session(v2) == model_handle_session(v1) ||
+        !is_single_tower_model(g_ort, model_handle_session(v1)) || is_single_tower_model(g_ort, model_handle_session(v2))) {
+        fprintf(stderr, "Error: The reloaded model is not current or still runs the replaced file\n");
+        exit(1);
+    }
+    float template_v2[64];
+    if (generate_template(image_filename, g_ort, registry_env(registry), model_handle_session(v2), template_v2) != 0) {
+        fprintf(stderr, "Test failed: Failed to generate a template from the swapped model.\n");
+        exit(1);
+    }
+    for (int j = 0; j < 64; j++) {
+        if (fabs(template_v1[j] - template_v2[j]) > 1e-4f) {
+            fprintf(stderr, "Error: Single-tower and siamese templates differ at %d: %.6f vs %.6f\n", j, template_v1[j], template_v2[j]);
+            exit(1);
+        }
+    }
+
+    // v1 was unloaded while still held; it must keep working until released
+    float template_held[64];
+    if (registry_unload(registry, "deit", "v1") != 0 ||
+        generate_template(image_filename, g_ort, registry_env(registry), model_handle_session(v1), template_held) != 0 ||
+        memcmp(template_v1, template_held, sizeof(template_v1)) != 0) {
+        fprintf(stderr, "Error: An unloaded but still acquired model stopped working\n");
+        exit(1);
+    }
+    printf("Test passed: Registry shares unchanged files, reloads replaced ones and hot-swaps without dropping holders.\n");
+
+    registry_release(registry, v1);
+    registry_release(registry, v2);
+    registry_release(registry, quality);
+    clean_model_registry(registry);
+#ifdef _WIN32
+    _wremove(swap_path);
+#else
+    remove(swap_path);
+#endif
+}
+
+// Cold start with and without the optimized-model cache; both sessions must agree. A stale
+// key (another source file or ORT build) must make the next load rebuild the cache
+void test_model_cache(const ORTCHAR_T* model_path, const ORTCHAR_T* cache_path, const ORTCHAR_T* key_path, const char* image_filename) {
+    const OrtApi* g_ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (g_ort == NULL) {
+        fprintf(stderr, "Test failed: Failed to initialize ONNX Runtime API.\n");
+        return;
+    }
+
+#ifdef _WIN32
+    _wremove(cache_path);
+#else
+    remove(cache_path);
+#endif
+
+    ModelOptions options = { 0 };
+    options.optimized_model_path = cache_path;
+    float templates[3][64];
+    double load_ms[3];
+    for (int pass = 0; pass < 3; pass++) {
+        if (pass == 2) {
+#ifdef _WIN32
+            FILE* key = _wfopen(key_path, L"wb");
+#else
+            FILE* key = fopen(key_path, "wb");
+#endif
+            if (key == NULL) {
+                fprintf(stderr, "Test failed: The cache key was not written.\n");
+                exit(1);
+            }
+            fputs("stale", key);
+            fclose(key);
+        }
+
+        OrtEnv* env = NULL;
+        OrtSession* session = NULL;
+        uint64_t start = monotonic_ns();
+        if (load_model_with_options(g_ort, model_path, &options, &env, &session) != 0) {
+            fprintf(stderr, "Test failed: Failed to load model (pass %d).\n", pass);
+            exit(1);
+        }
+        load_ms[pass] = (monotonic_ns() - start) / 1e6;
+        if (generate_template(image_filename, g_ort, env, session, templates[pass]) != 0) {
+            fprintf(stderr, "Test failed: Failed to generate template (pass %d).\n", pass);
+            exit(1);
+        }
+        clean_model(g_ort, env, session);
+    }
+
+    for (int pass = 1; pass < 3; pass++) {
+        for (int j = 0; j < 64; j++) {
+            if (fabs(templates[0][j] - templates[pass][j]) > 1e-4f) {
+                fprintf(stderr, "Error: Cached model template mismatch at %d (pass %d): source = %.6f, cached = %.6f\n",
+                    j, pass, templates[0][j], templates[pass][j]);
+                exit(1);
+            }
+        }
+    }
+
+    // The stale key was replaced by the rebuild
+#ifdef _WIN32
+    FILE* key = _wfopen(key_path, L"rb");
+#else
+    FILE* key = fopen(key_path, "rb");
+#endif
+    char stored[6] = { 0 };
+    if (key == NULL || fread(stored, 1, 5, key) != 5 || strcmp(stored, "stale") == 0) {
+        fprintf(stderr, "Error: A stale cache key was not rebuilt\n");
+        exit(1);
+    }
+    fclose(key);
+    printf("Cold start: %.1f ms optimizing the source model, %.1f ms from the cache, %.1f ms rebuilding after a stale key\n",
+        load_ms[0], load_ms[1], load_ms[2]);
+    printf("Test passed: Cached model matches the source model.\n");
+}
@@ -19,15 +19,39 @@ wchar_t* convert_to_wchar(const char* utf8_str) {
 #endif
 
 void test_cosine_similarity();
+void test_gallery_identification();
+void test_identify_topk();
+void test_parallel_identification();
+void test_batch_identification();
+void test_quantized_identification();
+void test_ivf_identification();
+void test_gallery_file();
+void test_live_gallery();
+void test_stats();
 void test_bmp_reader();
 void test_resize_image();
+void test_filters();
+void test_filters_large_kernels();
 void test_normalize_image();
 void test_preprocess_image();
+void test_preprocess_image_fused();
+void test_preprocess_image_gray();
+void test_bmp_decode();
+void test_template_cache();
 void test_load_model(const ORTCHAR_T* model_path);
 void test_run_model(const ORTCHAR_T* model_path, const char* image1, const char* image2, float* output_data1, float* output_data2);
 void test_verification(const float* embed1, const float* embed2);
 void test_generate_template(const ORTCHAR_T* model_path, const char* image_filename);
 void test_identification(const ORTCHAR_T* model_path);
+void test_quantized_model(const ORTCHAR_T* fp32_model_path, const ORTCHAR_T* int8_model_path);
+void test_single_tower_template(const ORTCHAR_T* siamese_model_path, const ORTCHAR_T* single_model_path, const char* image_filename);
+void test_generate_templates_batch(const ORTCHAR_T* model_path, const char** image_filenames, int num_images);
+void test_generate_template_with_context(const ORTCHAR_T* model_path, const char* image_filename);
+void test_enroll_pipeline(const ORTCHAR_T* model_path, const char** image_filenames, int num_images);
+void test_session_pool(const ORTCHAR_T* model_path, const char* image_filename);
+void test_model_registry(const ORTCHAR_T* single_model_path, const ORTCHAR_T* siamese_model_path, const ORTCHAR_T* swap_path,
+    const char* image_filename);
+void test_model_cache(const ORTCHAR_T* model_path, const ORTCHAR_T* cache_path, const ORTCHAR_T* key_path, const char* image_filename);
 
 // wrapper function for user function testers
 void test_helper_functions(const ORTCHAR_T* model_path) {
@@ -36,10 +60,58 @@ void test_helper_functions(const ORTCHAR_T* model_path) {
     test_cosine_similarity();
     printf("Completed test: Cosine Similarity\n\n");
 
+    printf("Running test: Gallery Identification\n");
+    test_gallery_identification();
+    printf("Completed test: Gallery Identification\n\n");
+
+    printf("Running test: Top-K Identification\n");
+    test_identify_topk();
+    printf("Completed test: Top-K Identification\n\n");
+
+    printf("Running test: Parallel Identification\n");
+    test_parallel_identification();
+    printf("Completed test: Parallel Identification\n\n");
+
+    printf("Running test: Batch Identification\n");
+    test_batch_identification();
+    printf("Completed test: Batch Identification\n\n");
+
+    printf("Running test: Quantized Identification\n");
+    test_quantized_identification();
+    printf("Completed test: Quantized Identification\n\n");
+
+    printf("Running test: IVF Identification\n");
+    test_ivf_identification();
+    printf("Completed test: IVF Identification\n\n");
+
+    printf("Running test: Gallery File\n");
+    test_gallery_file();
+    printf("Completed test: Gallery File\n\n");
+
+    printf("Running test: Live Gallery\n");
+    test_live_gallery();
+    printf("Completed test: Live Gallery\n\n");
+
+    printf("Running test: Stage Statistics\n");
+    test_stats();
+    printf("Completed test: Stage Statistics\n\n");
+
+    printf("Running test: Template Cache\n");
+    test_template_cache();
+    printf("Completed test: Template Cache\n\n");
+
+    printf("Running test: Large Filter Kernels\n");
+    test_filters_large_kernels();
+    printf("Completed test: Large Filter Kernels\n\n");
+
     printf("Running test: BMP Reader\n");
     test_bmp_reader();
     printf("Completed test: BMP Reader\n\n");
 
+    printf("Running test: Box Filter and Gaussian Blur\n");
+    test_filters();
+    printf("Completed test: Box Filter and Gaussian Blur\n\n");
+
     printf("Running test: Resize Image\n");
     test_resize_image();
     printf("Completed test: Resize Image\n\n");
@@ -52,10 +124,20 @@ void test_helper_functions(const ORTCHAR_T* model_path) {
     test_preprocess_image();
     printf("Completed test: Preprocess Image\n\n");
 
-    return 0;
+    printf("Running test: Fused Preprocess Image\n");
+    test_preprocess_image_fused();
+    printf("Completed test: Fused Preprocess Image\n\n");
+
+    printf("Running test: Grayscale Preprocess Image\n");
+    test_preprocess_image_gray();
+    printf("Completed test: Grayscale Preprocess Image\n\n");
+
+    printf("Running test: BMP Decode From Memory\n");
+    test_bmp_decode();
+    printf("Completed test: BMP Decode From Memory\n\n");
 }
 
-void test_api_functions(const ORTCHAR_T* model_path) {
+void test_api_functions(const ORTCHAR_T* model_path, const ORTCHAR_T* single_model_path) {
     printf("Running test: Load Model\n");
     test_load_model(model_path);
     printf("Completed test: Load Model\n\n");
@@ -74,22 +156,58 @@ void test_api_functions(const ORTCHAR_T* model_path) {
     test_generate_template(model_path, image1);
     printf("Completed test: Generate Template\n\n");
 
+    printf("Running test: Single-Tower Template\n");
+    test_single_tower_template(model_path, single_model_path, image1);
+    printf("Completed test: Single-Tower Template\n\n");
+
+    printf("Running test: Generate Templates Batch\n");
+    const char* batch_images[] = { image1, image2, "tests/samples/fingerprint_image.bmp" };
+    test_generate_templates_batch(single_model_path, batch_images, 3);
+    printf("Completed test: Generate Templates Batch\n\n");
+
+    printf("Running test: Generate Template With Context\n");
+    test_generate_template_with_context(single_model_path, image1);
+    printf("Completed test: Generate Template With Context\n\n");
+
+    printf("Running test: Enrollment Pipeline\n");
+    test_enroll_pipeline(single_model_path, batch_images, 3);
+    printf("Completed test: Enrollment Pipeline\n\n");
+
+    printf("Running test: Session Pool\n");
+    test_session_pool(single_model_path, image1);
+    printf("Completed test: Session Pool\n\n");
+
+    printf("Running test: Model Registry\n");
+    test_model_registry(single_model_path, model_path, ORT_TSTR("tests/registry_swap_test.onnx"), image1);
+    printf("Completed test: Model Registry\n\n");
+
+    printf("Running test: Optimized Model Cache\n");
+    test_model_cache(single_model_path, ORT_TSTR("models/optimized_deit_tiny_single.ort"),
+        ORT_TSTR("models/optimized_deit_tiny_single.ort.key"), image1);
+    printf("Completed test: Optimized Model Cache\n\n");
+
     printf("Running test: Fingerprint Identification\n");
     test_identification(model_path);
     printf("Completed test: Fingerprint Identification\n\n");
+
+    printf("Running test: Quantized Model\n");
+    test_quantized_model(single_model_path, ORT_TSTR("models/optimized_deit_tiny_single_int8.onnx"));
+    printf("Completed test: Quantized Model\n\n");
 }
 
-#ifdef _DEBUG 
+// Debug configuration of fingerprint.vcxproj, or the fingerprint_tests CMake target
+#if defined(_DEBUG) || defined(FINGERPRINT_TEST_MAIN)
 int main() {
 
     // Set model file path
-    const wchar_t* model_path = L"models/optimized_deit_tiny_siamese.onnx";  // path in unicode(utf-8)
+    const ORTCHAR_T* model_path = ORT_TSTR("models/optimized_deit_tiny_siamese.onnx");  // path in unicode(utf-8)
+    const ORTCHAR_T* single_model_path = ORT_TSTR("models/optimized_deit_tiny_single.onnx");  // exported by tools/export_single_tower.py
 
     printf("Testing helper functions... \n\n");
     test_helper_functions(model_path);
 
     printf("Testing API functions... \n\n");
-    test_api_functions(model_path);
+    test_api_functions(model_path, single_model_path);
 
     return 0;
 }
@@ -0,0 +1,160 @@
+#include "thread_pool.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct Worker {
+    ThreadPool* pool;
+    platform_thread thread;
+    int index;
+} Worker;
+
+struct ThreadPool {
+    Worker* workers;
+    int num_threads;
+    int pin_threads;
+
+    platform_mutex mutex;
+    platform_cond work_ready;
+    platform_cond work_done;
+
+    // Current job, published under mutex and identified by generation
+    thread_task_fn fn;
+    void* arg;
+    int num_tasks;
+    unsigned generation;
+    int pending;
+    int stop;
+
+    // Serializes callers sharing one pool
+    platform_mutex run_mutex;
+};
+
+static void worker_main(void* param) {
+    Worker* worker = (Worker*)param;
+    ThreadPool* pool = worker->pool;
+    unsigned seen = 0;
+
+    if (pool->pin_threads) {
+        pin_current_thread(worker->index % cpu_count());
+    }
+
+    for (;;) {
+        mutex_lock(&pool->mutex);
+        while (!pool->stop && pool->generation == seen) {
+            cond_wait(&pool->work_ready, &pool->mutex);
+        }
+        if (pool->stop) {
+            mutex_unlock(&pool->mutex);
+            return;
+        }
+        seen = pool->generation;
+        thread_task_fn fn = pool->fn;
+        void* arg = pool->arg;
+        int num_tasks = pool->num_tasks;
+        mutex_unlock(&pool->mutex);
+
+        // Static round-robin assignment keeps a task on the same worker across calls
+        for (int t = worker->index; t < num_tasks; t += pool->num_threads) {
+            fn(arg, t, worker->index);
+        }
+
+        mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) {
+            cond_signal(&pool->work_done);
+        }
+        mutex_unlock(&pool->mutex);
+    }
+}
+
+int thread_pool_run(ThreadPool* pool, thread_task_fn fn, void* arg, int num_tasks) {
+    if (pool == NULL || fn == NULL || num_tasks < 0) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    if (num_tasks == 0) return 0;
+
+    mutex_lock(&pool->run_mutex);
+    mutex_lock(&pool->mutex);
+    pool->fn = fn;
+    pool->arg = arg;
+    pool->num_tasks = num_tasks;
+    pool->pending = pool->num_threads;
+    pool->generation++;
+    cond_broadcast(&pool->work_ready);
+    while (pool->pending > 0) {
+        cond_wait(&pool->work_done, &pool->mutex);
+    }
+    mutex_unlock(&pool->mutex);
+    mutex_unlock(&pool->run_mutex);
+    return 0;
+}
+
+static void stop_workers(ThreadPool* pool, int started) {
+    mutex_lock(&pool->mutex);
+    pool->stop = 1;
+    cond_broadcast(&pool->work_ready);
+    mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < started; i++) {
+        thread_join(pool->workers[i].thread);
+    }
+}
+
+// API function
+int create_thread_pool(int num_threads, int pin_threads, ThreadPool** out_pool) {
+    if (out_pool == NULL) {
+        fprintf(stderr, "Invalid input parameters.\n");
+        return -1;
+    }
+    if (num_threads <= 0) num_threads = cpu_count();
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    Worker* workers = (Worker*)calloc(num_threads, sizeof(Worker));
+    if (pool == NULL || workers == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(pool);
+        free(workers);
+        return -1;
+    }
+    pool->workers = workers;
+    pool->num_threads = num_threads;
+    pool->pin_threads = pin_threads;
+    mutex_init(&pool->mutex);
+    mutex_init(&pool->run_mutex);
+    cond_init(&pool->work_ready);
+    cond_init(&pool->work_done);
+
+    for (int i = 0; i < num_threads; i++) {
+        workers[i].pool = pool;
+        workers[i].index = i;
+        if (thread_create(&workers[i].thread, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Error: Failed to start worker thread\n");
+            stop_workers(pool, i);
+            pool->num_threads = 0;
+            clean_thread_pool(pool);
+            return -1;
+        }
+    }
+
+    *out_pool = pool;
+    return 0;
+}
+
+int thread_pool_size(const ThreadPool* pool) {
+    return pool == NULL ? 1 : pool->num_threads;
+}
+
+void clean_thread_pool(ThreadPool* pool) {
+    if (pool == NULL) return;
+
+    if (pool->num_threads > 0) {
+        stop_workers(pool, pool->num_threads);
+    }
+    cond_destroy(&pool->work_ready);
+    cond_destroy(&pool->work_done);
+    mutex_destroy(&pool->mutex);
+    mutex_destroy(&pool->run_mutex);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,22 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "config.h"
+
+// Persistent worker pool for data-parallel loops. Task t always runs on worker
+// t % num_threads, so memory first touched by a task stays local to the core that
+// touches it on every later call (first-touch NUMA placement).
+typedef struct ThreadPool ThreadPool;
+
+typedef void (*thread_task_fn)(void* arg, int task_index, int thread_index);
+
+// Runs fn(arg, t, worker) for t in [0, num_tasks) and waits for all of them
+int thread_pool_run(ThreadPool* pool, thread_task_fn fn, void* arg, int num_tasks);
+
+// API function
+// num_threads <= 0 uses one worker per available logical processor; pin_threads binds worker i to CPU i
+DllAPI int create_thread_pool(int num_threads, int pin_threads, ThreadPool** out_pool);
+DllAPI int thread_pool_size(const ThreadPool* pool);
+DllAPI void clean_thread_pool(ThreadPool* pool);
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,47 @@
+import argparse
+import numpy as np
+import onnx
+from onnx import numpy_helper
+
+# Fold the ImageNet mean/std of the three identical gray channels into the patch-embedding Conv,
+# producing a 1-channel model that takes v / 255 directly:
+#   sum_c W_c * (g - m_c) / s_c + b  =  (sum_c W_c / s_c) * g  +  (b - sum_c (m_c / s_c) * sum(W_c))
+# The second term is exact because the 16x16 / stride 16 patch Conv has no padding.
+
+MEAN = np.array([0.485, 0.456, 0.406], dtype=np.float64)
+STD = np.array([0.229, 0.224, 0.225], dtype=np.float64)
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--input", default="models/optimized_deit_tiny_single.onnx")
+parser.add_argument("--output", default="models/optimized_deit_tiny_gray.onnx")
+args = parser.parse_args()
+
+model = onnx.load(args.input)
+graph = model.graph
+assert len(graph.input) == 1, "Export the single-tower model first (tools/export_single_tower.py)"
+input_name = graph.input[0].name
+
+conv = next(node for node in graph.node if node.op_type == "Conv" and input_name in node.input)
+for attr in conv.attribute:
+    if attr.name == "pads":
+        assert not any(attr.ints), "Patch Conv must not be padded"
+initializers = {init.name: init for init in graph.initializer}
+weight_init = initializers[conv.input[1]]
+weight = numpy_helper.to_array(weight_init).astype(np.float64)  # [out, 3, kh, kw]
+bias = numpy_helper.to_array(initializers[conv.input[2]]).astype(np.float64) if len(conv.input) > 2 else np.zeros(weight.shape[0])
+
+gray_weight = np.sum(weight / STD[None, :, None, None], axis=1, keepdims=True)
+gray_bias = bias - np.sum((MEAN / STD)[None, :] * weight.sum(axis=(2, 3)), axis=1)
+
+weight_init.CopyFrom(numpy_helper.from_array(gray_weight.astype(np.float32), weight_init.name))
+bias_name = conv.input[1] + "_gray_bias"
+graph.initializer.append(numpy_helper.from_array(gray_bias.astype(np.float32), bias_name))
+if len(conv.input) > 2:
+    conv.input[2] = bias_name
+else:
+    conv.input.append(bias_name)
+
+graph.input[0].type.tensor_type.shape.dim[1].dim_value = 1
+onnx.checker.check_model(model)
+onnx.save(model, args.output)
+print("Saved 1-channel model to", args.output)
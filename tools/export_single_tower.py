@@ -0,0 +1,29 @@
+import argparse
+import onnx
+from onnx.utils import extract_model
+
+# Prune the Siamese DeiT graph down to one tower (input1 -> output1).
+# Both towers share weights, so the extracted subgraph produces the same embedding
+# as the full model while running a single ViT forward per fingerprint.
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--input", default="models/optimized_deit_tiny_siamese.onnx")
+parser.add_argument("--output", default="models/optimized_deit_tiny_single.onnx")
+# Only valid when the source was exported with dynamic_axes on the batch dimension,
+# otherwise traced Reshape nodes still carry a batch of 1
+parser.add_argument("--dynamic-batch", action="store_true")
+args = parser.parse_args()
+
+extract_model(args.input, args.output, input_names=["input1"], output_names=["output1"])
+
+if args.dynamic_batch:
+    model = onnx.load(args.output)
+    for value in list(model.graph.input) + list(model.graph.output):
+        value.type.tensor_type.shape.dim[0].dim_param = "batch"
+    onnx.save(model, args.output)
+
+# Sanity check the exported model
+model = onnx.load(args.output)
+onnx.checker.check_model(model)
+print("Inputs:", [i.name for i in model.graph.input])
+print("Outputs:", [o.name for o in model.graph.output])
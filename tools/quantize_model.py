@@ -0,0 +1,76 @@
+import argparse
+import glob
+import os
+import numpy as np
+import onnx
+from PIL import Image
+from onnxruntime.quantization import CalibrationDataReader, QuantFormat, QuantType, quantize_dynamic, quantize_static
+from onnxruntime.quantization.shape_inference import quant_pre_process
+
+# Offline int8 quantization of the single-tower (or gray) DeiT model, loadable with load_model.
+#   dynamic: int8 weights, activation ranges computed per Run (MatMulInteger / DynamicQuantizeLinear).
+#            No calibration data needed.
+#   static:  QDQ model with u8 activations / s8 weights calibrated on sample fingerprints,
+#            which maps onto VNNI (vpdpbusd) kernels on AVX-512 hosts.
+# The patch-embedding Conv and LayerNorm / Softmax stay fp32. Check the result with
+# test_quantized_model (tests/matching_test.c) before deploying it.
+
+MEAN = np.array([0.485, 0.456, 0.406], dtype=np.float32)
+STD = np.array([0.229, 0.224, 0.225], dtype=np.float32)
+
+
+def preprocess(path, channels, size=224):
+    # Same arithmetic as preprocess_image_fused: half-pixel bilinear, clamp, round to 8 bits
+    gray = np.asarray(Image.open(path).convert("L"), dtype=np.float32)
+    height, width = gray.shape
+    def taps(out_size, in_size):
+        g = np.clip((np.arange(out_size) + 0.5) * (in_size / out_size) - 0.5, 0, in_size - 1)
+        i0 = g.astype(np.int64)
+        return i0, np.minimum(i0 + 1, in_size - 1), g - i0
+    x0, x1, dx = taps(size, width)
+    y0, y1, dy = taps(size, height)
+    top = gray[y0][:, x0] * (1 - dx) + gray[y0][:, x1] * dx
+    bottom = gray[y1][:, x0] * (1 - dx) + gray[y1][:, x1] * dx
+    value = np.floor(np.clip(top * (1 - dy)[:, None] + bottom * dy[:, None], 0, 255) + 0.5) / 255.0
+    if channels == 1:
+        return value[None, None].astype(np.float32)
+    return ((value[None] - MEAN[:, None, None]) / STD[:, None, None])[None].astype(np.float32)
+
+
+class FingerprintReader(CalibrationDataReader):
+    def __init__(self, paths, input_name, channels):
+        self.samples = iter([{input_name: preprocess(path, channels)} for path in paths])
+
+    def get_next(self):
+        return next(self.samples, None)
+
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--input", default="models/optimized_deit_tiny_single.onnx")
+parser.add_argument("--output", default="models/optimized_deit_tiny_single_int8.onnx")
+parser.add_argument("--mode", choices=["dynamic", "static"], default="dynamic")
+parser.add_argument("--calibration", default="tests/samples/*.bmp", help="glob of BMPs for static calibration")
+# 7-bit weights avoid u8 x s8 saturation on AVX2 hosts without VNNI, at some accuracy cost
+parser.add_argument("--reduce-range", action="store_true")
+args = parser.parse_args()
+
+prepared = args.output + ".prep.onnx"
+quant_pre_process(args.input, prepared, skip_symbolic_shape=True)
+
+linear_ops = ["MatMul", "Gemm"]
+if args.mode == "dynamic":
+    quantize_dynamic(prepared, args.output, op_types_to_quantize=linear_ops, per_channel=True,
+                     reduce_range=args.reduce_range, weight_type=QuantType.QInt8)
+else:
+    model = onnx.load(prepared)
+    model_input = model.graph.input[0]
+    channels = model_input.type.tensor_type.shape.dim[1].dim_value
+    paths = sorted(glob.glob(args.calibration))
+    assert paths, "No calibration images match " + args.calibration
+    quantize_static(prepared, args.output, FingerprintReader(paths, model_input.name, channels),
+                    quant_format=QuantFormat.QDQ, op_types_to_quantize=linear_ops, per_channel=True,
+                    reduce_range=args.reduce_range, activation_type=QuantType.QUInt8, weight_type=QuantType.QInt8)
+
+os.remove(prepared)
+onnx.checker.check_model(args.output)
+print("Saved", args.mode, "int8 model to", args.output)